@@ -1,12 +1,27 @@
 #include "../include/allocator.h"
+#include "../include/trace.h"
+#include "../include/objcache.h"
+#include "timing.h"
+#include "perf_counters.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
-#include <sys/time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #define DEFAULT_HEAP_SIZE (10 * 1024 * 1024)  /* 10 MB */
 #define MAX_ALLOCS 10000
+#define MAX_THREADS 256
+#define CSV_HEADER "Allocator,Benchmark,Param,Time_us,Operations,Ops_per_sec,Failed,Time_stddev_us,Reps," \
+                   "Cycles_per_op,Instructions_per_op,L1d_misses_per_op,LLC_misses_per_op," \
+                   "dTLB_misses_per_op,Branch_misses_per_op,Page_faults_per_op\n"
+#define LATENCY_CSV_HEADER "Allocator,Benchmark,Op,Count,Mean_ns,P50_ns,P99_ns,P99_9_ns,P99_99_ns,Max_ns\n"
+#define FOOTPRINT_CSV_HEADER "Allocator,Benchmark,Ops,Time_us,Requested_bytes,Allocated_bytes," \
+                             "Heap_used_bytes,RSS_bytes,Largest_free_block\n"
 
 /* Benchmark scenarios */
 typedef enum {
@@ -16,41 +31,258 @@ typedef enum {
     BENCH_STRESS
 } benchmark_type_t;
 
-/* Get current time in microseconds */
+/* Get current time in microseconds (монотонные часы: не прыгают при
+ * подстройке системного времени, разрешение - наносекунды) */
 static double get_time_us(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/* Резидентная память процесса в КБ (второе поле /proc/self/statm) */
+static size_t get_rss_kb(void) {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    
+    unsigned long size = 0, resident = 0;
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
 }
 
 /* Benchmark result */
 typedef struct {
     const char* allocator_name;
     const char* benchmark_name;
+    size_t param; // число потоков для многопоточных сценариев
     double time_us;
     size_t operations;
     double ops_per_sec;
+    size_t failed; // неудачные выделения
 } benchmark_result_t;
 
+/* ===== Повторы прогонов ===== */
+
+/* Набор сценариев для аллокатора прогоняется warmup раз без учёта (прогрев
+ * кэшей, страниц и предсказателя), затем reps раз с замером. Результаты с
+ * одинаковыми (аллокатор, сценарий, Param) копятся и в CSV пишутся одной
+ * строкой: среднее время, его стандартное отклонение и число повторов.
+ * Failed - наибольшее по повторам. Пояснительные строки печатаются только
+ * на последнем повторе, гистограммы задержек копятся по всем замеряемым.
+ * С -c счётчики perf идут только внутри замеряемых участков (region_begin/
+ * region_end) и в CSV попадают средними на операцию; недоступный счётчик -
+ * пустая колонка */
+#define MAX_RESULTS 512
+#define MAX_LATENCIES 32
+
+typedef struct {
+    benchmark_result_t result;
+    size_t reps;
+    double time_sum;
+    double time_sq_sum;
+    double counter_sum[PERF_NUM_COUNTERS];
+    size_t counter_reps[PERF_NUM_COUNTERS]; // повторы, где счётчик был валиден
+} result_acc_t;
+
+typedef struct {
+    const char* allocator_name;
+    const char* benchmark_name;
+    const char* op;
+    latency_hist_t* hist;
+} latency_acc_t;
+
+static struct {
+    int warmup;
+    int reps;
+    int pin_cpu; // -1 - потоки не закрепляются
+    bool counters; // открыты счётчики perf (-c)
+    bool measuring;
+    bool last_rep;
+    result_acc_t results[MAX_RESULTS];
+    size_t num_results;
+    latency_acc_t latencies[MAX_LATENCIES];
+    size_t num_latencies;
+    latency_hist_t* scratch; // для прогрева
+    FILE* latency_output;
+    FILE* footprint_output; // ряды занятой памяти (-f), пишутся на последнем повторе
+} harness = { .warmup = 1, .reps = 5, .pin_cpu = -1, .measuring = true, .last_rep = true };
+
+/* Начало и конец замеряемого участка: время и счётчики perf */
+static double region_begin(void) {
+    if (harness.counters) {
+        perf_counters_start();
+    }
+    return get_time_us();
+}
+
+static double region_end(double start) {
+    double elapsed = get_time_us() - start;
+    if (harness.counters) {
+        perf_counters_stop();
+    }
+    return elapsed;
+}
+
+static void write_csv_row(FILE* output, const benchmark_result_t* result, double stddev, size_t reps,
+                          const double* per_op) {
+    fprintf(output, "%s,%s,%zu,%.2f,%zu,%.2f,%zu,%.2f,%zu",
+            result->allocator_name,
+            result->benchmark_name,
+            result->param,
+            result->time_us,
+            result->operations,
+            result->ops_per_sec,
+            result->failed,
+            stddev,
+            reps);
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (per_op && per_op[i] >= 0) {
+            fprintf(output, ",%.3f", per_op[i]);
+        } else {
+            fprintf(output, ",");
+        }
+    }
+    fprintf(output, "\n");
+}
+
+/* Учёт результата одного повтора; строка в output появится в flush_results.
+ * Счётчики забираются всегда, чтобы прогрев не попал в следующий результат */
+static void write_result(FILE* output, const benchmark_result_t* result) {
+    (void)output;
+    perf_sample_t sample;
+    if (harness.counters) {
+        perf_counters_take(&sample);
+    }
+    if (!harness.measuring) return;
+    
+    result_acc_t* acc = NULL;
+    for (size_t i = 0; i < harness.num_results; i++) {
+        result_acc_t* r = &harness.results[i];
+        if (r->result.param == result->param &&
+            strcmp(r->result.allocator_name, result->allocator_name) == 0 &&
+            strcmp(r->result.benchmark_name, result->benchmark_name) == 0) {
+            acc = r;
+            break;
+        }
+    }
+    if (!acc) {
+        if (harness.num_results == MAX_RESULTS) return;
+        acc = &harness.results[harness.num_results++];
+        memset(acc, 0, sizeof(result_acc_t));
+        acc->result = *result;
+        acc->result.failed = 0;
+    }
+    
+    acc->reps++;
+    acc->time_sum += result->time_us;
+    acc->time_sq_sum += result->time_us * result->time_us;
+    if (result->failed > acc->result.failed) {
+        acc->result.failed = result->failed;
+    }
+    for (int i = 0; harness.counters && i < PERF_NUM_COUNTERS; i++) {
+        if (sample.valid[i]) {
+            acc->counter_sum[i] += sample.values[i];
+            acc->counter_reps[i]++;
+        }
+    }
+}
+
+/* Гистограмма для замеров (аллокатор, сценарий, операция); на прогреве -
+ * общая черновая, которая никуда не выводится */
+static latency_hist_t* latency_slot(const char* alloc_name, const char* bench_name, const char* op) {
+    if (!harness.measuring) {
+        return harness.scratch;
+    }
+    for (size_t i = 0; i < harness.num_latencies; i++) {
+        latency_acc_t* l = &harness.latencies[i];
+        if (strcmp(l->allocator_name, alloc_name) == 0 &&
+            strcmp(l->benchmark_name, bench_name) == 0 && strcmp(l->op, op) == 0) {
+            return l->hist;
+        }
+    }
+    if (harness.num_latencies == MAX_LATENCIES) {
+        return harness.scratch;
+    }
+    latency_acc_t* l = &harness.latencies[harness.num_latencies];
+    l->hist = calloc(1, sizeof(latency_hist_t));
+    if (!l->hist) {
+        return harness.scratch;
+    }
+    l->allocator_name = alloc_name;
+    l->benchmark_name = bench_name;
+    l->op = op;
+    harness.num_latencies++;
+    return l->hist;
+}
+
+/* Пояснения к результатам (RSS, доли и т.п.) - один раз, на последнем повторе */
+static void print_info(const char* format, ...) {
+    if (!harness.last_rep) return;
+    
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+/* Вывод накопленного: строки CSV и сводка задержек */
+static void flush_results(FILE* output) {
+    for (size_t i = 0; i < harness.num_results; i++) {
+        result_acc_t* acc = &harness.results[i];
+        double mean = acc->time_sum / acc->reps;
+        double variance = acc->reps > 1
+                        ? (acc->time_sq_sum - acc->reps * mean * mean) / (acc->reps - 1) : 0;
+        acc->result.time_us = mean;
+        acc->result.ops_per_sec = acc->result.operations / (mean / 1000000.0);
+        double per_op[PERF_NUM_COUNTERS];
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            per_op[c] = acc->counter_reps[c] && acc->result.operations
+                      ? acc->counter_sum[c] / acc->counter_reps[c] / acc->result.operations : -1;
+        }
+        write_csv_row(output ? output : stdout, &acc->result, variance > 0 ? sqrt(variance) : 0,
+                      acc->reps, per_op);
+    }
+    harness.num_results = 0;
+    
+    for (size_t i = 0; i < harness.num_latencies; i++) {
+        latency_acc_t* l = &harness.latencies[i];
+        if (l->hist->total == 0) {
+            free(l->hist);
+            continue;
+        }
+        double mean = latency_mean_ns(l->hist), p50 = latency_percentile_ns(l->hist, 50),
+               p99 = latency_percentile_ns(l->hist, 99), p999 = latency_percentile_ns(l->hist, 99.9),
+               p9999 = latency_percentile_ns(l->hist, 99.99), max = latency_max_ns(l->hist);
+        printf("%s %s %s latency: n=%llu mean %.0f ns, p50 %.0f ns, p99 %.0f ns, "
+               "p99.9 %.0f ns, p99.99 %.0f ns, max %.0f ns\n",
+               l->allocator_name, l->benchmark_name, l->op, (unsigned long long)l->hist->total,
+               mean, p50, p99, p999, p9999, max);
+        if (harness.latency_output) {
+            fprintf(harness.latency_output, "%s,%s,%s,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                    l->allocator_name, l->benchmark_name, l->op,
+                    (unsigned long long)l->hist->total, mean, p50, p99, p999, p9999, max);
+        }
+        free(l->hist);
+    }
+    harness.num_latencies = 0;
+}
+
 /* Print CSV header */
 void print_csv_header(void) {
-    printf("Allocator,Benchmark,Time_us,Operations,Ops_per_sec\n");
+    printf(CSV_HEADER);
 }
 
 /* Print benchmark result as CSV */
 void print_result_csv(const benchmark_result_t* result) {
-    printf("%s,%s,%.2f,%zu,%.2f\n",
-           result->allocator_name,
-           result->benchmark_name,
-           result->time_us,
-           result->operations,
-           result->ops_per_sec);
+    write_csv_row(stdout, result, 0, 1, NULL);
 }
 
 // Benchmark: Тестирует последовательное выделение и освобождение
 // Какой аллокатор, его название, сколько операций, куда печатать
 void benchmark_sequential(allocator_t* alloc, const char* alloc_name, float num_ops, FILE* output) {
-    double start = get_time_us(); // замеряем в мс
+    double start = region_begin(); // замеряем в мс
     
     // выделяем + освобождаем = nums_ops
     for (size_t i = 0; i < num_ops / 2; i++) {
@@ -61,25 +293,19 @@ void benchmark_sequential(allocator_t* alloc, const char* alloc_name, float num_
     }
     
     // Фиксируем оконание и считаем, сколько заняло
-    double end = get_time_us();
-    double elapsed = end - start;
+    double elapsed = region_end(start);
     
     // output bencmark
     benchmark_result_t result = {
         .allocator_name = alloc_name,
         .benchmark_name = "Sequential",
+        .param = 1,
         .time_us = elapsed,
         .operations = num_ops / 2,
         .ops_per_sec = (num_ops / 2) / (elapsed / 1000000.0)
     };
     
-    if (output) {
-        fprintf(output, "%s,%s,%.2f,%zu,%.2f\n",
-                result.allocator_name, result.benchmark_name,
-                result.time_us, result.operations, result.ops_per_sec);
-    } else {
-        print_result_csv(&result);
-    }
+    write_result(output ? output : stdout, &result);
 }
 
 /* Benchmark: тестирует в случайных условиях */
@@ -89,7 +315,7 @@ void benchmark_random(allocator_t* alloc, const char* alloc_name, size_t num_ops
     int ptr_count = 0;
     
     srand(42); // Фиксируем последовательность случайных чисел
-    double start = get_time_us();
+    double start = region_begin();
     
     for (size_t i = 0; i < num_ops; i++) {
         int action = rand() % 2;
@@ -112,31 +338,25 @@ void benchmark_random(allocator_t* alloc, const char* alloc_name, size_t num_ops
         allocator_free(alloc, ptrs[i]);
     }
     
-    double end = get_time_us();
-    double elapsed = end - start;
+    double elapsed = region_end(start);
     
     benchmark_result_t result = {
         .allocator_name = alloc_name,
         .benchmark_name = "Random",
+        .param = 1,
         .time_us = elapsed,
         .operations = num_ops,
         .ops_per_sec = num_ops / (elapsed / 1000000.0)
     };
     
-    if (output) {
-        fprintf(output, "%s,%s,%.2f,%zu,%.2f\n",
-                result.allocator_name, result.benchmark_name,
-                result.time_us, result.operations, result.ops_per_sec);
-    } else {
-        print_result_csv(&result);
-    }
+    write_result(output ? output : stdout, &result);
 }
 
 /* Benchmark: Сочетание длинных и коротких операций */
 void benchmark_mixed(allocator_t* alloc, const char* alloc_name, size_t num_ops, FILE* output) {
     void* ptrs[500];
     
-    double start = get_time_us();
+    double start = region_begin();
     
     // Фаза 1: много маленьких блоков
     for (int i = 0; i < 500; i++) {
@@ -161,24 +381,18 @@ void benchmark_mixed(allocator_t* alloc, const char* alloc_name, size_t num_ops,
         }
     }
     
-    double end = get_time_us();
-    double elapsed = end - start;
+    double elapsed = region_end(start);
     
     benchmark_result_t result = {
         .allocator_name = alloc_name,
         .benchmark_name = "Mixed",
+        .param = 1,
         .time_us = elapsed,
         .operations = 2000,
         .ops_per_sec = 2000 / (elapsed / 1000000.0)
     };
     
-    if (output) {
-        fprintf(output, "%s,%s,%.2f,%zu,%.2f\n",
-                result.allocator_name, result.benchmark_name,
-                result.time_us, result.operations, result.ops_per_sec);
-    } else {
-        print_result_csv(&result);
-    }
+    write_result(output ? output : stdout, &result);
 }
 
 /* Benchmark: Стресс тест с множеством аллокаций */
@@ -186,7 +400,7 @@ void benchmark_stress(allocator_t* alloc, const char* alloc_name, size_t num_ops
     void* ptrs[MAX_ALLOCS];
     int allocated = 0;
     
-    double start = get_time_us();
+    double start = region_begin();
     
     /* Аллоцируем как можно больше */
     for (int i = 0; i < MAX_ALLOCS && i < num_ops; i++) {
@@ -202,139 +416,1852 @@ void benchmark_stress(allocator_t* alloc, const char* alloc_name, size_t num_ops
         allocator_free(alloc, ptrs[i]);
     }
     
-    double end = get_time_us();
-    double elapsed = end - start;
+    double elapsed = region_end(start);
     
     benchmark_result_t result = {
         .allocator_name = alloc_name,
         .benchmark_name = "Stress",
+        .param = 1,
         .time_us = elapsed,
         .operations = allocated * 2,
         .ops_per_sec = (allocated * 2) / (elapsed / 1000000.0)
     };
     
-    if (output) {
-        fprintf(output, "%s,%s,%.2f,%zu,%.2f\n",
-                result.allocator_name, result.benchmark_name,
-                result.time_us, result.operations, result.ops_per_sec);
-    } else {
-        print_result_csv(&result);
+    write_result(output ? output : stdout, &result);
+}
+
+/* Benchmark: долгая смешанная нагрузка (Churn). Живое множество объектов
+ * разного размера постоянно обновляется; по окнам видно, держится ли
+ * доля успешных выделений или куча со временем дробится */
+#define CHURN_SLOTS 2048
+#define CHURN_WINDOWS 10
+
+static size_t churn_size(unsigned int* seed) {
+    int kind = rand_r(seed) % 100;
+    if (kind < 80) {
+        return 16 + rand_r(seed) % 512; // мелкие
+    } else if (kind < 95) {
+        return 1024 + rand_r(seed) % (16 * 1024); // средние
     }
+    return 32 * 1024 + rand_r(seed) % (96 * 1024); // крупные
 }
 
+void benchmark_churn(allocator_t* alloc, const char* alloc_name, size_t num_ops, FILE* output) {
+    static void* slots[CHURN_SLOTS];
+    size_t window_ops = num_ops / CHURN_WINDOWS;
+    size_t total_allocs = 0, total_failed = 0;
+    unsigned int seed = 42;
+    
+    memset(slots, 0, sizeof(slots));
+    
+    for (int window = 1; window <= CHURN_WINDOWS; window++) {
+        size_t failed = 0;
+        double start = region_begin();
+        
+        for (size_t i = 0; i < window_ops; i++) {
+            int idx = rand_r(&seed) % CHURN_SLOTS;
+            if (slots[idx]) {
+                allocator_free(alloc, slots[idx]);
+                slots[idx] = NULL;
+            } else {
+                slots[idx] = allocator_alloc(alloc, churn_size(&seed));
+                total_allocs++;
+                if (!slots[idx]) {
+                    failed++;
+                }
+            }
+        }
+        
+        double elapsed = region_end(start);
+        total_failed += failed;
+        
+        benchmark_result_t result = {
+            .allocator_name = alloc_name,
+            .benchmark_name = "Churn",
+            .param = window,
+            .time_us = elapsed,
+            .operations = window_ops,
+            .ops_per_sec = window_ops / (elapsed / 1000000.0),
+            .failed = failed
+        };
+        write_result(output ? output : stdout, &result);
+    }
+    
+    for (int i = 0; i < CHURN_SLOTS; i++) {
+        allocator_free(alloc, slots[i]);
+    }
+    
+    print_info("%s Churn: success rate %.2f%% (%zu of %zu allocations failed)\n",
+           alloc_name, 100.0 * (total_allocs - total_failed) / (total_allocs ? total_allocs : 1),
+           total_failed, total_allocs);
+}
 
-void run_benchmarks(allocator_type_t type, const char* name, size_t num_ops, FILE* output) {
-    printf("Running benchmarks for %s...\n", name);
+/* Benchmark: внутренняя фрагментация размерных классов. Выделяем num_ops
+ * объектов случайного размера (как в Random), считаем долю запрошенных
+ * байт от реально отданных (allocator_usable_size) и освобождаем всё */
+void benchmark_size_classes(allocator_t* alloc, const char* alloc_name, size_t num_ops, FILE* output) {
+    void** ptrs = calloc(num_ops, sizeof(void*));
+    if (!ptrs) return;
     
-    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
-    if (!alloc) {
-        fprintf(stderr, "Failed to create allocator: %s\n", name);
+    size_t requested = 0, usable = 0, failed = 0;
+    unsigned int seed = 42;
+    
+    double start = region_begin();
+    for (size_t i = 0; i < num_ops; i++) {
+        size_t size = 16 + rand_r(&seed) % 1024;
+        ptrs[i] = allocator_alloc(alloc, size);
+        if (ptrs[i]) {
+            requested += size;
+        } else {
+            failed++;
+        }
+    }
+    double elapsed = region_end(start);
+    for (size_t i = 0; i < num_ops; i++) {
+        usable += allocator_usable_size(alloc, ptrs[i]);
+    }
+    start = region_begin();
+    for (size_t i = 0; i < num_ops; i++) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    elapsed += region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "SizeClasses",
+        .param = 1,
+        .time_us = elapsed,
+        .operations = 2 * num_ops,
+        .ops_per_sec = 2 * num_ops / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s SizeClasses: memory efficiency %.2f%% (%zu requested / %zu usable bytes)\n",
+           alloc_name, usable ? 100.0 * requested / usable : 0.0, requested, usable);
+    free(ptrs);
+}
+
+/* Benchmark: всплеск выделений и возврат памяти ОС.
+ * Выделяем BURST_BYTES мелкими объектами, освобождаем всё и вызываем
+ * allocator_trim. Печатает RSS до всплеска, на пике, после освобождения
+ * и после trim */
+#define BURST_BYTES (32 * 1024 * 1024)
+
+void benchmark_burst(allocator_type_t type, const char* alloc_name, FILE* output) {
+    size_t max_objects = BURST_BYTES / 16;
+    allocator_t* alloc = allocator_create(type, 2 * BURST_BYTES);
+    void** ptrs = calloc(max_objects, sizeof(void*));
+    if (!alloc || !ptrs) {
+        allocator_destroy(alloc);
+        free(ptrs);
         return;
     }
     
-    benchmark_sequential(alloc, name, num_ops, output);
+    size_t rss_before = get_rss_kb();
+    size_t count = 0, bytes = 0, failed = 0;
+    unsigned int seed = 42;
+    
+    double start = region_begin();
+    while (bytes < BURST_BYTES && count < max_objects) {
+        size_t size = 16 + rand_r(&seed) % 1024;
+        ptrs[count] = allocator_alloc(alloc, size);
+        if (!ptrs[count]) {
+            failed++;
+            break;
+        }
+        memset(ptrs[count], 0xAB, size);
+        bytes += size;
+        count++;
+    }
+    size_t rss_peak = get_rss_kb();
+    for (size_t i = 0; i < count; i++) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    double elapsed = region_end(start);
+    size_t rss_freed = get_rss_kb();
+    allocator_trim(alloc);
+    size_t rss_trimmed = get_rss_kb();
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "Burst",
+        .param = 1,
+        .time_us = elapsed,
+        .operations = 2 * count,
+        .ops_per_sec = 2 * count / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s Burst: RSS before %zu KB, peak %zu KB, after free %zu KB, after trim %zu KB\n",
+           alloc_name, rss_before, rss_peak, rss_freed, rss_trimmed);
+    
+    free(ptrs);
     allocator_destroy(alloc);
+}
+
+/* Benchmark: поиск крупного блока при растущем числе свободных блоков.
+ * Куча заполняется целиком и дробится на N несливаемых свободных
+ * фрагментов, затем меряется время пары alloc/free. Каждый десятый
+ * запрос больше любого фрагмента и заканчивается неудачей - это худший
+ * случай для линейного поиска. Param - число свободных блоков */
+#define LOOKUP_OPS 100000
+#define LOOKUP_MAX_FILLERS 256
+
+void benchmark_large_lookup(allocator_type_t type, const char* alloc_name, size_t free_blocks,
+                            FILE* output) {
+    allocator_t* alloc = allocator_create(type, 2 * free_blocks * 4200 + 1024 * 1024);
+    void** ptrs = calloc(2 * free_blocks, sizeof(void*));
+    if (!alloc || !ptrs) {
+        allocator_destroy(alloc);
+        free(ptrs);
+        return;
+    }
     
-    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
-    benchmark_random(alloc, name, num_ops, output);
+    // 2N занятых блоков по 2-4 КБ, остаток кучи занимаем заполнителями
+    unsigned int seed = 42;
+    for (size_t i = 0; i < 2 * free_blocks; i++) {
+        ptrs[i] = allocator_alloc(alloc, 2100 + rand_r(&seed) % 2000);
+    }
+    void* fillers[LOOKUP_MAX_FILLERS];
+    int num_fillers = 0;
+    // заполнители не крупнее 64 КБ: большие запросы уходят в mmap, мимо кучи
+    for (size_t size = 64 * 1024; size >= 4096; size /= 2) {
+        while (num_fillers < LOOKUP_MAX_FILLERS &&
+               (fillers[num_fillers] = allocator_alloc(alloc, size)) != NULL) {
+            num_fillers++;
+        }
+    }
+    // освобождаем каждый второй: N фрагментов, разделённых занятыми блоками
+    for (size_t i = 0; i < 2 * free_blocks; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    
+    size_t failed = 0;
+    double start = region_begin();
+    for (int i = 0; i < LOOKUP_OPS; i++) {
+        size_t size = (i % 10 == 9) ? 8192 : 2100 + rand_r(&seed) % 2000;
+        void* ptr = allocator_alloc(alloc, size);
+        if (!ptr) {
+            failed++;
+        }
+        allocator_free(alloc, ptr);
+    }
+    double elapsed = region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "LargeLookup",
+        .param = free_blocks,
+        .time_us = elapsed,
+        .operations = 2 * LOOKUP_OPS,
+        .ops_per_sec = 2 * LOOKUP_OPS / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    for (size_t i = 1; i < 2 * free_blocks; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    for (int i = 0; i < num_fillers; i++) {
+        allocator_free(alloc, fillers[i]);
+    }
+    free(ptrs);
     allocator_destroy(alloc);
+}
+
+/* Benchmark: заполнение страниц объектами одного размера.
+ * Выделяем объекты, пока не заполнится FILL_PAGES страниц, и освобождаем
+ * все. Поиск свободного слота в почти полной странице - худший случай для
+ * побитового сканирования. Param - размер объекта */
+#define FILL_PAGES 256
+#define FILL_ROUNDS 20
+
+void benchmark_fill_page(allocator_type_t type, const char* alloc_name, size_t obj_size,
+                         FILE* output) {
+    size_t count = FILL_PAGES * (4096 / obj_size);
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    void** ptrs = calloc(count, sizeof(void*));
+    if (!alloc || !ptrs) {
+        allocator_destroy(alloc);
+        free(ptrs);
+        return;
+    }
     
-    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
-    benchmark_mixed(alloc, name, num_ops, output);
+    size_t failed = 0;
+    double start = region_begin();
+    for (int round = 0; round < FILL_ROUNDS; round++) {
+        for (size_t i = 0; i < count; i++) {
+            ptrs[i] = allocator_alloc(alloc, obj_size);
+            if (!ptrs[i]) {
+                failed++;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            allocator_free(alloc, ptrs[i]);
+        }
+    }
+    double elapsed = region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "FillPage",
+        .param = obj_size,
+        .time_us = elapsed,
+        .operations = 2 * count * FILL_ROUNDS,
+        .ops_per_sec = 2 * count * FILL_ROUNDS / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    free(ptrs);
     allocator_destroy(alloc);
+}
+
+/* Benchmark: циклы alloc/free одного крупного размера.
+ * Каждый объект трогаем в первом и последнем байте. Повторные циклы
+ * должны обслуживаться кэшем отображений, без mmap/munmap на каждый.
+ * Param - размер объекта в байтах (4 КБ - 64 МБ) */
+#define LARGE_SIZE_OPS 2000
+
+void benchmark_large_sizes(allocator_type_t type, const char* alloc_name, size_t size,
+                           FILE* output) {
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    if (!alloc) return;
+    
+    size_t failed = 0;
+    double start = region_begin();
+    for (int i = 0; i < LARGE_SIZE_OPS; i++) {
+        char* ptr = allocator_alloc(alloc, size);
+        if (!ptr) {
+            failed++;
+            continue;
+        }
+        ptr[0] = (char)i;
+        ptr[size - 1] = (char)i;
+        allocator_free(alloc, ptr);
+    }
+    double elapsed = region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "LargeSizes",
+        .param = size,
+        .time_us = elapsed,
+        .operations = 2 * LARGE_SIZE_OPS,
+        .ops_per_sec = 2 * LARGE_SIZE_OPS / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
     
-    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
-    benchmark_stress(alloc, name, num_ops, output);
     allocator_destroy(alloc);
 }
 
-void print_usage(const char* prog_name) {
-    printf("Usage: %s [OPTIONS]\n", prog_name);
-    printf("Options:\n");
-    printf("  -a, --allocator <type>   Allocator type: segregated, mckusick, all (default: all)\n");
-    printf("  -n, --num-ops <number>   Number of operations (default: 10000)\n");
-    printf("  -o, --output <file>      Output CSV file (default: stdout)\n");
-    printf("  -h, --help               Show this help message\n");
+/* Benchmark: рост буферов через allocator_realloc.
+ * ReallocVector - удвоение вектора от 16 байт до 4 МБ,
+ * ReallocAppend - дописывание в строку по 1-32 байта до 64 КБ.
+ * Печатает, сколько вызовов перенесли блок (остальные - на месте) */
+#define REALLOC_VECTOR_ROUNDS 200
+#define REALLOC_VECTOR_MAX (4 * 1024 * 1024)
+#define REALLOC_APPEND_ROUNDS 50
+#define REALLOC_APPEND_MAX (64 * 1024)
+
+static void write_realloc_result(const char* alloc_name, const char* bench_name, double elapsed,
+                                 size_t ops, size_t moved, size_t failed, FILE* output) {
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = bench_name,
+        .param = 1,
+        .time_us = elapsed,
+        .operations = ops,
+        .ops_per_sec = ops / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s %s: %zu of %zu reallocs moved the block\n", alloc_name, bench_name, moved, ops);
 }
 
-int main(int argc, char* argv[]) {
-    allocator_type_t alloc_type = -1;
-    size_t num_ops = 10000;
-    const char* output_file = NULL;
-    bool run_all = true;
+void benchmark_realloc_growth(allocator_type_t type, const char* alloc_name, FILE* output) {
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    if (!alloc) return;
     
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--allocator") == 0) {
-            if (i + 1 >= argc) {
-                fprintf(stderr, "Error: Missing allocator type\n");
-                print_usage(argv[0]);
-                return 1;
-            }
-            const char* type = argv[++i];
-            if (strcmp(type, "segregated") == 0) {
-                alloc_type = ALLOCATOR_SEGREGATED_FREELIST;
-                run_all = false;
-            } else if (strcmp(type, "mckusick") == 0) {
-                alloc_type = ALLOCATOR_MCKUSICK_KARELS;
-                run_all = false;
-            } else if (strcmp(type, "all") == 0) {
-                run_all = true;
-            } else {
-                fprintf(stderr, "Error: Unknown allocator type: %s\n", type);
-                print_usage(argv[0]);
-                return 1;
-            }
-        } else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--num-ops") == 0) {
-            if (i + 1 >= argc) {
-                fprintf(stderr, "Error: Missing number of operations\n");
-                print_usage(argv[0]);
-                return 1;
-            }
-            num_ops = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
-            if (i + 1 >= argc) {
-                fprintf(stderr, "Error: Missing output file\n");
-                print_usage(argv[0]);
-                return 1;
+    size_t ops = 0, moved = 0, failed = 0;
+    double start = region_begin();
+    for (int round = 0; round < REALLOC_VECTOR_ROUNDS; round++) {
+        char* vec = NULL;
+        for (size_t cap = 16; cap <= REALLOC_VECTOR_MAX; cap *= 2) {
+            char* grown = allocator_realloc(alloc, vec, cap);
+            ops++;
+            if (!grown) {
+                failed++;
+                break;
             }
-            output_file = argv[++i];
-        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            print_usage(argv[0]);
-            return 0;
-        } else {
-            fprintf(stderr, "Error: Unknown option: %s\n", argv[i]);
-            print_usage(argv[0]);
-            return 1;
+            if (vec && grown != vec) moved++;
+            grown[cap - 1] = (char)round;
+            vec = grown;
         }
+        allocator_free(alloc, vec);
     }
+    write_realloc_result(alloc_name, "ReallocVector", region_end(start),
+                         ops, moved, failed, output);
     
-    FILE* output = NULL;
-    if (output_file) {
-        output = fopen(output_file, "w");
-        if (!output) {
-            fprintf(stderr, "Error: Failed to open output file: %s\n", output_file);
-            return 1;
+    unsigned int seed = 42;
+    ops = moved = failed = 0;
+    start = region_begin();
+    for (int round = 0; round < REALLOC_APPEND_ROUNDS; round++) {
+        char* str = NULL;
+        size_t len = 0;
+        while (len < REALLOC_APPEND_MAX) {
+            size_t chunk = 1 + rand_r(&seed) % 32;
+            char* grown = allocator_realloc(alloc, str, len + chunk);
+            ops++;
+            if (!grown) {
+                failed++;
+                break;
+            }
+            if (str && grown != str) moved++;
+            memset(grown + len, 'a', chunk);
+            str = grown;
+            len += chunk;
         }
+        allocator_free(alloc, str);
     }
+    write_realloc_result(alloc_name, "ReallocAppend", region_end(start),
+                         ops, moved, failed, output);
     
-    printf("=== Memory Allocator Benchmark ===\n");
-    printf("Operations per benchmark: %zu\n\n", num_ops);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: пачки узлов одного размера, как у парсера сообщений.
+ * BatchPerObject - allocator_alloc/allocator_free на каждый узел,
+ * Batch - allocator_alloc_batch/allocator_free_batch на всю пачку.
+ * Param - размер пачки */
+#define BATCH_TOTAL_OBJECTS 4000000
+#define BATCH_NODE_SIZE 48
+
+void benchmark_batch(allocator_type_t type, const char* alloc_name, size_t batch, FILE* output) {
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    void** ptrs = calloc(batch, sizeof(void*));
+    if (!alloc || !ptrs) {
+        allocator_destroy(alloc);
+        free(ptrs);
+        return;
+    }
+    size_t rounds = BATCH_TOTAL_OBJECTS / batch;
     
-    if (output) {
-        fprintf(output, "Allocator,Benchmark,Time_us,Operations,Ops_per_sec\n");
-    } else {
-        print_csv_header();
+    for (int mode = 0; mode < 2; mode++) {
+        size_t failed = 0;
+        double start = region_begin();
+        for (size_t round = 0; round < rounds; round++) {
+            if (mode == 0) {
+                for (size_t i = 0; i < batch; i++) {
+                    ptrs[i] = allocator_alloc(alloc, BATCH_NODE_SIZE);
+                    if (!ptrs[i]) failed++;
+                }
+                for (size_t i = 0; i < batch; i++) {
+                    allocator_free(alloc, ptrs[i]);
+                }
+            } else {
+                size_t got = allocator_alloc_batch(alloc, BATCH_NODE_SIZE, ptrs, batch);
+                failed += batch - got;
+                allocator_free_batch(alloc, ptrs, got);
+            }
+        }
+        double elapsed = region_end(start);
+        
+        benchmark_result_t result = {
+            .allocator_name = alloc_name,
+            .benchmark_name = mode == 0 ? "BatchPerObject" : "Batch",
+            .param = batch,
+            .time_us = elapsed,
+            .operations = 2 * rounds * batch,
+            .ops_per_sec = 2 * rounds * batch / (elapsed / 1000000.0),
+            .failed = failed
+        };
+        write_result(output ? output : stdout, &result);
     }
     
-    if (run_all) {
-        run_benchmarks(ALLOCATOR_SEGREGATED_FREELIST, 
-                      "SegregatedFreeList", num_ops, output);
-        run_benchmarks(ALLOCATOR_MCKUSICK_KARELS, 
-                      "McKusickKarels", num_ops, output);
-    } else {
-        const char* name = (alloc_type == ALLOCATOR_SEGREGATED_FREELIST) ? 
-                          "SegregatedFreeList" : "McKusickKarels";
-        run_benchmarks(alloc_type, name, num_ops, output);
+    free(ptrs);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: освобождение в случайном порядке большого числа живых объектов.
+ * FreeUnsized - allocator_free, FreeSized - allocator_free_sized с размером,
+ * известным вызывающему (как у sized delete). Меряется только освобождение.
+ * Param - число живых объектов */
+#define FREE_HEAVY_TOTAL_OBJECTS 2000000
+#define FREE_HEAVY_HEAP_SIZE (256 * 1024 * 1024)
+#define FREE_HEAVY_MAX_SIZE 512
+
+void benchmark_free_sized(allocator_type_t type, const char* alloc_name, size_t live, FILE* output) {
+    allocator_t* alloc = allocator_create(type, FREE_HEAVY_HEAP_SIZE);
+    void** ptrs = calloc(live, sizeof(void*));
+    size_t* sizes = calloc(live, sizeof(size_t));
+    if (!alloc || !ptrs || !sizes) {
+        allocator_destroy(alloc);
+        free(ptrs);
+        free(sizes);
+        return;
+    }
+    size_t rounds = FREE_HEAVY_TOTAL_OBJECTS / live;
+    
+    for (int mode = 0; mode < 2; mode++) {
+        unsigned int seed = 42;
+        size_t failed = 0;
+        double elapsed = 0;
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < live; i++) {
+                sizes[i] = 16 + rand_r(&seed) % (FREE_HEAVY_MAX_SIZE - 15);
+                ptrs[i] = allocator_alloc(alloc, sizes[i]);
+                if (!ptrs[i]) failed++;
+            }
+            // порядок освобождения не совпадает с порядком выделения
+            for (size_t i = live - 1; i > 0; i--) {
+                size_t j = rand_r(&seed) % (i + 1);
+                void* ptr = ptrs[i];
+                size_t size = sizes[i];
+                ptrs[i] = ptrs[j];
+                sizes[i] = sizes[j];
+                ptrs[j] = ptr;
+                sizes[j] = size;
+            }
+            
+            double start = region_begin();
+            if (mode == 0) {
+                for (size_t i = 0; i < live; i++) {
+                    allocator_free(alloc, ptrs[i]);
+                }
+            } else {
+                for (size_t i = 0; i < live; i++) {
+                    allocator_free_sized(alloc, ptrs[i], sizes[i]);
+                }
+            }
+            elapsed += region_end(start);
+        }
+        
+        benchmark_result_t result = {
+            .allocator_name = alloc_name,
+            .benchmark_name = mode == 0 ? "FreeUnsized" : "FreeSized",
+            .param = live,
+            .time_us = elapsed,
+            .operations = rounds * live,
+            .ops_per_sec = rounds * live / (elapsed / 1000000.0),
+            .failed = failed
+        };
+        write_result(output ? output : stdout, &result);
+    }
+    
+    free(ptrs);
+    free(sizes);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: воспроизведение записанной трассы (trace.h, MEMALLOC_TRACE).
+ * Операции всех потоков трассы выполняются в одном потоке в записанном
+ * порядке; каждый выделенный блок пишется по байту на страницу, как его
+ * заполнила бы программа. Раз в REPLAY_SAMPLE_INTERVAL записей (вне замера
+ * времени) снимаются занятое в живых блоках (current_allocated) и RSS.
+ * С latency = true вместо этого каждая операция замеряется отдельно
+ * (гистограммы alloc/free/realloc), строка в CSV не пишется */
+#define REPLAY_HEAP_SIZE ((size_t)1024 * 1024 * 1024) // резервируется лениво
+#define REPLAY_SAMPLE_INTERVAL 4096
+
+/* с гистограммой - замер отдельной операции, без неё - просто вызов */
+#define MAYBE_TIMED(hist, expr) \
+    do { \
+        if (hist) { \
+            LATENCY_TIME(hist, expr); \
+        } else { \
+            expr; \
+        } \
+    } while (0)
+
+static void replay_touch(void* ptr, size_t size) {
+    for (size_t offset = 0; offset < size; offset += 4096) {
+        ((volatile char*)ptr)[offset] = 1;
+    }
+}
+
+// пики занятого аллокатором и RSS; вызывается вне замера
+static void replay_sample(allocator_t* alloc, size_t* peak_footprint, size_t* rss_peak) {
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    if (stats.current_allocated > *peak_footprint) {
+        *peak_footprint = stats.current_allocated;
+    }
+    size_t rss = get_rss_kb();
+    if (rss > *rss_peak) {
+        *rss_peak = rss;
+    }
+}
+
+void benchmark_replay(allocator_type_t type, const char* alloc_name, const trace_t* trace,
+                      bool latency, FILE* output) {
+    size_t num_objects = trace->header.objects ? trace->header.objects : 1;
+    allocator_t* alloc = allocator_create(type, REPLAY_HEAP_SIZE);
+    void** objects = malloc(num_objects * sizeof(void*));
+    if (!alloc || !objects) {
+        allocator_destroy(alloc);
+        free(objects);
+        return;
+    }
+    memset(objects, 0, num_objects * sizeof(void*)); // страницы массива - до замера RSS
+    
+    latency_hist_t* alloc_hist = NULL;
+    latency_hist_t* free_hist = NULL;
+    latency_hist_t* realloc_hist = NULL;
+    if (latency) {
+        alloc_hist = latency_slot(alloc_name, "Replay", "alloc");
+        free_hist = latency_slot(alloc_name, "Replay", "free");
+        realloc_hist = latency_slot(alloc_name, "Replay", "realloc");
+    }
+    
+    size_t rss_before = get_rss_kb(), rss_peak = rss_before;
+    size_t peak_footprint = 0, failed = 0;
+    double elapsed = 0;
+    double start = latency ? 0 : region_begin(); // проход задержек меряет только гистограммы
+    
+    for (size_t i = 0; i < trace->header.records; i++) {
+        const trace_record_t* r = &trace->records[i];
+        void** object = &objects[r->object];
+        switch (r->op) {
+            case TRACE_ALLOC:
+                if (r->align_shift) {
+                    MAYBE_TIMED(alloc_hist, *object = allocator_aligned_alloc(
+                                    alloc, (size_t)1 << r->align_shift, r->size));
+                } else {
+                    MAYBE_TIMED(alloc_hist, *object = allocator_alloc(alloc, r->size));
+                }
+                if (*object) {
+                    replay_touch(*object, r->size);
+                } else if (r->size > 0) {
+                    failed++;
+                }
+                break;
+            case TRACE_FREE:
+                MAYBE_TIMED(free_hist, allocator_free(alloc, *object));
+                *object = NULL;
+                break;
+            case TRACE_FREE_SIZED:
+                MAYBE_TIMED(free_hist, allocator_free_sized(alloc, *object, r->size));
+                *object = NULL;
+                break;
+            case TRACE_REALLOC: {
+                void* ptr;
+                MAYBE_TIMED(realloc_hist, ptr = allocator_realloc(alloc, *object, r->size));
+                if (ptr) {
+                    *object = ptr;
+                    replay_touch(ptr, r->size);
+                } else {
+                    failed++; // старый блок остаётся живым
+                }
+                break;
+            }
+        }
+        
+        if (!latency && (i + 1) % REPLAY_SAMPLE_INTERVAL == 0) {
+            elapsed += region_end(start);
+            replay_sample(alloc, &peak_footprint, &rss_peak);
+            start = region_begin();
+        }
+    }
+    if (!latency) {
+        elapsed += region_end(start);
+        replay_sample(alloc, &peak_footprint, &rss_peak);
+    }
+    
+    for (size_t i = 0; i < num_objects; i++) {
+        allocator_free(alloc, objects[i]);
+    }
+    if (latency) {
+        free(objects);
+        allocator_destroy(alloc);
+        return;
+    }
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "Replay",
+        .param = 1,
+        .time_us = elapsed,
+        .operations = trace->header.records,
+        .ops_per_sec = trace->header.records / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s Replay: %llu records, %u objects, %u threads, peak footprint %zu KB, "
+           "peak RSS +%zu KB, failed %zu\n",
+           alloc_name, (unsigned long long)trace->header.records, trace->header.objects,
+           trace->header.threads, peak_footprint / 1024, rss_peak - rss_before, failed);
+    
+    free(objects);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: задержка отдельных операций (гистограммы alloc и free).
+ * Живое множество из LATENCY_SLOTS объектов: на каждом шаге случайный слот
+ * освобождается и занимается заново. Размеры: 80% - 16-128 байт, 15% - до
+ * 2 КБ, 4.9% - до 64 КБ, 0.1% - 256 КБ-1 МБ (крупные объекты через mmap).
+ * Прогрев - заполнение всех слотов, он не замеряется */
+#define LATENCY_OPS 1000000
+#define LATENCY_SLOTS 4096
+#define LATENCY_HEAP_SIZE (256 * 1024 * 1024)
+
+static size_t latency_size(unsigned int* seed) {
+    unsigned int roll = rand_r(seed) % 1000;
+    if (roll < 800) return 16 + rand_r(seed) % 113;
+    if (roll < 950) return 129 + rand_r(seed) % 1920;
+    if (roll < 999) return 2049 + rand_r(seed) % (62 * 1024);
+    return 256 * 1024 + rand_r(seed) % (768 * 1024);
+}
+
+void benchmark_latency(allocator_type_t type, const char* alloc_name) {
+    allocator_t* alloc = allocator_create(type, LATENCY_HEAP_SIZE);
+    void** slots = calloc(LATENCY_SLOTS, sizeof(void*));
+    if (!alloc || !slots) {
+        allocator_destroy(alloc);
+        free(slots);
+        return;
+    }
+    latency_hist_t* alloc_hist = latency_slot(alloc_name, "Latency", "alloc");
+    latency_hist_t* free_hist = latency_slot(alloc_name, "Latency", "free");
+    
+    unsigned int seed = 42;
+    for (int i = 0; i < LATENCY_SLOTS; i++) {
+        slots[i] = allocator_alloc(alloc, latency_size(&seed));
+    }
+    
+    for (size_t i = 0; i < LATENCY_OPS; i++) {
+        void** slot = &slots[rand_r(&seed) % LATENCY_SLOTS];
+        size_t size = latency_size(&seed);
+        if (*slot) {
+            LATENCY_TIME(free_hist, allocator_free(alloc, *slot));
+        }
+        LATENCY_TIME(alloc_hist, *slot = allocator_alloc(alloc, size));
+        if (*slot) {
+            *(volatile char*)*slot = 1;
+        }
+    }
+    
+    for (int i = 0; i < LATENCY_SLOTS; i++) {
+        allocator_free(alloc, slots[i]);
+    }
+    free(slots);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: худшая задержка на раздробленной куче (гистограммы alloc и
+ * free, смотреть на p99.99 и максимум). WORST_CASE_SLOTS слотов, размеры
+ * равномерны по порядкам от 16 байт до 64 КБ - все через кучу реализации,
+ * без кэшей отображений. Прогрев заполняет все слоты и освобождает каждый
+ * второй, так что свободные блоки всех размеров перемежаются занятыми; шаг -
+ * освободить случайный слот, если он занят, иначе занять его. Первые
+ * WORST_CASE_OPS шагов не замеряются: на них куча проходит первые обращения
+ * к страницам, и хвост показывает сам алгоритм, а не page faults */
+#define WORST_CASE_OPS 2000000
+#define WORST_CASE_SLOTS 16384
+#define WORST_CASE_HEAP_SIZE (256 * 1024 * 1024)
+
+static size_t worst_case_size(unsigned int* seed) {
+    size_t base = (size_t)16 << (rand_r(seed) % 12);
+    return base + rand_r(seed) % base;
+}
+
+static void worst_case_steps(allocator_t* alloc, void** slots, unsigned int* seed,
+                             latency_hist_t* alloc_hist, latency_hist_t* free_hist) {
+    for (size_t i = 0; i < WORST_CASE_OPS; i++) {
+        void** slot = &slots[rand_r(seed) % WORST_CASE_SLOTS];
+        if (*slot) {
+            LATENCY_TIME(free_hist, allocator_free(alloc, *slot));
+            *slot = NULL;
+        } else {
+            size_t size = worst_case_size(seed);
+            LATENCY_TIME(alloc_hist, *slot = allocator_alloc(alloc, size));
+            if (*slot) {
+                *(volatile char*)*slot = 1;
+            }
+        }
+    }
+}
+
+void benchmark_worst_case(allocator_type_t type, const char* alloc_name) {
+    allocator_t* alloc = allocator_create(type, WORST_CASE_HEAP_SIZE);
+    void** slots = calloc(WORST_CASE_SLOTS, sizeof(void*));
+    if (!alloc || !slots) {
+        allocator_destroy(alloc);
+        free(slots);
+        return;
+    }
+    latency_hist_t* alloc_hist = latency_slot(alloc_name, "WorstCase", "alloc");
+    latency_hist_t* free_hist = latency_slot(alloc_name, "WorstCase", "free");
+    
+    unsigned int seed = 42;
+    for (int i = 0; i < WORST_CASE_SLOTS; i++) {
+        slots[i] = allocator_alloc(alloc, worst_case_size(&seed));
+    }
+    for (int i = 0; i < WORST_CASE_SLOTS; i += 2) {
+        allocator_free(alloc, slots[i]);
+        slots[i] = NULL;
+    }
+    
+    worst_case_steps(alloc, slots, &seed, harness.scratch, harness.scratch);
+    worst_case_steps(alloc, slots, &seed, alloc_hist, free_hist);
+    
+    for (int i = 0; i < WORST_CASE_SLOTS; i++) {
+        allocator_free(alloc, slots[i]);
+    }
+    free(slots);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: занятая память во времени на долгой смене живых объектов.
+ * FOOTPRINT_SLOTS слотов; на каждом шаге случайный слот освобождается, если
+ * занят, иначе занимается, так что живых в среднем половина. FootprintChurn -
+ * размеры как в Latency на всём прогоне. FootprintPhases - размеры меняются по
+ * фазам (16-256 байт, 1-8 КБ, снова 16-256 байт), а каждый FOOTPRINT_PINNED-й
+ * слот после заполнения не освобождается до конца и держит страницы под
+ * собой. FOOTPRINT_SAMPLES раз за прогон (вне замера) снимается точка ряда:
+ * запрошено живыми объектами, выдано под них аллокатором (usable size, вместе
+ * с крупными через mmap), занято аллокатором (heap_size - free_bytes плюс
+ * отображения крупных объектов), RSS процесса и наибольший свободный блок */
+#define FOOTPRINT_SLOTS 16384
+#define FOOTPRINT_SAMPLES 200
+#define FOOTPRINT_PINNED 16
+#define FOOTPRINT_HEAP_SIZE (256 * 1024 * 1024)
+
+static size_t footprint_size(bool phased, size_t op, size_t num_ops, unsigned int* seed) {
+    if (!phased) {
+        return latency_size(seed);
+    }
+    return op * 3 / num_ops == 1 ? 1024 + rand_r(seed) % 7169 : 16 + rand_r(seed) % 241;
+}
+
+static void footprint_sample(allocator_t* alloc, const char* alloc_name, const char* bench_name,
+                             size_t ops, double elapsed, size_t requested,
+                             size_t* peak_heap, size_t* peak_rss) {
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    size_t heap_used = stats.heap_size - stats.free_bytes + stats.large_mapped;
+    size_t rss = get_rss_kb() * 1024;
+    if (heap_used > *peak_heap) {
+        *peak_heap = heap_used;
+    }
+    if (rss > *peak_rss) {
+        *peak_rss = rss;
+    }
+    if (harness.last_rep && harness.footprint_output) {
+        fprintf(harness.footprint_output, "%s,%s,%zu,%.2f,%zu,%zu,%zu,%zu,%zu\n",
+                alloc_name, bench_name, ops, elapsed, requested, stats.current_allocated,
+                heap_used, rss, stats.largest_free_block);
+    }
+}
+
+void benchmark_footprint(allocator_type_t type, const char* alloc_name, bool phased,
+                         size_t num_ops, FILE* output) {
+    const char* bench_name = phased ? "FootprintPhases" : "FootprintChurn";
+    allocator_t* alloc = allocator_create(type, FOOTPRINT_HEAP_SIZE);
+    void** slots = calloc(FOOTPRINT_SLOTS, sizeof(void*));
+    size_t* sizes = calloc(FOOTPRINT_SLOTS, sizeof(size_t));
+    if (!alloc || !slots || !sizes) {
+        allocator_destroy(alloc);
+        free(slots);
+        free(sizes);
+        return;
+    }
+    
+    size_t interval = num_ops / FOOTPRINT_SAMPLES ? num_ops / FOOTPRINT_SAMPLES : 1;
+    size_t requested = 0, failed = 0, peak_heap = 0, peak_rss = 0;
+    unsigned int seed = 42;
+    double elapsed = 0;
+    footprint_sample(alloc, alloc_name, bench_name, 0, 0, 0, &peak_heap, &peak_rss);
+    
+    double start = region_begin();
+    for (size_t i = 0; i < num_ops; i++) {
+        size_t idx = rand_r(&seed) % FOOTPRINT_SLOTS;
+        if (slots[idx]) {
+            if (!phased || idx % FOOTPRINT_PINNED != 0) {
+                allocator_free(alloc, slots[idx]);
+                slots[idx] = NULL;
+                requested -= sizes[idx];
+            }
+        } else {
+            size_t size = footprint_size(phased, i, num_ops, &seed);
+            slots[idx] = allocator_alloc(alloc, size);
+            if (slots[idx]) {
+                replay_touch(slots[idx], size);
+                sizes[idx] = size;
+                requested += size;
+            } else {
+                failed++;
+            }
+        }
+        
+        if ((i + 1) % interval == 0) {
+            elapsed += region_end(start);
+            footprint_sample(alloc, alloc_name, bench_name, i + 1, elapsed, requested,
+                             &peak_heap, &peak_rss);
+            start = region_begin();
+        }
+    }
+    elapsed += region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = bench_name,
+        .param = 1,
+        .time_us = elapsed,
+        .operations = num_ops,
+        .ops_per_sec = num_ops / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s %s: peak heap used %zu KB, peak RSS %zu KB, failed %zu\n",
+               alloc_name, bench_name, peak_heap / 1024, peak_rss / 1024, failed);
+    
+    for (int i = 0; i < FOOTPRINT_SLOTS; i++) {
+        allocator_free(alloc, slots[i]);
+    }
+    free(slots);
+    free(sizes);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: смена крупных буферов. LARGE_CHURN_SLOTS живых блоков 4 КБ -
+ * Param КБ, размеры равномерны по порядкам (4-8 КБ так же часты, как
+ * 2-4 МБ); шаг - освободить случайный слот и занять его заново. Вне замера
+ * снимаются точки ряда занятой памяти (как у Footprint*, с -f - в CSV) и
+ * внешняя фрагментация кучи; печатаются пик занятого аллокатором к пику
+ * запрошенного и средняя фрагментация. Операция - пара free/alloc */
+#define LARGE_CHURN_SLOTS 64
+#define LARGE_CHURN_OPS 200000
+#define LARGE_CHURN_MIN (4 * 1024)
+#define LARGE_CHURN_HEAP_SIZE (256 * 1024 * 1024)
+
+static size_t large_churn_size(size_t max_size, unsigned int* seed) {
+    int orders = 0;
+    while (((size_t)LARGE_CHURN_MIN << (orders + 1)) <= max_size) {
+        orders++;
+    }
+    size_t base = (size_t)LARGE_CHURN_MIN << (rand_r(seed) % (orders + 1));
+    size_t size = base + rand_r(seed) % base;
+    return size < max_size ? size : max_size;
+}
+
+void benchmark_large_churn(allocator_type_t type, const char* alloc_name, size_t max_kb,
+                           FILE* output) {
+    allocator_t* alloc = allocator_create(type, LARGE_CHURN_HEAP_SIZE);
+    if (!alloc) return;
+    
+    void* slots[LARGE_CHURN_SLOTS] = {0};
+    size_t sizes[LARGE_CHURN_SLOTS] = {0};
+    size_t max_size = max_kb * 1024;
+    size_t interval = LARGE_CHURN_OPS / FOOTPRINT_SAMPLES;
+    size_t requested = 0, peak_requested = 0, failed = 0, peak_heap = 0, peak_rss = 0;
+    double fragmentation = 0, elapsed = 0;
+    int samples = 0;
+    unsigned int seed = 42;
+    
+    double start = region_begin();
+    for (size_t i = 0; i < LARGE_CHURN_OPS; i++) {
+        size_t idx = rand_r(&seed) % LARGE_CHURN_SLOTS;
+        if (slots[idx]) {
+            allocator_free(alloc, slots[idx]);
+            requested -= sizes[idx];
+        }
+        sizes[idx] = large_churn_size(max_size, &seed);
+        slots[idx] = allocator_alloc(alloc, sizes[idx]);
+        if (slots[idx]) {
+            replay_touch(slots[idx], sizes[idx]);
+            requested += sizes[idx];
+        } else {
+            failed++;
+        }
+        
+        if ((i + 1) % interval == 0) {
+            elapsed += region_end(start);
+            if (requested > peak_requested) {
+                peak_requested = requested;
+            }
+            footprint_sample(alloc, alloc_name, "LargeChurn", i + 1, elapsed, requested,
+                             &peak_heap, &peak_rss);
+            allocator_stats_t stats;
+            allocator_get_stats(alloc, &stats);
+            fragmentation += stats.fragmentation;
+            samples++;
+            start = region_begin();
+        }
+    }
+    elapsed += region_end(start);
+    
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "LargeChurn",
+        .param = max_kb,
+        .time_us = elapsed,
+        .operations = LARGE_CHURN_OPS,
+        .ops_per_sec = LARGE_CHURN_OPS / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    print_info("%s LargeChurn: peak heap used %.2fx peak requested, mean fragmentation %.3f, "
+               "failed %zu\n", alloc_name, (double)peak_heap / peak_requested,
+               fragmentation / samples, failed);
+    
+    for (int i = 0; i < LARGE_CHURN_SLOTS; i++) {
+        allocator_free(alloc, slots[i]);
+    }
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: объекты со временем жизни запроса (разбор сообщения, кадр).
+ * На запрос - Param объектов: 90% по 16-256 байт, 10% по 1-4 КБ, каждый
+ * объект трогается. Первая половина живёт до конца запроса, вторая -
+ * временные объекты вложенного шага. Арена откатывает шаг к метке, а запрос
+ * сбрасывает целиком (allocator_reset), остальные освобождают каждый объект.
+ * Операция - один объект (выделение вместе с освобождением) */
+#define REQUEST_TOTAL_OBJECTS 4000000
+#define REQUEST_HEAP_SIZE (64 * 1024 * 1024)
+
+void benchmark_request_scoped(allocator_type_t type, const char* alloc_name, size_t per_request,
+                              FILE* output) {
+    allocator_t* alloc = allocator_create(type, REQUEST_HEAP_SIZE);
+    void** ptrs = calloc(per_request, sizeof(void*));
+    size_t* sizes = calloc(per_request, sizeof(size_t));
+    if (!alloc || !ptrs || !sizes) {
+        allocator_destroy(alloc);
+        free(ptrs);
+        free(sizes);
+        return;
+    }
+    
+    // размеры одни на все запросы, чтобы генератор не попадал в замер
+    unsigned int seed = 42;
+    for (size_t i = 0; i < per_request; i++) {
+        sizes[i] = rand_r(&seed) % 10 == 0 ? 1024 + rand_r(&seed) % 3073 : 16 + rand_r(&seed) % 241;
+    }
+    bool arena = type == ALLOCATOR_ARENA;
+    size_t half = per_request / 2;
+    size_t requests = REQUEST_TOTAL_OBJECTS / per_request;
+    size_t failed = 0;
+    
+    double start = region_begin();
+    for (size_t r = 0; r < requests; r++) {
+        for (size_t i = 0; i < half; i++) {
+            ptrs[i] = allocator_alloc(alloc, sizes[i]);
+            if (ptrs[i]) {
+                ((volatile char*)ptrs[i])[0] = (char)i;
+            } else {
+                failed++;
+            }
+        }
+        
+        allocator_mark_t step = allocator_mark(alloc);
+        for (size_t i = half; i < per_request; i++) {
+            ptrs[i] = allocator_alloc(alloc, sizes[i]);
+            if (ptrs[i]) {
+                ((volatile char*)ptrs[i])[0] = (char)i;
+            } else {
+                failed++;
+            }
+        }
+        if (arena) {
+            allocator_rewind(alloc, step);
+        } else {
+            for (size_t i = half; i < per_request; i++) {
+                allocator_free(alloc, ptrs[i]);
+            }
+        }
+        
+        if (arena) {
+            allocator_reset(alloc);
+        } else {
+            for (size_t i = 0; i < half; i++) {
+                allocator_free(alloc, ptrs[i]);
+            }
+        }
+    }
+    double elapsed = region_end(start);
+    
+    size_t objects = requests * per_request;
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = "RequestScoped",
+        .param = per_request,
+        .time_us = elapsed,
+        .operations = objects,
+        .ops_per_sec = objects / (elapsed / 1000000.0),
+        .failed = failed
+    };
+    write_result(output ? output : stdout, &result);
+    
+    free(ptrs);
+    free(sizes);
+    allocator_destroy(alloc);
+}
+
+/* Benchmark: объекты с дорогой инициализацией (сессия с мьютексом и таблицей
+ * счётчиков). ObjectInit - allocator_alloc, конструктор, деструктор и
+ * allocator_free на каждый объект; ObjectCache - objcache_alloc/objcache_free,
+ * объект возвращается сконструированным. Раундами по Param живых объектов,
+ * каждый объект используется (lock, счётчик, unlock). Операция - один объект */
+#define OBJECT_TOTAL 2000000
+
+typedef struct session {
+    pthread_mutex_t lock;
+    size_t refs;
+    uint32_t counters[32];
+    char name[64];
+    struct session* next;
+} session_t;
+
+static void session_ctor(void* obj) {
+    session_t* s = obj;
+    pthread_mutex_init(&s->lock, NULL);
+    s->refs = 0;
+    memset(s->counters, 0, sizeof(s->counters));
+    memset(s->name, 0, sizeof(s->name));
+    s->next = NULL;
+}
+
+static void session_dtor(void* obj) {
+    session_t* s = obj;
+    pthread_mutex_destroy(&s->lock);
+}
+
+static void session_use(session_t* s, size_t i) {
+    pthread_mutex_lock(&s->lock);
+    s->refs++;
+    s->counters[i % 32]++;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void benchmark_object_cache(allocator_type_t type, const char* alloc_name, size_t live,
+                            FILE* output) {
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    objcache_t* cache = objcache_create(sizeof(session_t), 0, session_ctor, session_dtor);
+    session_t** objs = calloc(live, sizeof(session_t*));
+    if (!alloc || !cache || !objs) {
+        allocator_destroy(alloc);
+        objcache_destroy(cache);
+        free(objs);
+        return;
+    }
+    size_t rounds = OBJECT_TOTAL / live;
+    
+    for (int mode = 0; mode < 2; mode++) {
+        size_t failed = 0;
+        double start = region_begin();
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < live; i++) {
+                if (mode == 0) {
+                    objs[i] = allocator_alloc(alloc, sizeof(session_t));
+                    if (objs[i]) {
+                        session_ctor(objs[i]);
+                    }
+                } else {
+                    objs[i] = objcache_alloc(cache);
+                }
+                if (objs[i]) {
+                    session_use(objs[i], i);
+                } else {
+                    failed++;
+                }
+            }
+            for (size_t i = 0; i < live; i++) {
+                if (!objs[i]) {
+                    continue;
+                }
+                // объект возвращается кэшу в начальном состоянии
+                objs[i]->refs = 0;
+                if (mode == 0) {
+                    session_dtor(objs[i]);
+                    allocator_free(alloc, objs[i]);
+                } else {
+                    objcache_free(cache, objs[i]);
+                }
+            }
+        }
+        double elapsed = region_end(start);
+        
+        benchmark_result_t result = {
+            .allocator_name = alloc_name,
+            .benchmark_name = mode == 0 ? "ObjectInit" : "ObjectCache",
+            .param = live,
+            .time_us = elapsed,
+            .operations = rounds * live,
+            .ops_per_sec = rounds * live / (elapsed / 1000000.0),
+            .failed = failed
+        };
+        write_result(output ? output : stdout, &result);
+    }
+    
+    objcache_stats_t stats;
+    objcache_get_stats(cache, &stats);
+    print_info("%s ObjectCache %zu: %zu constructor calls for %zu allocations, %zu colors\n",
+               alloc_name, live, stats.constructed, stats.allocations, stats.colors);
+    
+    free(objs);
+    objcache_destroy(cache);
+    allocator_destroy(alloc);
+}
+
+/* ===== Многопоточные сценарии ===== */
+
+/* Общий запуск: потоки стартуют одновременно после барьера,
+ * время меряется от барьера до завершения последнего потока */
+typedef struct {
+    pthread_barrier_t start;
+    allocator_t* alloc;
+    int threads;
+    size_t ops_per_thread;
+} mt_shared_t;
+
+typedef struct {
+    mt_shared_t* shared;
+    int id;
+    void* data; // данные сценария
+} mt_arg_t;
+
+static double run_threads(mt_shared_t* shared, void* (*worker)(void*), mt_arg_t* args) {
+    pthread_t tids[MAX_THREADS];
+    
+    pthread_barrier_init(&shared->start, NULL, shared->threads + 1);
+    for (int i = 0; i < shared->threads; i++) {
+        args[i].shared = shared;
+        args[i].id = i;
+        pthread_create(&tids[i], NULL, worker, &args[i]);
+        if (harness.pin_cpu >= 0) {
+            timing_pin_thread(tids[i], harness.pin_cpu + i);
+        }
+    }
+    
+    pthread_barrier_wait(&shared->start);
+    double start = region_begin();
+    for (int i = 0; i < shared->threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = region_end(start);
+    
+    pthread_barrier_destroy(&shared->start);
+    return elapsed;
+}
+
+static void write_mt_result(const char* alloc_name, const char* bench_name, int threads,
+                            double elapsed, size_t operations, FILE* output) {
+    benchmark_result_t result = {
+        .allocator_name = alloc_name,
+        .benchmark_name = bench_name,
+        .param = threads,
+        .time_us = elapsed,
+        .operations = operations,
+        .ops_per_sec = operations / (elapsed / 1000000.0)
+    };
+    write_result(output ? output : stdout, &result);
+}
+
+/* Threadtest (Hoard): каждый поток пачками выделяет и освобождает
+ * свои объекты; общий объём работы делится между потоками */
+#define THREADTEST_BATCH 100
+
+static void* threadtest_worker(void* arg) {
+    mt_arg_t* a = (mt_arg_t*)arg;
+    allocator_t* alloc = a->shared->alloc;
+    void* ptrs[THREADTEST_BATCH];
+    size_t rounds = a->shared->ops_per_thread / (2 * THREADTEST_BATCH);
+    
+    pthread_barrier_wait(&a->shared->start);
+    
+    for (size_t r = 0; r < rounds; r++) {
+        for (int i = 0; i < THREADTEST_BATCH; i++) {
+            ptrs[i] = allocator_alloc(alloc, 64);
+        }
+        for (int i = 0; i < THREADTEST_BATCH; i++) {
+            allocator_free(alloc, ptrs[i]);
+        }
+    }
+    return NULL;
+}
+
+void benchmark_threadtest(allocator_type_t type, const char* alloc_name, size_t num_ops,
+                          int threads, FILE* output) {
+    mt_shared_t shared = {
+        .alloc = allocator_create(type, DEFAULT_HEAP_SIZE),
+        .threads = threads,
+        .ops_per_thread = num_ops / threads
+    };
+    if (!shared.alloc) return;
+    
+    mt_arg_t args[MAX_THREADS];
+    double elapsed = run_threads(&shared, threadtest_worker, args);
+    
+    size_t rounds = shared.ops_per_thread / (2 * THREADTEST_BATCH);
+    write_mt_result(alloc_name, "Threadtest", threads, elapsed,
+                    rounds * 2 * THREADTEST_BATCH * threads, output);
+    allocator_destroy(shared.alloc);
+}
+
+/* Larson: у каждого потока массив живых объектов; поток заменяет
+ * случайные объекты новыми случайного размера. После каждого раунда
+ * массивы передаются соседнему потоку, так что объекты освобождает
+ * не тот поток, который их выделил */
+#define LARSON_SLOTS 1000
+#define LARSON_ROUNDS 10
+
+typedef struct {
+    void* slots[MAX_THREADS][LARSON_SLOTS];
+} larson_state_t;
+
+static void* larson_worker(void* arg) {
+    mt_arg_t* a = (mt_arg_t*)arg;
+    allocator_t* alloc = a->shared->alloc;
+    larson_state_t* state = (larson_state_t*)a->data;
+    int threads = a->shared->threads;
+    size_t ops_per_round = a->shared->ops_per_thread / LARSON_ROUNDS;
+    unsigned int seed = 42 + a->id;
+    
+    pthread_barrier_wait(&a->shared->start);
+    
+    for (int round = 0; round < LARSON_ROUNDS; round++) {
+        void** slots = state->slots[(a->id + round) % threads];
+        
+        for (size_t i = 0; i < ops_per_round; i++) {
+            int idx = rand_r(&seed) % LARSON_SLOTS;
+            allocator_free(alloc, slots[idx]);
+            slots[idx] = allocator_alloc(alloc, 16 + rand_r(&seed) % 512);
+        }
+        
+        pthread_barrier_wait(&a->shared->start);
+    }
+    return NULL;
+}
+
+void benchmark_larson(allocator_type_t type, const char* alloc_name, size_t num_ops,
+                      int threads, FILE* output) {
+    mt_shared_t shared = {
+        .alloc = allocator_create(type, DEFAULT_HEAP_SIZE),
+        .threads = threads,
+        .ops_per_thread = num_ops / threads
+    };
+    larson_state_t* state = calloc(1, sizeof(larson_state_t));
+    if (!shared.alloc || !state) {
+        allocator_destroy(shared.alloc);
+        free(state);
+        return;
+    }
+    
+    // стартовое заполнение вне замера
+    srand(42);
+    for (int t = 0; t < threads; t++) {
+        for (int i = 0; i < LARSON_SLOTS; i++) {
+            state->slots[t][i] = allocator_alloc(shared.alloc, 16 + rand() % 512);
+        }
+    }
+    
+    mt_arg_t args[MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        args[i].data = state;
+    }
+    
+    // барьер раундов использует тот же start, поэтому main
+    // проходит его вместе с потоками LARSON_ROUNDS раз
+    pthread_t tids[MAX_THREADS];
+    pthread_barrier_init(&shared.start, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        args[i].shared = &shared;
+        args[i].id = i;
+        pthread_create(&tids[i], NULL, larson_worker, &args[i]);
+    }
+    pthread_barrier_wait(&shared.start);
+    double start = region_begin();
+    for (int round = 0; round < LARSON_ROUNDS; round++) {
+        pthread_barrier_wait(&shared.start);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = region_end(start);
+    pthread_barrier_destroy(&shared.start);
+    
+    size_t ops_per_round = shared.ops_per_thread / LARSON_ROUNDS;
+    write_mt_result(alloc_name, "Larson", threads, elapsed,
+                    ops_per_round * LARSON_ROUNDS * 2 * threads, output);
+    
+    for (int t = 0; t < threads; t++) {
+        for (int i = 0; i < LARSON_SLOTS; i++) {
+            allocator_free(shared.alloc, state->slots[t][i]);
+        }
+    }
+    free(state);
+    allocator_destroy(shared.alloc);
+}
+
+/* Producer-consumer: пары потоков, производитель выделяет объекты
+ * и передаёт их через кольцевой буфер потребителю, тот освобождает */
+#define RING_SIZE 1024
+
+typedef struct {
+    void* items[RING_SIZE];
+    size_t head; // пишет только потребитель
+    char pad[64];
+    size_t tail; // пишет только производитель
+} spsc_ring_t;
+
+static void* producer_worker(void* arg) {
+    mt_arg_t* a = (mt_arg_t*)arg;
+    spsc_ring_t* ring = (spsc_ring_t*)a->data;
+    size_t count = a->shared->ops_per_thread;
+    
+    pthread_barrier_wait(&a->shared->start);
+    
+    for (size_t i = 0; i < count; i++) {
+        void* ptr = allocator_alloc(a->shared->alloc, 32 + (i % 8) * 32);
+        size_t tail = ring->tail;
+        while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING_SIZE) {
+            sched_yield();
+        }
+        ring->items[tail % RING_SIZE] = ptr;
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void* consumer_worker(void* arg) {
+    mt_arg_t* a = (mt_arg_t*)arg;
+    spsc_ring_t* ring = (spsc_ring_t*)a->data;
+    size_t count = a->shared->ops_per_thread;
+    
+    pthread_barrier_wait(&a->shared->start);
+    
+    for (size_t i = 0; i < count; i++) {
+        size_t head = ring->head;
+        while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+            sched_yield();
+        }
+        void* ptr = ring->items[head % RING_SIZE];
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        allocator_free(a->shared->alloc, ptr);
+    }
+    return NULL;
+}
+
+static void* prodcons_worker(void* arg) {
+    mt_arg_t* a = (mt_arg_t*)arg;
+    return (a->id % 2 == 0) ? producer_worker(arg) : consumer_worker(arg);
+}
+
+void benchmark_producer_consumer(allocator_type_t type, const char* alloc_name, size_t num_ops,
+                                 int threads, FILE* output) {
+    if (threads < 2) return;
+    
+    int pairs = threads / 2;
+    mt_shared_t shared = {
+        .alloc = allocator_create(type, DEFAULT_HEAP_SIZE),
+        .threads = pairs * 2,
+        .ops_per_thread = num_ops / (pairs * 2)
+    };
+    spsc_ring_t* rings = calloc(pairs, sizeof(spsc_ring_t));
+    if (!shared.alloc || !rings) {
+        allocator_destroy(shared.alloc);
+        free(rings);
+        return;
+    }
+    
+    mt_arg_t args[MAX_THREADS];
+    for (int i = 0; i < pairs * 2; i++) {
+        args[i].data = &rings[i / 2];
+    }
+    double elapsed = run_threads(&shared, prodcons_worker, args);
+    
+    write_mt_result(alloc_name, "ProducerConsumer", pairs * 2, elapsed,
+                    shared.ops_per_thread * pairs * 2, output);
+    free(rings);
+    allocator_destroy(shared.alloc);
+}
+
+/* Прогон многопоточных сценариев для 1, 2, 4, ... max_threads потоков */
+void run_thread_sweep(allocator_type_t type, const char* name, size_t num_ops,
+                      int max_threads, FILE* output) {
+    // многопоточным сценариям нужно больше работы, чем однопоточным
+    size_t total_ops = num_ops * 100;
+    
+    int next;
+    for (int threads = 1; threads <= max_threads; threads = next) {
+        benchmark_threadtest(type, name, total_ops, threads, output);
+        benchmark_larson(type, name, total_ops, threads, output);
+        benchmark_producer_consumer(type, name, total_ops, threads, output);
+        
+        next = threads * 2;
+        if (next > max_threads && threads < max_threads) {
+            next = max_threads; // последним шагом - ровно max_threads
+        }
+    }
+}
+
+void run_benchmarks(allocator_type_t type, const char* name, size_t num_ops,
+                    int max_threads, FILE* output) {
+    printf("Running benchmarks for %s...\n", name);
+    
+    // арена не освобождает объекты по одному: общие сценарии её исчерпают
+    if (type == ALLOCATOR_ARENA) {
+        for (size_t per_request = 16; per_request <= 4096; per_request *= 16) {
+            benchmark_request_scoped(type, name, per_request, output);
+        }
+        return;
+    }
+    
+    allocator_t* alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    if (!alloc) {
+        fprintf(stderr, "Failed to create allocator: %s\n", name);
+        return;
+    }
+    
+    benchmark_sequential(alloc, name, num_ops, output);
+    allocator_destroy(alloc);
+    
+    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    benchmark_random(alloc, name, num_ops, output);
+    allocator_destroy(alloc);
+    
+    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    benchmark_mixed(alloc, name, num_ops, output);
+    allocator_destroy(alloc);
+    
+    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    benchmark_stress(alloc, name, num_ops, output);
+    allocator_destroy(alloc);
+    
+    // миллионы операций: num_ops * 200
+    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    benchmark_churn(alloc, name, num_ops * 200, output);
+    allocator_destroy(alloc);
+    
+    alloc = allocator_create(type, DEFAULT_HEAP_SIZE);
+    benchmark_size_classes(alloc, name, num_ops, output);
+    allocator_destroy(alloc);
+    
+    benchmark_burst(type, name, output);
+    
+    for (size_t blocks = 64; blocks <= 8192; blocks *= 4) {
+        benchmark_large_lookup(type, name, blocks, output);
+    }
+    
+    for (size_t obj_size = 16; obj_size <= 256; obj_size *= 4) {
+        benchmark_fill_page(type, name, obj_size, output);
+    }
+    
+    for (size_t size = 4096; size <= 64 * 1024 * 1024; size *= 4) {
+        benchmark_large_sizes(type, name, size, output);
+    }
+    
+    benchmark_realloc_growth(type, name, output);
+    
+    for (size_t batch = 16; batch <= 1024; batch *= 4) {
+        benchmark_batch(type, name, batch, output);
+    }
+    
+    for (size_t live = 1024; live <= 262144; live *= 16) {
+        benchmark_free_sized(type, name, live, output);
+    }
+    
+    benchmark_latency(type, name);
+    benchmark_worst_case(type, name);
+    
+    // миллионы операций: num_ops * 400
+    benchmark_footprint(type, name, false, num_ops * 400, output);
+    benchmark_footprint(type, name, true, num_ops * 400, output);
+    
+    for (size_t per_request = 16; per_request <= 4096; per_request *= 16) {
+        benchmark_request_scoped(type, name, per_request, output);
+    }
+    
+    benchmark_large_churn(type, name, 4096, output);
+    
+    for (size_t live = 16; live <= 4096; live *= 16) {
+        benchmark_object_cache(type, name, live, output);
+    }
+    
+    if (max_threads > 0) {
+        run_thread_sweep(type, name, num_ops, max_threads, output);
+    }
+}
+
+/* Прогон набора (или воспроизведения трассы) с прогревом и повторами */
+void run_repeated(allocator_type_t type, const char* name, size_t num_ops, int max_threads,
+                  const trace_t* trace, FILE* output) {
+    int total = harness.warmup + harness.reps;
+    for (int rep = 0; rep < total; rep++) {
+        harness.measuring = rep >= harness.warmup;
+        harness.last_rep = rep == total - 1;
+        if (trace) {
+            benchmark_replay(type, name, trace, false, output);
+            benchmark_replay(type, name, trace, true, output);
+        } else {
+            run_benchmarks(type, name, num_ops, max_threads, output);
+        }
+    }
+    flush_results(output);
+}
+
+void print_usage(const char* prog_name) {
+    printf("Usage: %s [OPTIONS]\n", prog_name);
+    printf("Options:\n");
+    printf("  -a, --allocator <type>   Allocator type: segregated, mckusick, arena, buddy,\n");
+    printf("                           tlsf, all (default: all)\n");
+    printf("  -n, --num-ops <number>   Number of operations (default: 10000)\n");
+    printf("  -t, --threads <number>   Max threads for multi-threaded sweep 1,2,4..N\n");
+    printf("                           (default: number of CPUs, 0 - skip)\n");
+    printf("  -o, --output <file>      Output CSV file (default: stdout)\n");
+    printf("  -r, --replay <file>      Replay a recorded allocation trace instead of\n");
+    printf("                           the benchmark suite\n");
+    printf("  -w, --warmup <number>    Unmeasured warmup runs (default: 1)\n");
+    printf("  -R, --reps <number>      Measured runs, CSV has mean and stddev (default: 5)\n");
+    printf("  -p, --pin <cpu>          Pin the main thread to <cpu>, worker i to <cpu>+i\n");
+    printf("  -l, --latency <file>     Per-op latency percentiles CSV (alloc/free)\n");
+    printf("  -f, --footprint <file>   Memory footprint time series CSV (Footprint*)\n");
+    printf("  -c, --counters           Hardware counters per op via perf_event_open\n");
+    printf("                           (cycles, instructions, cache/TLB/branch misses)\n");
+    printf("  -h, --help               Show this help message\n");
+}
+
+int main(int argc, char* argv[]) {
+    allocator_type_t alloc_type = -1;
+    size_t num_ops = 10000;
+    const char* output_file = NULL;
+    const char* replay_file = NULL;
+    const char* latency_file = NULL;
+    const char* footprint_file = NULL;
+    bool run_all = true;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--allocator") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing allocator type\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            const char* type = argv[++i];
+            if (strcmp(type, "segregated") == 0) {
+                alloc_type = ALLOCATOR_SEGREGATED_FREELIST;
+                run_all = false;
+            } else if (strcmp(type, "mckusick") == 0) {
+                alloc_type = ALLOCATOR_MCKUSICK_KARELS;
+                run_all = false;
+            } else if (strcmp(type, "arena") == 0) {
+                alloc_type = ALLOCATOR_ARENA;
+                run_all = false;
+            } else if (strcmp(type, "buddy") == 0) {
+                alloc_type = ALLOCATOR_BUDDY;
+                run_all = false;
+            } else if (strcmp(type, "tlsf") == 0) {
+                alloc_type = ALLOCATOR_TLSF;
+                run_all = false;
+            } else if (strcmp(type, "all") == 0) {
+                run_all = true;
+            } else {
+                fprintf(stderr, "Error: Unknown allocator type: %s\n", type);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--num-ops") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing number of operations\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            num_ops = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing number of threads\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            max_threads = atoi(argv[++i]);
+            if (max_threads < 0 || max_threads > MAX_THREADS) {
+                fprintf(stderr, "Error: Threads must be in 0..%d\n", MAX_THREADS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing output file\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            output_file = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--replay") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing trace file\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--warmup") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing number of warmup runs\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            harness.warmup = atoi(argv[++i]);
+            if (harness.warmup < 0) {
+                fprintf(stderr, "Error: Warmup runs must be >= 0\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--reps") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing number of repetitions\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            harness.reps = atoi(argv[++i]);
+            if (harness.reps < 1) {
+                fprintf(stderr, "Error: Repetitions must be >= 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pin") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing CPU number\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            harness.pin_cpu = atoi(argv[++i]);
+            if (harness.pin_cpu < 0) {
+                fprintf(stderr, "Error: CPU number must be >= 0\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--latency") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing latency output file\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            latency_file = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--footprint") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: Missing footprint output file\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            footprint_file = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--counters") == 0) {
+            harness.counters = true;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "Error: Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    trace_t* trace = NULL;
+    if (replay_file) {
+        trace = trace_load(replay_file);
+        if (!trace) {
+            fprintf(stderr, "Error: Failed to load trace: %s\n", replay_file);
+            return 1;
+        }
+    }
+    
+    FILE* output = NULL;
+    if (output_file) {
+        output = fopen(output_file, "w");
+        if (!output) {
+            fprintf(stderr, "Error: Failed to open output file: %s\n", output_file);
+            return 1;
+        }
+    }
+    
+    if (latency_file) {
+        harness.latency_output = fopen(latency_file, "w");
+        if (!harness.latency_output) {
+            fprintf(stderr, "Error: Failed to open latency file: %s\n", latency_file);
+            return 1;
+        }
+        fprintf(harness.latency_output, LATENCY_CSV_HEADER);
+    }
+    if (footprint_file) {
+        harness.footprint_output = fopen(footprint_file, "w");
+        if (!harness.footprint_output) {
+            fprintf(stderr, "Error: Failed to open footprint file: %s\n", footprint_file);
+            return 1;
+        }
+        fprintf(harness.footprint_output, FOOTPRINT_CSV_HEADER);
+    }
+    harness.scratch = calloc(1, sizeof(latency_hist_t));
+    if (!harness.scratch) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    if (harness.pin_cpu >= 0 && !timing_pin_thread(pthread_self(), harness.pin_cpu)) {
+        fprintf(stderr, "Warning: Failed to pin to CPU %d\n", harness.pin_cpu);
+    }
+    timing_calibrate();
+    // потоки сценариев создаются позже и наследуют счётчики (inherit)
+    if (harness.counters && !perf_counters_open()) {
+        fprintf(stderr, "Warning: No perf counters available, counter columns stay empty\n");
+        harness.counters = false;
+    }
+    
+    printf("=== Memory Allocator Benchmark ===\n");
+    printf("Operations per benchmark: %zu\n", num_ops);
+    printf("Max threads: %d\n", max_threads);
+    printf("Runs: %d measured + %d warmup\n", harness.reps, harness.warmup);
+    printf("Tick counter: %.3f ticks/ns, %llu ticks per empty measurement\n",
+           timing_ticks_per_ns(), (unsigned long long)timing_overhead_ticks());
+    if (harness.counters) {
+        printf("Perf counters:");
+        for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+            if (perf_counters_available(i)) {
+                printf(" %s", perf_counter_name(i));
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
+    
+    if (output) {
+        fprintf(output, CSV_HEADER);
+    } else {
+        print_csv_header();
+    }
+    
+    if (run_all) {
+        run_repeated(ALLOCATOR_SEGREGATED_FREELIST, 
+                     "SegregatedFreeList", num_ops, max_threads, trace, output);
+        run_repeated(ALLOCATOR_MCKUSICK_KARELS, 
+                     "McKusickKarels", num_ops, max_threads, trace, output);
+        run_repeated(ALLOCATOR_ARENA, 
+                     "Arena", num_ops, max_threads, trace, output);
+        run_repeated(ALLOCATOR_BUDDY, 
+                     "Buddy", num_ops, max_threads, trace, output);
+        run_repeated(ALLOCATOR_TLSF, 
+                     "TLSF", num_ops, max_threads, trace, output);
+    } else {
+        const char* name = alloc_type == ALLOCATOR_SEGREGATED_FREELIST ? "SegregatedFreeList"
+                         : alloc_type == ALLOCATOR_MCKUSICK_KARELS ? "McKusickKarels"
+                         : alloc_type == ALLOCATOR_ARENA ? "Arena"
+                         : alloc_type == ALLOCATOR_BUDDY ? "Buddy" : "TLSF";
+        run_repeated(alloc_type, name, num_ops, max_threads, trace, output);
+    }
+    trace_free(trace);
+    free(harness.scratch);
+    if (harness.counters) {
+        perf_counters_close();
+    }
+    if (harness.latency_output) {
+        fclose(harness.latency_output);
+        printf("Latency percentiles written to: %s\n", latency_file);
+    }
+    if (harness.footprint_output) {
+        fclose(harness.footprint_output);
+        printf("Footprint time series written to: %s\n", footprint_file);
     }
     
     if (output) {
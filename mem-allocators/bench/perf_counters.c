@@ -0,0 +1,135 @@
+#include "perf_counters.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define HW_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+} events[PERF_NUM_COUNTERS] = {
+    [PERF_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_L1D_MISSES] = { "L1d-misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [PERF_LLC_MISSES] = { "LLC-misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+    [PERF_DTLB_MISSES] = { "dTLB-misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+    [PERF_BRANCH_MISSES] = { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [PERF_PAGE_FAULTS] = { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+// значение, time_enabled, time_running (PERF_FORMAT_TOTAL_TIME_*)
+typedef struct {
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+} perf_read_t;
+
+static int fds[PERF_NUM_COUNTERS];
+static bool opened[PERF_NUM_COUNTERS];
+static perf_read_t last[PERF_NUM_COUNTERS];
+
+static int open_event(perf_counter_t counter, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[counter].type;
+    attr.config = events[counter].config;
+    attr.disabled = 1;
+    attr.inherit = 1; // потоки многопоточных сценариев
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static bool read_event(perf_counter_t counter, perf_read_t* out) {
+    return read(fds[counter], out, sizeof(*out)) == (ssize_t)sizeof(*out);
+}
+
+bool perf_counters_open(void) {
+    bool any = false;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        // с ядром, а если не пускает perf_event_paranoid - только пользовательский код
+        int fd = open_event(i, false);
+        bool user_only = false;
+        if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+            fd = open_event(i, true);
+            user_only = true;
+        }
+        if (fd < 0) {
+            fprintf(stderr, "Warning: counter %s unavailable: %s\n", events[i].name, strerror(errno));
+            continue;
+        }
+        if (user_only) {
+            fprintf(stderr, "Note: counter %s counts user space only\n", events[i].name);
+        }
+        fds[i] = fd;
+        opened[i] = true;
+        read_event(i, &last[i]);
+        any = true;
+    }
+    return any;
+}
+
+void perf_counters_close(void) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (opened[i]) {
+            close(fds[i]);
+            opened[i] = false;
+        }
+    }
+}
+
+bool perf_counters_available(perf_counter_t counter) {
+    return opened[counter];
+}
+
+const char* perf_counter_name(perf_counter_t counter) {
+    return events[counter].name;
+}
+
+void perf_counters_start(void) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (opened[i]) {
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void perf_counters_stop(void) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (opened[i]) {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+void perf_counters_take(perf_sample_t* sample) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        perf_read_t now;
+        sample->values[i] = 0;
+        sample->valid[i] = opened[i] && read_event(i, &now);
+        if (!sample->valid[i]) {
+            continue;
+        }
+
+        uint64_t value = now.value - last[i].value;
+        uint64_t enabled = now.enabled - last[i].enabled;
+        uint64_t running = now.running - last[i].running;
+        last[i] = now;
+        // был включён, но ни разу не попал на регистр - значение неизвестно
+        if (enabled > 0 && running == 0) {
+            sample->valid[i] = false;
+            continue;
+        }
+        sample->values[i] = running > 0 && running < enabled
+                          ? (double)value * enabled / running : (double)value;
+    }
+}
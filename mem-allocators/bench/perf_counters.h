@@ -0,0 +1,42 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Аппаратные счётчики через perf_event_open. Каждый счётчик открывается
+ * отдельно (не группой), поэтому при нехватке регистров ядро их
+ * мультиплексирует, а значения масштабируются по time_enabled/time_running.
+ * Счётчики, которые открыть не удалось (нет PMU в виртуальной машине,
+ * perf_event_paranoid, событие не поддерживается), просто отсутствуют */
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES, // промахи чтения L1d
+    PERF_LLC_MISSES, // промахи чтения последнего уровня кэша
+    PERF_DTLB_MISSES, // промахи чтения dTLB
+    PERF_BRANCH_MISSES,
+    PERF_PAGE_FAULTS, // программный счётчик ядра
+    PERF_NUM_COUNTERS
+} perf_counter_t;
+
+typedef struct {
+    double values[PERF_NUM_COUNTERS];
+    bool valid[PERF_NUM_COUNTERS];
+} perf_sample_t;
+
+/* Открывает счётчики для текущего потока и потоков, созданных после этого
+ * (inherit). false - не открылся ни один; причины печатаются в stderr */
+bool perf_counters_open(void);
+void perf_counters_close(void);
+bool perf_counters_available(perf_counter_t counter);
+const char* perf_counter_name(perf_counter_t counter);
+
+/* Счёт идёт только между start и stop; пары могут повторяться */
+void perf_counters_start(void);
+void perf_counters_stop(void);
+
+/* Значения с прошлого вызова (масштабированные при мультиплексировании) */
+void perf_counters_take(perf_sample_t* sample);
+
+#endif
@@ -0,0 +1,109 @@
+#include "timing.h"
+#include <math.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CALIBRATE_NS 50000000 // 50 мс на оценку частоты счётчика
+#define OVERHEAD_SAMPLES 10000
+
+static double ticks_per_ns = 1.0;
+static uint64_t overhead_ticks;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void timing_calibrate(void) {
+    uint64_t start_ns = now_ns();
+    uint64_t start_ticks = timing_ticks();
+    uint64_t elapsed_ns;
+    do {
+        elapsed_ns = now_ns() - start_ns;
+    } while (elapsed_ns < CALIBRATE_NS);
+    ticks_per_ns = (double)(timing_ticks() - start_ticks) / elapsed_ns;
+
+    // минимум пустых замеров: так меряется сам счётчик, без прерываний
+    overhead_ticks = UINT64_MAX;
+    for (int i = 0; i < OVERHEAD_SAMPLES; i++) {
+        uint64_t start = timing_ticks();
+        uint64_t ticks = timing_ticks() - start;
+        if (ticks < overhead_ticks) {
+            overhead_ticks = ticks;
+        }
+    }
+}
+
+double timing_ticks_per_ns(void) {
+    return ticks_per_ns;
+}
+
+uint64_t timing_overhead_ticks(void) {
+    return overhead_ticks;
+}
+
+bool timing_pin_thread(pthread_t thread, int cpu) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % (cpus > 0 ? cpus : 1), &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+void latency_reset(latency_hist_t* hist) {
+    memset(hist, 0, sizeof(latency_hist_t));
+}
+
+void latency_merge(latency_hist_t* dst, const latency_hist_t* src) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+// наибольшее значение, попадающее в корзину
+static uint64_t bucket_highest(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(bucket - shift * LATENCY_SUB_BUCKETS) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+static double ticks_to_ns(double ticks) {
+    ticks -= (double)overhead_ticks;
+    return ticks > 0 ? ticks / ticks_per_ns : 0;
+}
+
+double latency_percentile_ns(const latency_hist_t* hist, double pct) {
+    if (hist->total == 0) return 0;
+
+    uint64_t rank = (uint64_t)ceil(pct / 100.0 * hist->total);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_highest(i);
+            return ticks_to_ns((double)(value < hist->max ? value : hist->max));
+        }
+    }
+    return ticks_to_ns((double)hist->max);
+}
+
+double latency_mean_ns(const latency_hist_t* hist) {
+    return hist->total ? ticks_to_ns(hist->sum / hist->total) : 0;
+}
+
+double latency_max_ns(const latency_hist_t* hist) {
+    return ticks_to_ns((double)hist->max);
+}
@@ -0,0 +1,85 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Счётчик для замера одной операции: rdtscp на x86 (ждёт завершения
+ * предыдущих инструкций, lfence не даёт следующим начаться раньше),
+ * на остальных архитектурах - CLOCK_MONOTONIC в наносекундах */
+static inline uint64_t timing_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux;
+    uint64_t ticks = __rdtscp(&aux);
+    _mm_lfence();
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Частота счётчика и цена пустого замера; вызывается один раз до замеров */
+void timing_calibrate(void);
+double timing_ticks_per_ns(void);
+uint64_t timing_overhead_ticks(void); // вычитается из замеров при выводе
+
+/* Закрепляет поток за процессором cpu (по модулю их числа) */
+bool timing_pin_thread(pthread_t thread, int cpu);
+
+/* HDR-гистограмма задержек в тиках: для значений до 2^LATENCY_SUB_BITS
+ * корзины точные, дальше на каждую степень двойки приходится
+ * LATENCY_SUB_BUCKETS корзин, т.е. относительная ошибка меньше 1% */
+#define LATENCY_SUB_BITS 7
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((65 - LATENCY_SUB_BITS) * LATENCY_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+    double sum;
+} latency_hist_t;
+
+static inline int latency_bucket(uint64_t ticks) {
+    if (ticks < LATENCY_SUB_BUCKETS) {
+        return (int)ticks;
+    }
+    int shift = 63 - __builtin_clzll(ticks) - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)((ticks >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+static inline void latency_record(latency_hist_t* hist, uint64_t ticks) {
+    hist->counts[latency_bucket(ticks)]++;
+    hist->total++;
+    hist->sum += (double)ticks;
+    if (ticks > hist->max) {
+        hist->max = ticks;
+    }
+}
+
+/* Замер одного выражения: LATENCY_TIME(&hist, ptr = allocator_alloc(alloc, 64)) */
+#define LATENCY_TIME(hist, expr) \
+    do { \
+        uint64_t latency_start_ = timing_ticks(); \
+        expr; \
+        latency_record((hist), timing_ticks() - latency_start_); \
+    } while (0)
+
+void latency_reset(latency_hist_t* hist);
+void latency_merge(latency_hist_t* dst, const latency_hist_t* src);
+/* Результаты в наносекундах за вычетом цены пустого замера. Перцентиль
+ * pct (0..100] - верхняя граница корзины, в которую попадает pct% замеров,
+ * но не больше максимума */
+double latency_percentile_ns(const latency_hist_t* hist, double pct);
+double latency_mean_ns(const latency_hist_t* hist);
+double latency_max_ns(const latency_hist_t* hist);
+
+#endif
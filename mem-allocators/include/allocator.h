@@ -3,13 +3,19 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include "size_classes.h"
 
 typedef enum {
     ALLOCATOR_SEGREGATED_FREELIST,
-    ALLOCATOR_MCKUSICK_KARELS
+    ALLOCATOR_MCKUSICK_KARELS,
+    ALLOCATOR_ARENA, // bump-аллокатор с массовым сбросом (allocator_reset, метки)
+    ALLOCATOR_BUDDY, // двоичные близнецы: блоки - степени двойки, слияние за O(log n)
+    ALLOCATOR_TLSF // двухуровневые списки: выделение и освобождение за O(1)
 } allocator_type_t;
 
 typedef struct allocator allocator_t;
+typedef struct trace_recorder trace_recorder_t;
 
 allocator_t* allocator_create(allocator_type_t type, size_t heap_size);
 
@@ -19,18 +25,102 @@ void* allocator_alloc(allocator_t* alloc, size_t size);
 
 void allocator_free(allocator_t* alloc, void* ptr);
 
+// Любой блок выровнен минимум по ALLOCATOR_MIN_ALIGNMENT байт
+#define ALLOCATOR_MIN_ALIGNMENT 16
+#define ALLOCATOR_MAX_ALIGNMENT 4096
+
+// Блок, выровненный по alignment (степень двойки до ALLOCATOR_MAX_ALIGNMENT);
+// NULL при недопустимом выравнивании. Освобождается обычным allocator_free
+void* allocator_aligned_alloc(allocator_t* alloc, size_t alignment, size_t size);
+
+// Освобождение с известным размером (как sized delete в C++): класс
+// считается по size, заголовок блока и дескриптор страницы не читаются.
+// size - размер, запрошенный при выделении (или последнем realloc).
+// Блоки allocator_aligned_alloc класс подбирают и по выравниванию: их
+// освобождают allocator_free_aligned_sized или обычным allocator_free
+void allocator_free_sized(allocator_t* alloc, void* ptr, size_t size);
+// Освобождение блока allocator_aligned_alloc с теми же alignment и size
+// (как aligned sized delete в C++17)
+void allocator_free_aligned_sized(allocator_t* alloc, void* ptr, size_t alignment, size_t size);
+
+// Пачка блоков одного размера; возвращает, сколько удалось выделить
+// (ptrs[0..результат) заполнены)
+size_t allocator_alloc_batch(allocator_t* alloc, size_t size, void** ptrs, size_t count);
+
+// Освобождение пачки блоков (размеры могут быть разными, NULL пропускаются)
+void allocator_free_batch(allocator_t* alloc, void** ptrs, size_t count);
+
 void* allocator_realloc(allocator_t* alloc, void* ptr, size_t new_size);
 
+// сколько байт реально доступно по указателю (>= запрошенного размера)
+size_t allocator_usable_size(allocator_t* alloc, void* ptr);
+
+// подключает запись трассы (см. trace.h); NULL - отключает.
+// Менять, пока другие потоки работают с аллокатором, нельзя
+void allocator_set_trace(allocator_t* alloc, trace_recorder_t* rec);
+
+// Арена: объекты выделяются сдвигом указателя в цепочке чанков, по одному
+// не освобождаются (кроме последнего выделенного и крупных), а сбрасываются
+// все разом. Метка запоминает позицию; откат к ней освобождает всё
+// выделенное после неё. Метки вкладываются: после отката к метке более
+// поздние метки недействительны. В трассу сброс и откат не пишутся
+typedef struct {
+    void* chunk; // поля - внутреннее состояние арены
+    size_t position;
+    size_t large;
+    size_t used;
+} allocator_mark_t;
+
+// Только для ALLOCATOR_ARENA; для остальных - пустая метка и false
+allocator_mark_t allocator_mark(allocator_t* alloc);
+bool allocator_rewind(allocator_t* alloc, allocator_mark_t mark);
+// откат к началу: O(1), чанки остаются за ареной до allocator_trim
+bool allocator_reset(allocator_t* alloc);
+
+// возвращает ОС свободную память, которую аллокатор держит про запас;
+// результат - сколько байт отдано
+size_t allocator_trim(allocator_t* alloc);
+
+typedef struct {
+    size_t size; // размер класса, доступный пользователю
+    size_t allocations;
+    size_t frees;
+} allocator_class_stats_t;
+
+// Счётчики ведутся по потокам и по классам и суммируются при чтении.
+// Накопительные поля отсчитываются от последнего allocator_reset_stats.
 typedef struct {
     size_t total_allocations;
     size_t total_frees;
-    size_t current_allocated;
-    size_t peak_allocated;
+    size_t current_allocated; // байт в выданных пользователю блоках (у арены - занято до сброса)
+    size_t peak_allocated; // пик занятого в куче реализации (вместе с кэшами потоков)
     size_t failed_allocations;
+    
+    size_t bytes_requested; // сумма запрошенных размеров
+    size_t bytes_reserved; // сумма реально отданных (usable size)
+    size_t large_allocations; // через mmap (large_object)
+    
+    // состояние кучи реализации
+    size_t heap_size;
+    size_t free_bytes;
+    size_t free_blocks;
+    size_t largest_free_block;
+    double fragmentation; // внешняя фрагментация: 1 - largest_free_block / free_bytes
+    size_t large_mapped; // отображения крупных объектов вместе с кэшем
+    
+    size_t num_classes;
+    allocator_class_stats_t classes[NUM_SIZE_CLASSES];
 } allocator_stats_t;
 
+typedef enum {
+    ALLOCATOR_STATS_JSON,
+    ALLOCATOR_STATS_CSV // строки metric,class_size,value
+} allocator_stats_format_t;
+
 void allocator_get_stats(allocator_t* alloc, allocator_stats_t* stats);
 
 void allocator_reset_stats(allocator_t* alloc);
 
+void allocator_dump_stats(allocator_t* alloc, FILE* out, allocator_stats_format_t format);
+
 #endif /* ALLOCATOR_H */
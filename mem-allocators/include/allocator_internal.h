@@ -0,0 +1,66 @@
+#ifndef ALLOCATOR_INTERNAL_H
+#define ALLOCATOR_INTERNAL_H
+
+#include "allocator.h"
+#include "large_object.h"
+#include <pthread.h>
+
+struct thread_cache;
+
+// Счётчики путей через кэш потока. Пишет только поток-владелец (COUNTER_ADD
+// без lock-префикса), читатели берут значения атомарно и суммируют
+typedef struct {
+    size_t allocs[NUM_SIZE_CLASSES];
+    size_t frees[NUM_SIZE_CLASSES];
+    size_t requested; // байт запрошено
+} class_counters_t;
+
+// Счётчики путей мимо кэшей (крупные и внеклассовые блоки, неудачи):
+// пишут все потоки через __atomic_fetch_add
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t requested;
+    size_t reserved; // байт выдано
+    size_t released; // байт возвращено
+    size_t large_allocs;
+    size_t failed;
+} direct_counters_t;
+
+#define COUNTER_ADD(c, n) __atomic_store_n(&(c), (c) + (n), __ATOMIC_RELAXED)
+#define COUNTER_READ(c) __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#define SHARED_COUNTER_ADD(c, n) __atomic_fetch_add(&(c), (n), __ATOMIC_RELAXED)
+
+// Общая часть всех реализаций: каждая структура аллокатора
+// начинается с поля allocator_t base, поэтому указатели взаимозаменяемы
+struct allocator {
+    allocator_type_t type;
+    pthread_mutex_t lock; // защищает разделяемое состояние реализации
+    pthread_key_t tcache_key; // кэш текущего потока
+    struct thread_cache* tcaches; // все кэши потоков (под lock)
+    large_object_space_t large; // крупные объекты вне кучи реализации
+    class_counters_t retired; // счётчики завершившихся потоков (под lock)
+    direct_counters_t direct;
+    allocator_stats_t baseline; // снимок на момент allocator_reset_stats (под lock)
+    trace_recorder_t* trace; // запись трассы, NULL - выключена
+};
+
+// Медленный путь кэша потока: перенос пачек блоков класса
+// в разделяемое состояние и обратно (захватывают lock)
+size_t allocator_refill_class(allocator_t* alloc, int class_idx, void** ptrs, size_t count);
+void allocator_flush_class(allocator_t* alloc, int class_idx, void** ptrs, size_t count);
+// размер объекта класса: им блоки, прошедшие мимо кэша потока, учитываются в reserved/released
+size_t allocator_class_size(allocator_t* alloc, int class_idx);
+
+// Служебная память (структуры аллокаторов, кучи, кэши потоков) берётся
+// прямо у ОС, а не у malloc: иначе аллокатор не смог бы сам подменить
+// malloc (см. src/preload.c). Память обнулена и выделяется ОС лениво;
+// alignment меньше страницы означает выравнивание по странице
+void* allocator_map(size_t size, size_t alignment);
+void allocator_unmap(void* ptr, size_t size);
+// Отдаёт ОС страницы участка (начало выровнено по странице) и возвращает,
+// сколько байт из них ещё было в памяти: уже отданные страницы не
+// считаются повторно, так что второй trim подряд возвращает 0
+size_t allocator_release_pages(void* start, size_t size);
+
+#endif /* ALLOCATOR_INTERNAL_H */
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "allocator.h"
+
+// Обычные чанки выровнены по своему размеру: чанк объекта - его адрес,
+// округлённый вниз до ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE (256 * 1024)
+// объекты крупнее получают отдельный чанк (отображение под один объект)
+#define ARENA_LARGE_THRESHOLD (ARENA_CHUNK_SIZE / 4)
+
+allocator_t* arena_create(size_t heap_size);
+void arena_destroy(allocator_t* alloc);
+void* arena_alloc(allocator_t* alloc, size_t size);
+// alignment - степень двойки не больше ALLOCATOR_MAX_ALIGNMENT
+void* arena_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment);
+// память возвращается, только если объект последний в текущем чанке
+// или лежит в отдельном чанке
+void arena_free(allocator_t* alloc, void* ptr);
+// меняет размер на месте; NULL - если на месте не получается
+void* arena_resize(allocator_t* alloc, void* ptr, size_t new_size);
+size_t arena_usable_size(allocator_t* alloc, void* ptr);
+bool arena_owns(allocator_t* alloc, void* ptr);
+
+allocator_mark_t arena_mark(allocator_t* alloc);
+// откат к метке; пустая метка ({0}) - к началу арены
+void arena_rewind(allocator_t* alloc, allocator_mark_t mark);
+// отдаёт ОС запасные чанки за текущим, возвращает их размер
+size_t arena_trim(allocator_t* alloc);
+
+// заполняет и счётчики операций: арена ведёт их сама, под lock
+void arena_get_stats(allocator_t* alloc, allocator_stats_t* stats);
+void arena_reset_peak(allocator_t* alloc);
+
+#endif
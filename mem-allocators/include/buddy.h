@@ -0,0 +1,35 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "allocator.h"
+
+// Блоки - степени двойки от BUDDY_MIN_ORDER до BUDDY_MAX_ORDER; куча выровнена
+// по наибольшему блоку, поэтому блок порядка k выровнен по 2^k
+#define BUDDY_MIN_ORDER 6 // 64 байта, линия кэша
+#define BUDDY_MAX_ORDER 22 // 4 МБ: больше - через large_object
+#define BUDDY_MIN_BLOCK ((size_t)1 << BUDDY_MIN_ORDER)
+#define BUDDY_MAX_BLOCK ((size_t)1 << BUDDY_MAX_ORDER)
+
+allocator_t* buddy_create(size_t heap_size);
+void buddy_destroy(allocator_t* alloc);
+void* buddy_alloc(allocator_t* alloc, size_t size);
+// alignment - степень двойки: блок берётся порядка не меньше log2(alignment)
+void* buddy_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment);
+void buddy_free(allocator_t* alloc, void* ptr);
+// меняет размер на месте: сжатие отдаёт верхние половины, рост забирает
+// свободных соседей-близнецов; NULL - на месте не получается
+void* buddy_resize(allocator_t* alloc, void* ptr, size_t new_size);
+size_t buddy_usable_size(allocator_t* alloc, void* ptr);
+bool buddy_owns(allocator_t* alloc, void* ptr);
+// Порог крупных объектов: восьмая часть кучи, чтобы один запрос не занимал
+// её целиком, но не больше BUDDY_MAX_BLOCK
+size_t buddy_large_threshold(allocator_t* alloc);
+
+// отдаёт ОС страницы свободных блоков (кроме первой, где лежат ссылки списка);
+// считаются только страницы, ещё бывшие в памяти
+size_t buddy_trim(allocator_t* alloc);
+
+void buddy_get_stats(allocator_t* alloc, allocator_stats_t* stats);
+void buddy_reset_peak(allocator_t* alloc);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef LARGE_OBJECT_H
+#define LARGE_OBJECT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Крупные объекты живут в собственных отображениях mmap, кратных странице.
+// Перед данными лежит заголовок с размером отображения; все живые объекты
+// связаны в список, чтобы аллокатор мог освободить их при уничтожении.
+#define LARGE_OBJECT_THRESHOLD (128 * 1024) // для Segregated: больше - через mmap
+#define LARGE_CACHE_SLOTS 16 // недавно освобождённых отображений в кэше
+#define LARGE_CACHE_MAX_BYTES (64 * 1024 * 1024) // суммарный размер кэша
+
+struct large_header;
+
+typedef struct {
+    size_t map_size;
+    void* base;
+} large_cache_slot_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    struct large_header* live; // все выданные объекты
+    large_cache_slot_t cache[LARGE_CACHE_SLOTS]; // от старых к новым
+    size_t cache_count;
+    size_t cache_bytes;
+} large_object_space_t;
+
+void large_object_init(large_object_space_t* space);
+void large_object_destroy(large_object_space_t* space); // снимает все отображения
+
+void* large_object_alloc(large_object_space_t* space, size_t size);
+// данные выровнены по alignment (степень двойки, не больше страницы)
+void* large_object_alloc_aligned(large_object_space_t* space, size_t size, size_t alignment);
+void large_object_free(large_object_space_t* space, void* ptr);
+// меняет размер через mremap, без копирования данных в пространстве пользователя
+void* large_object_realloc(large_object_space_t* space, void* ptr, size_t new_size);
+size_t large_object_usable_size(void* ptr);
+
+// отдаёт ОС все закэшированные отображения, возвращает их суммарный размер
+size_t large_object_trim(large_object_space_t* space);
+// байт в отображениях: живые объекты вместе с кэшем
+size_t large_object_mapped(large_object_space_t* space);
+
+#endif
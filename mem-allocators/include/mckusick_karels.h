@@ -2,14 +2,38 @@
 #define MCKUSICK_KARELS_H
 
 #include "allocator.h"
+#include "size_classes.h"
 
 #define PAGE_SIZE 4096
-#define MIN_BUCKET_SIZE 16
-#define MAX_BUCKET_SIZE 2048
+#define PAGE_SHIFT 12
+#define MIN_BUCKET_SIZE SIZE_CLASS_MIN
+#define MAX_BUCKET_SIZE SIZE_CLASS_MAX
+#define MK_PAGE_RESERVE 4 // пустых страниц на корзину по умолчанию
 
 allocator_t* mckusick_karels_create(size_t heap_size);
 void mckusick_karels_destroy(allocator_t* alloc);
 void* mckusick_karels_alloc(allocator_t* alloc, size_t size);
 void mckusick_karels_free(allocator_t* alloc, void* ptr);
 
+// освобождение из любого потока без блокировки и его сбор владельцем
+void mckusick_karels_free_remote(allocator_t* alloc, void* ptr);
+size_t mckusick_karels_drain_remote(allocator_t* alloc);
+
+// пачки объектов одной корзины (под lock) и освобождение пачки без блокировки
+size_t mckusick_karels_alloc_batch(allocator_t* alloc, int bucket_idx, void** ptrs, size_t count);
+void mckusick_karels_free_remote_batch(allocator_t* alloc, void** ptrs, size_t count);
+
+// возврат пустых страниц ОС: резерв на корзину и принудительная очистка
+void mckusick_karels_set_page_reserve(allocator_t* alloc, size_t pages);
+size_t mckusick_karels_trim(allocator_t* alloc);
+
+int mckusick_karels_class_of(allocator_t* alloc, size_t size);
+size_t mckusick_karels_class_size(allocator_t* alloc, int class_idx);
+size_t mckusick_karels_class_align(allocator_t* alloc, int class_idx);
+int mckusick_karels_class_of_ptr(allocator_t* alloc, void* ptr);
+size_t mckusick_karels_usable_size(allocator_t* alloc, void* ptr);
+bool mckusick_karels_owns(allocator_t* alloc, void* ptr);
+void mckusick_karels_get_stats(allocator_t* alloc, allocator_stats_t* stats);
+void mckusick_karels_reset_peak(allocator_t* alloc);
+
 #endif
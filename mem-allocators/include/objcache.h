@@ -0,0 +1,52 @@
+#ifndef OBJCACHE_H
+#define OBJCACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Кэш объектов одного типа по Бонвику (slab allocator). Объекты
+// конструируются один раз, когда создаётся slab, и возвращаются кэшу
+// в сконструированном состоянии: объект, выданный повторно, ctor не
+// проходит. Пустые slab'ы остаются за кэшем до objcache_reap, dtor
+// вызывается, только когда slab отдаётся ОС. Slab - участок из страниц,
+// выровненный по своему размеру, с заголовком в начале; начало объектов
+// в соседних slab'ах сдвигается на линию кэша (раскраска), чтобы
+// одноимённые объекты разных slab'ов не попадали в одни наборы кэша
+#define OBJCACHE_MIN_OBJECTS 8 // slab удваивается, пока в него не влезет столько объектов
+#define OBJCACHE_MAX_SLAB (1024 * 1024)
+
+typedef struct objcache objcache_t;
+
+// ctor приводит объект в начальное состояние, dtor снимает его; оба
+// вызываются под блокировкой кэша и не должны обращаться к тому же кэшу
+typedef void (*objcache_ctor_t)(void* obj);
+typedef void (*objcache_dtor_t)(void* obj);
+
+typedef struct {
+    size_t allocations;
+    size_t frees;
+    size_t constructed; // вызовов ctor
+    size_t destructed; // вызовов dtor
+    size_t in_use; // выданных объектов
+    size_t slabs;
+    size_t slab_bytes;
+    size_t slab_size;
+    size_t objects_per_slab;
+    size_t colors; // разных смещений начала объектов
+} objcache_stats_t;
+
+// align - степень двойки не больше ALLOCATOR_MAX_ALIGNMENT, 0 - ALLOCATOR_MIN_ALIGNMENT;
+// ctor и dtor могут быть NULL. NULL - объект не помещается в OBJCACHE_MAX_SLAB
+objcache_t* objcache_create(size_t size, size_t align, objcache_ctor_t ctor, objcache_dtor_t dtor);
+// dtor проходит по всем объектам, в том числе не возвращённым
+void objcache_destroy(objcache_t* cache);
+
+void* objcache_alloc(objcache_t* cache);
+// объект должен вернуться в сконструированном состоянии
+void objcache_free(objcache_t* cache, void* obj);
+
+// отдаёт ОС все пустые slab'ы, возвращает их размер
+size_t objcache_reap(objcache_t* cache);
+void objcache_get_stats(objcache_t* cache, objcache_stats_t* stats);
+
+#endif
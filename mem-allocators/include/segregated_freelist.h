@@ -2,13 +2,27 @@
 #define SEGREGATED_FREELIST_H
 
 #include "allocator.h"
-
-#define NUM_SIZE_CLASSES 8
-extern const size_t SIZE_CLASSES[NUM_SIZE_CLASSES];
+#include "size_classes.h"
 
 allocator_t* segregated_freelist_create(size_t heap_size);
 void segregated_freelist_destroy(allocator_t* alloc);
 void* segregated_freelist_alloc(allocator_t* alloc, size_t size);
 void segregated_freelist_free(allocator_t* alloc, void* ptr);
+size_t segregated_freelist_alloc_batch(allocator_t* alloc, int class_idx, void** ptrs, size_t count);
+// блок, данные которого выровнены по alignment (степень двойки)
+void* segregated_freelist_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment);
+// меняет размер блока на месте; NULL - если на месте не получается
+void* segregated_freelist_resize(allocator_t* alloc, void* ptr, size_t new_size);
+
+// размерные классы для кэша потоков: -1, если размер/блок не кэшируется
+int segregated_freelist_class_of(allocator_t* alloc, size_t size);
+size_t segregated_freelist_class_size(allocator_t* alloc, int class_idx);
+// гарантированное выравнивание объектов класса
+size_t segregated_freelist_class_align(allocator_t* alloc, int class_idx);
+int segregated_freelist_class_of_ptr(allocator_t* alloc, void* ptr);
+size_t segregated_freelist_usable_size(allocator_t* alloc, void* ptr);
+bool segregated_freelist_owns(allocator_t* alloc, void* ptr);
+void segregated_freelist_get_stats(allocator_t* alloc, allocator_stats_t* stats);
+void segregated_freelist_reset_peak(allocator_t* alloc);
 
 #endif
@@ -0,0 +1,61 @@
+#ifndef SIZE_CLASSES_H
+#define SIZE_CLASSES_H
+
+#include <stddef.h>
+
+// Общая таблица размерных классов для обоих аллокаторов.
+// До 64 байт шаг 16, дальше 4 класса на каждое удвоение (как в jemalloc):
+// 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, ..., 2048.
+// Таблица строится препроцессором, индекс по размеру считается через clz.
+#define SIZE_CLASS_MIN 16
+#define SIZE_CLASS_SMALL_MAX 64 // до этого размера шаг SIZE_CLASS_MIN
+#define SIZE_CLASS_SMALL_LG 6 // log2(SIZE_CLASS_SMALL_MAX)
+#define SIZE_CLASS_MAX_LG 11
+#define SIZE_CLASS_MAX (1 << SIZE_CLASS_MAX_LG)
+#define SIZE_CLASS_GROUP 4 // классов на удвоение
+
+#define NUM_SIZE_CLASSES \
+    (SIZE_CLASS_SMALL_MAX / SIZE_CLASS_MIN + SIZE_CLASS_GROUP * (SIZE_CLASS_MAX_LG - SIZE_CLASS_SMALL_LG))
+
+// класс n (1..4) группы (2^lg, 2^(lg+1)]
+#define SIZE_CLASS_VALUE(lg, n) (((size_t)1 << (lg)) + (n) * ((size_t)1 << ((lg) - 2)))
+#define SIZE_CLASS_GROUP_LIST(X, lg) \
+    X(SIZE_CLASS_VALUE(lg, 1)) X(SIZE_CLASS_VALUE(lg, 2)) \
+    X(SIZE_CLASS_VALUE(lg, 3)) X(SIZE_CLASS_VALUE(lg, 4))
+#define SIZE_CLASS_LIST(X) \
+    X(16) X(32) X(48) X(64) \
+    SIZE_CLASS_GROUP_LIST(X, 6) \
+    SIZE_CLASS_GROUP_LIST(X, 7) \
+    SIZE_CLASS_GROUP_LIST(X, 8) \
+    SIZE_CLASS_GROUP_LIST(X, 9) \
+    SIZE_CLASS_GROUP_LIST(X, 10)
+
+extern const size_t SIZE_CLASSES[NUM_SIZE_CLASSES];
+
+// Режим ALLOCATOR_CACHE_ALIGNED: размеры больше линии кэша округляются до
+// кратного ей, поэтому используются только классы 64, 128, 192, 256, 320, ...
+// (80, 96, 112, 160, 224 остаются пустыми). Объекты, нарезанные от выровненного
+// начала страницы или прогона, тогда лежат на границах линий кэша.
+#define CACHE_LINE_SIZE 64
+
+// индекс наименьшего класса >= size, -1 если size больше SIZE_CLASS_MAX
+static inline int size_class_index(size_t size) {
+#ifdef ALLOCATOR_CACHE_ALIGNED
+    if (size > CACHE_LINE_SIZE) {
+        size = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    }
+#endif
+    if (size <= SIZE_CLASS_SMALL_MAX) {
+        return size == 0 ? 0 : (int)((size - 1) / SIZE_CLASS_MIN);
+    }
+    if (size > SIZE_CLASS_MAX) {
+        return -1;
+    }
+    
+    int lg = 63 - __builtin_clzl(size - 1); // (2^lg, 2^(lg+1)] содержит size
+    int n = (int)((size - 1) >> (lg - 2)); // 4..7
+    return SIZE_CLASS_SMALL_MAX / SIZE_CLASS_MIN
+         + (lg - SIZE_CLASS_SMALL_LG) * SIZE_CLASS_GROUP + (n - SIZE_CLASS_GROUP);
+}
+
+#endif
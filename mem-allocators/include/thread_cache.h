@@ -0,0 +1,23 @@
+#ifndef THREAD_CACHE_H
+#define THREAD_CACHE_H
+
+#include "allocator.h"
+#include "allocator_internal.h"
+#include "size_classes.h"
+#include <stdbool.h>
+
+#define TCACHE_MAX_CLASSES NUM_SIZE_CLASSES
+#define TCACHE_MAGAZINE_SIZE 64 // ёмкость магазина одного класса
+#define TCACHE_BATCH 32 // сколько блоков переносится за одно пополнение/сброс
+
+bool tcache_init(allocator_t* alloc);
+void tcache_teardown(allocator_t* alloc);
+void* tcache_alloc(allocator_t* alloc, int class_idx, size_t size);
+void tcache_free(allocator_t* alloc, int class_idx, void* ptr);
+size_t tcache_alloc_batch(allocator_t* alloc, int class_idx, size_t size, void** ptrs, size_t count);
+void tcache_free_batch(allocator_t* alloc, int class_idx, void** ptrs, size_t count);
+// прибавляет к sum счётчики всех живых кэшей (под alloc->lock)
+void tcache_collect(allocator_t* alloc, class_counters_t* sum);
+void tcache_flush(allocator_t* alloc); // возвращает магазины текущего потока
+
+#endif
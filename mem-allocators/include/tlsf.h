@@ -0,0 +1,34 @@
+#ifndef TLSF_H
+#define TLSF_H
+
+#include "allocator.h"
+
+// Двухуровневые списки (TLSF): первый уровень - степень двойки размера,
+// второй делит её на TLSF_SL_COUNT равных частей. Непустые списки отмечены
+// в битовых картах обоих уровней, поэтому поиск, выделение и освобождение
+// выполняются за O(1) без проходов по спискам
+#define TLSF_SL_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_MAX 40 // блоки меньше 2^40 байт
+
+allocator_t* tlsf_create(size_t heap_size);
+void tlsf_destroy(allocator_t* alloc);
+void* tlsf_alloc(allocator_t* alloc, size_t size);
+// alignment - степень двойки: блок берётся с запасом, отрезанное спереди возвращается в списки
+void* tlsf_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment);
+void tlsf_free(allocator_t* alloc, void* ptr);
+// меняет размер на месте, забирая свободного соседа справа; NULL - на месте не получается
+void* tlsf_resize(allocator_t* alloc, void* ptr, size_t new_size);
+size_t tlsf_usable_size(allocator_t* alloc, void* ptr);
+bool tlsf_owns(allocator_t* alloc, void* ptr);
+// Порог крупных объектов: восьмая часть кучи, чтобы один запрос не занимал её целиком
+size_t tlsf_large_threshold(allocator_t* alloc);
+
+// отдаёт ОС целые страницы свободных блоков (кроме страницы со ссылками списка);
+// считаются только страницы, ещё бывшие в памяти
+size_t tlsf_trim(allocator_t* alloc);
+
+void tlsf_get_stats(allocator_t* alloc, allocator_stats_t* stats);
+void tlsf_reset_peak(allocator_t* alloc);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "allocator.h"
+#include <stdint.h>
+
+// Трасса выделений: заголовок trace_header_t, за ним записи trace_record_t
+// подряд (порядок байт - как у записавшей машины). Объекты нумеруются
+// плотно: номер освобождённого объекта достаётся следующему выделению,
+// поэтому при воспроизведении хватает массива на header.objects указателей.
+#define TRACE_MAGIC 0x45435254u // "TRCE"
+#define TRACE_VERSION 1
+
+typedef enum {
+    TRACE_ALLOC, // size, align_shift (0 - обычное выделение)
+    TRACE_FREE,
+    TRACE_FREE_SIZED, // size - размер, переданный в allocator_free_sized
+    TRACE_REALLOC, // объект сохраняет номер, size - новый размер
+    TRACE_NUM_OPS
+} trace_op_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t records;
+    uint32_t objects; // номера объектов меньше этого числа
+    uint32_t threads;
+} trace_header_t;
+
+typedef struct {
+    uint64_t timestamp; // нс от начала записи
+    uint64_t size;
+    uint32_t object;
+    uint16_t thread; // номер потока в порядке первого обращения
+    uint8_t op; // trace_op_t
+    uint8_t align_shift; // log2 выравнивания для allocator_aligned_alloc
+} trace_record_t;
+
+// Запись трассы: подключается к аллокатору через allocator_set_trace и
+// пишет в файл все успешные выделения, освобождения и realloc. Сама
+// запись malloc не использует, поэтому годится и для src/preload.c.
+// Операции разных потоков упорядочены под блокировкой журнала.
+// Тип trace_recorder_t объявлен в allocator.h
+
+trace_recorder_t* trace_recorder_create(const char* path);
+// дописывает буфер и заголовок; дальнейшие записи игнорируются
+void trace_recorder_finish(trace_recorder_t* rec);
+void trace_recorder_destroy(trace_recorder_t* rec); // с finish, если его не было
+
+void trace_record_alloc(trace_recorder_t* rec, void* ptr, size_t size, size_t alignment);
+// вызывается до освобождения: иначе другой поток может получить тот же адрес
+// и записать его выделение раньше. size != 0 - освобождение с известным размером
+void trace_record_free(trace_recorder_t* rec, void* ptr, size_t size);
+// realloc переносит блок внутри аллокатора, поэтому записывается под
+// блокировкой журнала, взятой на всё время вызова
+void trace_realloc_begin(trace_recorder_t* rec);
+void trace_realloc_end(trace_recorder_t* rec, void* old_ptr, void* new_ptr, size_t size);
+
+// Чтение трассы целиком в память (для воспроизведения); NULL, если файл
+// не читается или повреждён
+typedef struct {
+    trace_header_t header;
+    trace_record_t* records;
+} trace_t;
+
+trace_t* trace_load(const char* path);
+void trace_free(trace_t* trace);
+
+#endif
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Run a command under glibc malloc and under build/libmemalloc.so (LD_PRELOAD)
+and compare wall time and peak RSS.
+
+Usage: python3 scripts/compare_preload.py [--reps N] [--csv FILE] -- command [args...]
+Build the library first with: make preload
+"""
+
+import argparse
+import os
+import sys
+import time
+
+LIBRARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'build', 'libmemalloc.so')
+
+# (label, extra environment); None means the system allocator
+VARIANTS = [
+    ('glibc', None),
+    ('segregated', {'MEMALLOC_ALLOCATOR': 'segregated'}),
+    ('mckusick', {'MEMALLOC_ALLOCATOR': 'mckusick'}),
+]
+
+def run_once(command, extra_env):
+    """Run the command in a child process, return (wall seconds, max RSS in KB)."""
+    env = dict(os.environ)
+    if extra_env is not None:
+        env.update(extra_env)
+        env['LD_PRELOAD'] = os.path.abspath(LIBRARY)
+
+    start = time.perf_counter()
+    pid = os.fork()
+    if pid == 0:
+        devnull = os.open(os.devnull, os.O_WRONLY)
+        os.dup2(devnull, 1)
+        try:
+            os.execvpe(command[0], command, env)
+        finally:
+            os._exit(127)
+    _, status, usage = os.wait4(pid, 0)
+    wall = time.perf_counter() - start
+
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        raise RuntimeError('command failed (status %d)' % status)
+    return wall, usage.ru_maxrss
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare glibc malloc with the LD_PRELOAD allocators')
+    parser.add_argument('--reps', type=int, default=3, help='runs per variant (best wall time is reported)')
+    parser.add_argument('--csv', help='also write results to this CSV file')
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command[1:] if args.command[:1] == ['--'] else args.command
+    if not command:
+        parser.error('no command given')
+    if not os.path.exists(LIBRARY):
+        print('Error: %s not found, run "make preload" first' % LIBRARY, file=sys.stderr)
+        return 1
+
+    rows = []
+    for label, extra_env in VARIANTS:
+        runs = [run_once(command, extra_env) for _ in range(args.reps)]
+        wall = min(r[0] for r in runs)
+        rss = max(r[1] for r in runs)
+        rows.append((label, wall, rss))
+
+    base_wall, base_rss = rows[0][1], rows[0][2]
+    print('%-12s %10s %8s %12s %8s' % ('Allocator', 'Wall (s)', 'x glibc', 'MaxRSS (KB)', 'x glibc'))
+    for label, wall, rss in rows:
+        print('%-12s %10.3f %8.2f %12d %8.2f' % (label, wall, wall / base_wall, rss, rss / base_rss))
+
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write('Allocator,WallSeconds,MaxRSSKB\n')
+            for label, wall, rss in rows:
+                f.write('%s,%.6f,%d\n' % (label, wall, rss))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -13,7 +13,112 @@ import matplotlib.pyplot as plt
 import matplotlib
 matplotlib.use('Agg')
 
-def plot_results(csv_file, output_file=None):
+# What the Param column means for swept benchmarks: (axis label, log2 scale).
+# Benchmarks not listed here sweep the thread count.
+PARAM_LABELS = {
+    'Churn': ('Window (1/10 of operations)', False),
+    'LargeLookup': ('Free blocks in the heap', True),
+    'FillPage': ('Object size (bytes)', True),
+    'LargeSizes': ('Object size (bytes)', True),
+    'Batch': ('Batch size', True),
+    'BatchPerObject': ('Batch size', True),
+    'FreeSized': ('Live objects', True),
+    'FreeUnsized': ('Live objects', True),
+}
+
+def split_sweeps(df):
+    """Split results into single-run benchmarks and parameter sweeps.
+
+    A benchmark is a sweep when it was run with more than one Param value
+    (e.g. the multi-threaded scenarios for 1, 2, 4, ... threads).
+    Old CSV files without the Param column contain no sweeps.
+    """
+    if 'Param' not in df.columns:
+        return df, df.iloc[0:0]
+    counts = df.groupby('Benchmark')['Param'].nunique()
+    sweep_names = counts[counts > 1].index
+    sweeps = df[df['Benchmark'].isin(sweep_names)]
+    single = df[~df['Benchmark'].isin(sweep_names)]
+    return single, sweeps
+
+def plot_scaling(sweeps, output_file):
+    """Plot throughput against Param (thread count by default) for every swept benchmark"""
+    names = sorted(sweeps['Benchmark'].unique())
+    fig, axes = plt.subplots(1, len(names), figsize=(6 * len(names), 5), squeeze=False)
+    
+    for ax, name in zip(axes[0], names):
+        data = sweeps[sweeps['Benchmark'] == name]
+        for allocator, group in data.groupby('Allocator'):
+            group = group.groupby('Param')['Ops_per_sec'].mean()
+            ax.plot(group.index, group.values, marker='o', label=allocator)
+        ax.set_title(f'{name} scaling', fontsize=14, fontweight='bold')
+        label, log_scale = PARAM_LABELS.get(name, ('Threads', True))
+        ax.set_xlabel(label, fontsize=12)
+        ax.set_ylabel('Operations per Second', fontsize=12)
+        if log_scale:
+            ax.set_xscale('log', base=2)
+        ax.legend(title='Allocator', fontsize=10)
+        ax.grid(True, alpha=0.3)
+    
+    plt.tight_layout()
+    plt.savefig(output_file, dpi=300, bbox_inches='tight')
+    print(f"Scaling plot saved to: {output_file}")
+    plt.close()
+
+def plot_footprint(footprint, results, output_file):
+    """Plot memory footprint over operations for every Footprint* benchmark.
+
+    Each row is one benchmark: bytes used by the allocator (solid) against
+    bytes requested by live objects (dashed), process RSS, and the
+    benchmark's throughput from the main results next to the curves.
+    """
+    names = sorted(footprint['Benchmark'].unique())
+    fig, axes = plt.subplots(len(names), 3, figsize=(18, 5 * len(names)), squeeze=False)
+    mb = 1024 * 1024
+    
+    for row, name in zip(axes, names):
+        ax_heap, ax_rss, ax_ops = row
+        data = footprint[footprint['Benchmark'] == name]
+        for allocator, group in data.groupby('Allocator'):
+            line, = ax_heap.plot(group['Ops'], group['Heap_used_bytes'] / mb, label=allocator)
+            ax_heap.plot(group['Ops'], group['Requested_bytes'] / mb, linestyle='--',
+                         color=line.get_color(), alpha=0.6)
+            ax_rss.plot(group['Ops'], group['RSS_bytes'] / mb, label=allocator)
+        ax_heap.set_title(f'{name}: used (solid) vs requested (dashed)', fontsize=12,
+                          fontweight='bold')
+        ax_heap.set_ylabel('MB', fontsize=12)
+        ax_rss.set_title(f'{name}: process RSS', fontsize=12, fontweight='bold')
+        ax_rss.set_ylabel('MB', fontsize=12)
+        for ax in (ax_heap, ax_rss):
+            ax.set_xlabel('Operations', fontsize=12)
+            ax.legend(title='Allocator', fontsize=10)
+            ax.grid(True, alpha=0.3)
+        
+        ax_ops.set_title(f'{name}: throughput', fontsize=12, fontweight='bold')
+        ops = results[results['Benchmark'] == name] if results is not None else None
+        if ops is not None and not ops.empty:
+            ops.groupby('Allocator')['Ops_per_sec'].mean().plot(kind='bar', ax=ax_ops, rot=0)
+            ax_ops.set_ylabel('Operations per Second', fontsize=12)
+            ax_ops.grid(True, alpha=0.3)
+        else:
+            ax_ops.axis('off')
+    
+    plt.tight_layout()
+    plt.savefig(output_file, dpi=300, bbox_inches='tight')
+    print(f"Footprint plot saved to: {output_file}")
+    plt.close()
+
+def load_footprint(footprint_file):
+    """Read a footprint time series CSV written by benchmark -f"""
+    if not footprint_file:
+        return None
+    try:
+        return pd.read_csv(footprint_file)
+    except Exception as e:
+        print(f"Warning: Error reading {footprint_file}: {e}")
+        return None
+
+def plot_results(csv_file, output_file=None, footprint_file=None):
     """Plot benchmark results from CSV file"""
     
     # Check if file exists
@@ -34,11 +139,15 @@ def plot_results(csv_file, output_file=None):
         print(f"Error: CSV file must contain columns: {required_cols}")
         return False
     
+    all_results = df
+    df, sweeps = split_sweeps(df)
+    
     # Create figure with subplots
     fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(14, 6))
     
     # Plot 1: Operations per second by benchmark
-    pivot_data = df.pivot(index='Benchmark', columns='Allocator', values='Ops_per_sec')
+    pivot_data = df.pivot_table(index='Benchmark', columns='Allocator', values='Ops_per_sec',
+                                aggfunc='mean')
     pivot_data.plot(kind='bar', ax=ax1, rot=45)
     ax1.set_title('Operations per Second by Benchmark', fontsize=14, fontweight='bold')
     ax1.set_xlabel('Benchmark Type', fontsize=12)
@@ -47,7 +156,8 @@ def plot_results(csv_file, output_file=None):
     ax1.grid(True, alpha=0.3)
     
     # Plot 2: Time comparison
-    pivot_time = df.pivot(index='Benchmark', columns='Allocator', values='Time_us')
+    pivot_time = df.pivot_table(index='Benchmark', columns='Allocator', values='Time_us',
+                                aggfunc='mean')
     pivot_time.plot(kind='bar', ax=ax2, rot=45, color=['#1f77b4', '#ff7f0e'])
     ax2.set_title('Execution Time by Benchmark', fontsize=14, fontweight='bold')
     ax2.set_xlabel('Benchmark Type', fontsize=12)
@@ -69,9 +179,19 @@ def plot_results(csv_file, output_file=None):
         print(f"Plot saved to: {output_file}")
     
     plt.close()
+    
+    if not sweeps.empty:
+        base, ext = os.path.splitext(output_file)
+        plot_scaling(sweeps, f'{base}_scaling{ext}')
+    
+    footprint = load_footprint(footprint_file)
+    if footprint is not None and not footprint.empty:
+        base, ext = os.path.splitext(output_file)
+        plot_footprint(footprint, all_results, f'{base}_footprint{ext}')
+    
     return True
 
-def plot_comparison(files, output_file='comparison.png'):
+def plot_comparison(files, output_file='comparison.png', footprint_file=None):
     """Plot comparison of multiple result files"""
     
     all_data = []
@@ -91,6 +211,8 @@ def plot_comparison(files, output_file='comparison.png'):
     
     # Combine all data
     combined = pd.concat(all_data, ignore_index=True)
+    all_results = combined
+    combined, sweeps = split_sweeps(combined)
     
     # Create comprehensive comparison plot
     fig = plt.figure(figsize=(16, 10))
@@ -157,6 +279,15 @@ def plot_comparison(files, output_file='comparison.png'):
     print(f"Comparison plot saved to: {output_file}")
     plt.close()
     
+    if not sweeps.empty:
+        base, ext = os.path.splitext(output_file)
+        plot_scaling(sweeps, f'{base}_scaling{ext}')
+    
+    footprint = load_footprint(footprint_file)
+    if footprint is not None and not footprint.empty:
+        base, ext = os.path.splitext(output_file)
+        plot_footprint(footprint, all_results, f'{base}_footprint{ext}')
+    
     return True
 
 def main():
@@ -177,14 +308,18 @@ def main():
         action='store_true',
         help='Create comparison plot from multiple files'
     )
+    parser.add_argument(
+        '-f', '--footprint',
+        help='Footprint time series CSV (benchmark -f); plotted to <output>_footprint.png'
+    )
     
     args = parser.parse_args()
     
     if args.comparison and len(args.input_files) > 1:
         output = args.output if args.output else 'comparison.png'
-        plot_comparison(args.input_files, output)
+        plot_comparison(args.input_files, output, args.footprint)
     elif len(args.input_files) == 1:
-        plot_results(args.input_files[0], args.output)
+        plot_results(args.input_files[0], args.output, args.footprint)
     else:
         print("Error: For single file plotting, provide one input file")
         print("       For comparison, use -c/--comparison flag with multiple files")
@@ -24,6 +24,8 @@ mkdir -p results
 
 # Default number of operations
 NUM_OPS=10000
+THREADS_OPT=""
+REPS_OPT=""
 
 # Parse command line arguments
 while [[ $# -gt 0 ]]; do
@@ -32,10 +34,30 @@ while [[ $# -gt 0 ]]; do
             NUM_OPS="$2"
             shift 2
             ;;
+        -t|--threads)
+            THREADS_OPT="-t $2"
+            shift 2
+            ;;
+        -R|--reps)
+            REPS_OPT="${REPS_OPT} -R $2"
+            shift 2
+            ;;
+        -w|--warmup)
+            REPS_OPT="${REPS_OPT} -w $2"
+            shift 2
+            ;;
+        -c|--counters)
+            REPS_OPT="${REPS_OPT} -c"
+            shift
+            ;;
         -h|--help)
             echo "Usage: $0 [OPTIONS]"
             echo "Options:"
             echo "  -n, --num-ops <number>   Number of operations per benchmark (default: 10000)"
+            echo "  -t, --threads <number>   Max threads for multi-threaded sweep (default: number of CPUs)"
+            echo "  -R, --reps <number>      Measured runs per benchmark (default: 5)"
+            echo "  -w, --warmup <number>    Unmeasured warmup runs (default: 1)"
+            echo "  -c, --counters           Per-op hardware counters (perf_event_open)"
             echo "  -h, --help               Show this help message"
             exit 0
             ;;
@@ -61,25 +83,43 @@ fi
 echo -e "${GREEN}Running benchmarks with ${NUM_OPS} operations...${NC}"
 echo ""
 
-# Run both allocators
-echo -e "${YELLOW}Benchmarking both allocators...${NC}"
-./build/benchmark -n ${NUM_OPS} -o results/benchmark_results.csv
+# Run all allocators
+echo -e "${YELLOW}Benchmarking all allocators...${NC}"
+./build/benchmark -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/benchmark_results.csv \
+    -l results/latency_results.csv -f results/footprint_results.csv
 
 # Run individual allocators for comparison
 echo ""
 echo -e "${YELLOW}Benchmarking Segregated Free-List allocator...${NC}"
-./build/benchmark -a segregated -n ${NUM_OPS} -o results/segregated_results.csv
+./build/benchmark -a segregated -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/segregated_results.csv
 
 echo ""
 echo -e "${YELLOW}Benchmarking McKusick-Karels allocator...${NC}"
-./build/benchmark -a mckusick -n ${NUM_OPS} -o results/mckusick_results.csv
+./build/benchmark -a mckusick -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/mckusick_results.csv
+
+echo ""
+echo -e "${YELLOW}Benchmarking Arena allocator...${NC}"
+./build/benchmark -a arena -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/arena_results.csv
+
+echo ""
+echo -e "${YELLOW}Benchmarking Buddy allocator...${NC}"
+./build/benchmark -a buddy -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/buddy_results.csv
+
+echo ""
+echo -e "${YELLOW}Benchmarking TLSF allocator...${NC}"
+./build/benchmark -a tlsf -n ${NUM_OPS} ${THREADS_OPT} ${REPS_OPT} -o results/tlsf_results.csv
 
 echo ""
 echo -e "${GREEN}=== Benchmark Complete ===${NC}"
 echo ""
 echo "Results saved to:"
 echo "  - results/benchmark_results.csv"
+echo "  - results/latency_results.csv"
+echo "  - results/footprint_results.csv"
 echo "  - results/segregated_results.csv"
 echo "  - results/mckusick_results.csv"
+echo "  - results/arena_results.csv"
+echo "  - results/buddy_results.csv"
+echo "  - results/tlsf_results.csv"
 echo ""
 echo -e "${YELLOW}Tip: Use scripts/plot_results.py to visualize the results${NC}"
@@ -1,54 +1,126 @@
 #include "../include/allocator.h"
+#include "../include/allocator_internal.h"
+#include "../include/thread_cache.h"
 #include "../include/segregated_freelist.h"
 #include "../include/mckusick_karels.h"
+#include "../include/arena.h"
+#include "../include/buddy.h"
+#include "../include/tlsf.h"
+#include "../include/trace.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-struct allocator {
-    allocator_type_t type;
-    void* impl;
-};
+static int class_of_size(allocator_t* alloc, size_t size) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_class_of(alloc, size);
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return mckusick_karels_class_of(alloc, size);
+        default:
+            return -1;
+    }
+}
 
-allocator_t* allocator_create(allocator_type_t type, size_t heap_size) {
-    switch (type) {
+static int class_of_ptr(allocator_t* alloc, void* ptr) {
+    switch (alloc->type) {
         case ALLOCATOR_SEGREGATED_FREELIST:
-            return segregated_freelist_create(heap_size);
+            return segregated_freelist_class_of_ptr(alloc, ptr);
         case ALLOCATOR_MCKUSICK_KARELS:
-            return mckusick_karels_create(heap_size);
+            return mckusick_karels_class_of_ptr(alloc, ptr);
         default:
-            return NULL;
+            return -1;
     }
 }
 
-void allocator_destroy(allocator_t* alloc) {
-    if (!alloc) return;
-    
+static size_t class_size(allocator_t* alloc, int class_idx) {
     switch (alloc->type) {
         case ALLOCATOR_SEGREGATED_FREELIST:
-            segregated_freelist_destroy(alloc);
-            break;
+            return segregated_freelist_class_size(alloc, class_idx);
         case ALLOCATOR_MCKUSICK_KARELS:
-            mckusick_karels_destroy(alloc);
-            break;
+            return mckusick_karels_class_size(alloc, class_idx);
+        default:
+            return 0;
     }
 }
 
-void* allocator_alloc(allocator_t* alloc, size_t size) {
-    if (!alloc) return NULL;
-    
+static size_t class_align(allocator_t* alloc, int class_idx) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_class_align(alloc, class_idx);
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return mckusick_karels_class_align(alloc, class_idx);
+        default:
+            return 0;
+    }
+}
+
+// запросы больше порога обслуживаются отображениями mmap (large_object)
+static size_t large_threshold(allocator_t* alloc) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return LARGE_OBJECT_THRESHOLD;
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return MAX_BUCKET_SIZE;
+        case ALLOCATOR_ARENA:
+            return SIZE_MAX; // крупные арена держит в своих отдельных чанках
+        case ALLOCATOR_BUDDY:
+            return buddy_large_threshold(alloc);
+        case ALLOCATOR_TLSF:
+            return tlsf_large_threshold(alloc);
+        default:
+            return 0;
+    }
+}
+
+// принадлежит ли указатель куче реализации (иначе - крупный объект)
+static bool backend_owns(allocator_t* alloc, void* ptr) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_owns(alloc, ptr);
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return mckusick_karels_owns(alloc, ptr);
+        case ALLOCATOR_ARENA:
+            return arena_owns(alloc, ptr);
+        case ALLOCATOR_BUDDY:
+            return buddy_owns(alloc, ptr);
+        case ALLOCATOR_TLSF:
+            return tlsf_owns(alloc, ptr);
+        default:
+            return false;
+    }
+}
+
+// вызовы реализаций без синхронизации: только под alloc->lock
+static void* backend_alloc(allocator_t* alloc, size_t size) {
     switch (alloc->type) {
         case ALLOCATOR_SEGREGATED_FREELIST:
             return segregated_freelist_alloc(alloc, size);
         case ALLOCATOR_MCKUSICK_KARELS:
             return mckusick_karels_alloc(alloc, size);
+        case ALLOCATOR_BUDDY:
+            return buddy_alloc(alloc, size);
+        case ALLOCATOR_TLSF:
+            return tlsf_alloc(alloc, size);
         default:
             return NULL;
     }
 }
 
-void allocator_free(allocator_t* alloc, void* ptr) {
-    if (!alloc || !ptr) return;
-    
+static size_t backend_alloc_batch(allocator_t* alloc, int class_idx, void** ptrs, size_t count) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_alloc_batch(alloc, class_idx, ptrs, count);
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return mckusick_karels_alloc_batch(alloc, class_idx, ptrs, count);
+        default:
+            return 0;
+    }
+}
+
+static void backend_free(allocator_t* alloc, void* ptr) {
     switch (alloc->type) {
         case ALLOCATOR_SEGREGATED_FREELIST:
             segregated_freelist_free(alloc, ptr);
@@ -56,7 +128,588 @@ void allocator_free(allocator_t* alloc, void* ptr) {
         case ALLOCATOR_MCKUSICK_KARELS:
             mckusick_karels_free(alloc, ptr);
             break;
+        case ALLOCATOR_ARENA:
+            arena_free(alloc, ptr);
+            break;
+        case ALLOCATOR_BUDDY:
+            buddy_free(alloc, ptr);
+            break;
+        case ALLOCATOR_TLSF:
+            tlsf_free(alloc, ptr);
+            break;
+    }
+}
+
+// выровненный блок из кучи реализации; NULL - реализация так не умеет
+// (McKusick-Karels выравнивает только объекты своих корзин)
+static void* backend_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_alloc_aligned(alloc, size, alignment);
+        case ALLOCATOR_BUDDY:
+            return buddy_alloc_aligned(alloc, size, alignment);
+        case ALLOCATOR_TLSF:
+            return tlsf_alloc_aligned(alloc, size, alignment);
+        default:
+            return NULL;
+    }
+}
+
+// изменение размера на месте; NULL - блок придётся переносить
+static void* backend_resize(allocator_t* alloc, void* ptr, size_t new_size) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_resize(alloc, ptr, new_size);
+        case ALLOCATOR_BUDDY:
+            return buddy_resize(alloc, ptr, new_size);
+        case ALLOCATOR_TLSF:
+            return tlsf_resize(alloc, ptr, new_size);
+        default:
+            return NULL;
+    }
+}
+
+static size_t backend_usable_size(allocator_t* alloc, void* ptr) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return segregated_freelist_usable_size(alloc, ptr);
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return mckusick_karels_usable_size(alloc, ptr);
+        case ALLOCATOR_ARENA:
+            return arena_usable_size(alloc, ptr);
+        case ALLOCATOR_BUDDY:
+            return buddy_usable_size(alloc, ptr);
+        case ALLOCATOR_TLSF:
+            return tlsf_usable_size(alloc, ptr);
+        default:
+            return 0;
+    }
+}
+
+// состояние кучи и пик занятого (под lock)
+static void backend_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            segregated_freelist_get_stats(alloc, stats);
+            break;
+        case ALLOCATOR_MCKUSICK_KARELS:
+            mckusick_karels_get_stats(alloc, stats);
+            break;
+        case ALLOCATOR_ARENA:
+            arena_get_stats(alloc, stats);
+            break;
+        case ALLOCATOR_BUDDY:
+            buddy_get_stats(alloc, stats);
+            break;
+        case ALLOCATOR_TLSF:
+            tlsf_get_stats(alloc, stats);
+            break;
+    }
+}
+
+static void backend_reset_peak(allocator_t* alloc) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            segregated_freelist_reset_peak(alloc);
+            break;
+        case ALLOCATOR_MCKUSICK_KARELS:
+            mckusick_karels_reset_peak(alloc);
+            break;
+        case ALLOCATOR_ARENA:
+            arena_reset_peak(alloc);
+            break;
+        case ALLOCATOR_BUDDY:
+            buddy_reset_peak(alloc);
+            break;
+        case ALLOCATOR_TLSF:
+            tlsf_reset_peak(alloc);
+            break;
+    }
+}
+
+// учёт блоков, прошедших мимо кэшей потоков
+static void count_direct_alloc(allocator_t* alloc, size_t requested, size_t reserved, bool large) {
+    SHARED_COUNTER_ADD(alloc->direct.allocs, 1);
+    SHARED_COUNTER_ADD(alloc->direct.requested, requested);
+    SHARED_COUNTER_ADD(alloc->direct.reserved, reserved);
+    if (large) {
+        SHARED_COUNTER_ADD(alloc->direct.large_allocs, 1);
+    }
+}
+
+static void count_direct_free(allocator_t* alloc, size_t released) {
+    SHARED_COUNTER_ADD(alloc->direct.frees, 1);
+    SHARED_COUNTER_ADD(alloc->direct.released, released);
+}
+
+static void backend_destroy(allocator_t* alloc) {
+    switch (alloc->type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            segregated_freelist_destroy(alloc);
+            break;
+        case ALLOCATOR_MCKUSICK_KARELS:
+            mckusick_karels_destroy(alloc);
+            break;
+        case ALLOCATOR_ARENA:
+            arena_destroy(alloc);
+            break;
+        case ALLOCATOR_BUDDY:
+            buddy_destroy(alloc);
+            break;
+        case ALLOCATOR_TLSF:
+            tlsf_destroy(alloc);
+            break;
+    }
+}
+
+static size_t page_round(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+// отображение с запасом на выравнивание, лишнее с краёв снимается
+void* allocator_map(size_t size, size_t alignment) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (alignment < page) {
+        alignment = page;
+    }
+    size = page_round(size);
+    size_t span = size + alignment - page;
+    char* base = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    
+    char* start = (char*)(((uintptr_t)base + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (start > base) {
+        munmap(base, start - base);
+    }
+    if (start + size < base + span) {
+        munmap(start + size, base + span - (start + size));
+    }
+    return start;
+}
+
+void allocator_unmap(void* ptr, size_t size) {
+    if (ptr) {
+        munmap(ptr, page_round(size));
+    }
+}
+
+#define RELEASE_VEC_PAGES 256
+
+size_t allocator_release_pages(void* start, size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t resident = 0;
+    unsigned char vec[RELEASE_VEC_PAGES];
+    for (size_t offset = 0; offset < size; offset += RELEASE_VEC_PAGES * page) {
+        size_t chunk = size - offset;
+        if (chunk > RELEASE_VEC_PAGES * page) {
+            chunk = RELEASE_VEC_PAGES * page;
+        }
+        size_t pages = (chunk + page - 1) / page;
+        if (mincore((char*)start + offset, chunk, vec) != 0) {
+            // без сведений о страницах считаем отданным весь кусок
+            resident += chunk;
+            continue;
+        }
+        for (size_t i = 0; i < pages; i++) {
+            if (vec[i] & 1) {
+                resident += page;
+            }
+        }
+    }
+    madvise(start, size, MADV_DONTNEED);
+    return resident < size ? resident : size;
+}
+
+size_t allocator_refill_class(allocator_t* alloc, int class_idx, void** ptrs, size_t count) {
+    pthread_mutex_lock(&alloc->lock);
+    if (alloc->type == ALLOCATOR_MCKUSICK_KARELS) {
+        mckusick_karels_drain_remote(alloc);
+    }
+    size_t filled = backend_alloc_batch(alloc, class_idx, ptrs, count);
+    pthread_mutex_unlock(&alloc->lock);
+    
+    return filled;
+}
+
+size_t allocator_class_size(allocator_t* alloc, int class_idx) {
+    return class_size(alloc, class_idx);
+}
+
+void allocator_flush_class(allocator_t* alloc, int class_idx, void** ptrs, size_t count) {
+    (void)class_idx;
+    
+    // страницы McKusick-Karels принимают чужие освобождения без блокировки
+    if (alloc->type == ALLOCATOR_MCKUSICK_KARELS) {
+        mckusick_karels_free_remote_batch(alloc, ptrs, count);
+        // если блокировка свободна, сразу разбираем очередь: иначе опустевшие
+        // страницы не вернутся ОС до следующего пополнения магазина
+        if (pthread_mutex_trylock(&alloc->lock) == 0) {
+            mckusick_karels_drain_remote(alloc);
+            pthread_mutex_unlock(&alloc->lock);
+        }
+        return;
+    }
+    
+    pthread_mutex_lock(&alloc->lock);
+    for (size_t i = 0; i < count; i++) {
+        backend_free(alloc, ptrs[i]);
+    }
+    pthread_mutex_unlock(&alloc->lock);
+}
+
+allocator_t* allocator_create(allocator_type_t type, size_t heap_size) {
+    allocator_t* alloc;
+    
+    switch (type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            alloc = segregated_freelist_create(heap_size);
+            break;
+        case ALLOCATOR_MCKUSICK_KARELS:
+            alloc = mckusick_karels_create(heap_size);
+            break;
+        case ALLOCATOR_ARENA:
+            alloc = arena_create(heap_size);
+            break;
+        case ALLOCATOR_BUDDY:
+            alloc = buddy_create(heap_size);
+            break;
+        case ALLOCATOR_TLSF:
+            alloc = tlsf_create(heap_size);
+            break;
+        default:
+            return NULL;
+    }
+    if (!alloc) return NULL;
+    
+    pthread_mutex_init(&alloc->lock, NULL);
+    large_object_init(&alloc->large);
+    memset(&alloc->retired, 0, sizeof(alloc->retired));
+    memset(&alloc->direct, 0, sizeof(alloc->direct));
+    memset(&alloc->baseline, 0, sizeof(alloc->baseline));
+    alloc->trace = NULL;
+    if (!tcache_init(alloc)) {
+        large_object_destroy(&alloc->large);
+        pthread_mutex_destroy(&alloc->lock);
+        backend_destroy(alloc);
+        return NULL;
+    }
+    
+    return alloc;
+}
+
+void allocator_destroy(allocator_t* alloc) {
+    if (!alloc) return;
+    
+    tcache_teardown(alloc);
+    large_object_destroy(&alloc->large);
+    pthread_mutex_destroy(&alloc->lock);
+    backend_destroy(alloc);
+}
+
+// Тела публичных функций без записи трассы: realloc и пачки вызывают их
+// изнутри, и в трассу должна попасть только внешняя операция
+static void* alloc_impl(allocator_t* alloc, size_t size) {
+    // арена ведёт счётчики сама под lock: сдвиг указателя дешевле,
+    // чем атомарные прибавления прямого пути
+    if (alloc->type == ALLOCATOR_ARENA) {
+        pthread_mutex_lock(&alloc->lock);
+        void* ptr = arena_alloc(alloc, size);
+        pthread_mutex_unlock(&alloc->lock);
+        return ptr;
+    }
+    
+    void* ptr;
+    int class_idx = class_of_size(alloc, size);
+    if (class_idx >= 0) {
+        ptr = tcache_alloc(alloc, class_idx, size);
+    } else if (size > large_threshold(alloc)) {
+        ptr = large_object_alloc(&alloc->large, size);
+        if (ptr) {
+            count_direct_alloc(alloc, size, large_object_usable_size(ptr), true);
+        }
+    } else {
+        size_t reserved = 0;
+        pthread_mutex_lock(&alloc->lock);
+        ptr = backend_alloc(alloc, size);
+        if (ptr) {
+            reserved = backend_usable_size(alloc, ptr);
+        }
+        pthread_mutex_unlock(&alloc->lock);
+        if (ptr) {
+            count_direct_alloc(alloc, size, reserved, false);
+        }
+    }
+    
+    if (!ptr && size > 0) {
+        SHARED_COUNTER_ADD(alloc->direct.failed, 1);
+    }
+    return ptr;
+}
+
+void* allocator_alloc(allocator_t* alloc, size_t size) {
+    if (!alloc) return NULL;
+    
+    void* ptr = alloc_impl(alloc, size);
+    if (alloc->trace) {
+        trace_record_alloc(alloc->trace, ptr, size, 0);
+    }
+    return ptr;
+}
+
+// наименьший класс не меньше size, объекты которого сами выровнены
+// по alignment; -1 - такого класса нет
+static int aligned_class(allocator_t* alloc, size_t size, size_t alignment) {
+    int class_idx = class_of_size(alloc, size);
+    if (class_idx < 0) {
+        return -1;
+    }
+    while (class_idx < NUM_SIZE_CLASSES && class_align(alloc, class_idx) < alignment) {
+        class_idx++;
+    }
+    return class_idx < NUM_SIZE_CLASSES ? class_idx : -1;
+}
+
+static void* aligned_alloc_impl(allocator_t* alloc, size_t alignment, size_t size) {
+    if (alignment <= ALLOCATOR_MIN_ALIGNMENT) {
+        return alloc_impl(alloc, size);
+    }
+    if (alloc->type == ALLOCATOR_ARENA) {
+        pthread_mutex_lock(&alloc->lock);
+        void* ptr = arena_alloc_aligned(alloc, size, alignment);
+        pthread_mutex_unlock(&alloc->lock);
+        return ptr;
+    }
+    
+    // сначала класс с подходящим шагом объектов: блок берётся из кэша потока
+    // и лишнего не тратит; иначе - выровненный блок кучи, а если реализация
+    // так не умеет - отображение (не больше страницы сверху)
+    void* ptr = NULL;
+    int class_idx = aligned_class(alloc, size, alignment);
+    if (class_idx >= 0) {
+        ptr = tcache_alloc(alloc, class_idx, size);
+    } else {
+        if (size <= large_threshold(alloc)) {
+            size_t reserved = 0;
+            pthread_mutex_lock(&alloc->lock);
+            ptr = backend_alloc_aligned(alloc, size, alignment);
+            if (ptr) {
+                reserved = backend_usable_size(alloc, ptr);
+            }
+            pthread_mutex_unlock(&alloc->lock);
+            if (ptr) {
+                count_direct_alloc(alloc, size, reserved, false);
+            }
+        }
+        if (!ptr) {
+            ptr = large_object_alloc_aligned(&alloc->large, size, alignment);
+            if (ptr) {
+                count_direct_alloc(alloc, size, large_object_usable_size(ptr), true);
+            }
+        }
+    }
+    
+    if (!ptr) {
+        SHARED_COUNTER_ADD(alloc->direct.failed, 1);
+    }
+    return ptr;
+}
+
+void* allocator_aligned_alloc(allocator_t* alloc, size_t alignment, size_t size) {
+    if (!alloc || size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+        alignment > ALLOCATOR_MAX_ALIGNMENT) {
+        return NULL;
+    }
+    
+    void* ptr = aligned_alloc_impl(alloc, alignment, size);
+    if (alloc->trace) {
+        trace_record_alloc(alloc->trace, ptr, size, alignment);
+    }
+    return ptr;
+}
+
+static void free_impl(allocator_t* alloc, void* ptr) {
+    if (alloc->type == ALLOCATOR_ARENA) {
+        pthread_mutex_lock(&alloc->lock);
+        arena_free(alloc, ptr);
+        pthread_mutex_unlock(&alloc->lock);
+        return;
+    }
+    
+    if (!backend_owns(alloc, ptr)) {
+        count_direct_free(alloc, large_object_usable_size(ptr));
+        large_object_free(&alloc->large, ptr);
+        return;
+    }
+    
+    int class_idx = class_of_ptr(alloc, ptr);
+    if (class_idx >= 0) {
+        tcache_free(alloc, class_idx, ptr);
+        return;
+    }
+    
+    pthread_mutex_lock(&alloc->lock);
+    size_t released = backend_usable_size(alloc, ptr);
+    backend_free(alloc, ptr);
+    pthread_mutex_unlock(&alloc->lock);
+    count_direct_free(alloc, released);
+}
+
+void allocator_free(allocator_t* alloc, void* ptr) {
+    if (!alloc || !ptr) return;
+    
+    if (alloc->trace) {
+        trace_record_free(alloc->trace, ptr, 0);
+    }
+    free_impl(alloc, ptr);
+}
+
+// Размер определяет класс так же, как при выделении; проверка диапазона
+// кучи не трогает сам блок, а выровненные крупные объекты с размером
+// класса отсеивает
+static void free_class_impl(allocator_t* alloc, void* ptr, int class_idx) {
+    if (class_idx >= 0 && backend_owns(alloc, ptr)) {
+        tcache_free(alloc, class_idx, ptr);
+        return;
+    }
+    free_impl(alloc, ptr);
+}
+
+void allocator_free_sized(allocator_t* alloc, void* ptr, size_t size) {
+    if (!alloc || !ptr) return;
+    
+    if (alloc->trace) {
+        trace_record_free(alloc->trace, ptr, size);
+    }
+    
+    free_class_impl(alloc, ptr, class_of_size(alloc, size));
+}
+
+void allocator_free_aligned_sized(allocator_t* alloc, void* ptr, size_t alignment, size_t size) {
+    if (!alloc || !ptr) return;
+    
+    // выровненный блок записывается обычным освобождением: воспроизведение
+    // трассы по одному размеру подобрало бы класс без учёта выравнивания
+    if (alloc->trace) {
+        trace_record_free(alloc->trace, ptr, 0);
+    }
+    
+    // класс подбирается так же, как в aligned_alloc_impl
+    int class_idx = alignment <= ALLOCATOR_MIN_ALIGNMENT ? class_of_size(alloc, size)
+                                                         : aligned_class(alloc, size, alignment);
+    free_class_impl(alloc, ptr, class_idx);
+}
+
+size_t allocator_alloc_batch(allocator_t* alloc, size_t size, void** ptrs, size_t count) {
+    if (!alloc || !ptrs || count == 0) return 0;
+    
+    // класс определяется один раз на всю пачку; вне классов - по одному
+    size_t filled = 0;
+    int class_idx = class_of_size(alloc, size);
+    if (class_idx < 0) {
+        while (filled < count && (ptrs[filled] = alloc_impl(alloc, size)) != NULL) {
+            filled++;
+        }
+    } else {
+        filled = tcache_alloc_batch(alloc, class_idx, size, ptrs, count);
+        if (filled < count) {
+            SHARED_COUNTER_ADD(alloc->direct.failed, count - filled);
+        }
     }
+    
+    if (alloc->trace) {
+        for (size_t i = 0; i < filled; i++) {
+            trace_record_alloc(alloc->trace, ptrs[i], size, 0);
+        }
+    }
+    return filled;
+}
+
+void allocator_free_batch(allocator_t* alloc, void** ptrs, size_t count) {
+    if (!alloc || !ptrs) return;
+    
+    if (alloc->trace) {
+        for (size_t i = 0; i < count; i++) {
+            trace_record_free(alloc->trace, ptrs[i], 0);
+        }
+    }
+    
+    // подряд идущие блоки одного класса уходят в кэш потока одной серией
+    size_t i = 0;
+    while (i < count) {
+        if (!ptrs[i]) {
+            i++;
+            continue;
+        }
+        int class_idx = backend_owns(alloc, ptrs[i]) ? class_of_ptr(alloc, ptrs[i]) : -1;
+        if (class_idx < 0) {
+            free_impl(alloc, ptrs[i++]);
+            continue;
+        }
+        
+        size_t run = 1;
+        while (i + run < count && ptrs[i + run] && backend_owns(alloc, ptrs[i + run]) &&
+               class_of_ptr(alloc, ptrs[i + run]) == class_idx) {
+            run++;
+        }
+        tcache_free_batch(alloc, class_idx, ptrs + i, run);
+        i += run;
+    }
+}
+
+static void* realloc_impl(allocator_t* alloc, void* ptr, size_t new_size) {
+    // изменение на месте учитывается как освобождение старого блока
+    // и выделение нового по прямому пути
+    if (alloc->type == ALLOCATOR_ARENA) {
+        pthread_mutex_lock(&alloc->lock);
+        void* resized = arena_resize(alloc, ptr, new_size);
+        pthread_mutex_unlock(&alloc->lock);
+        if (resized) {
+            return resized;
+        }
+    } else if (!backend_owns(alloc, ptr)) {
+        if (new_size > large_threshold(alloc)) {
+            size_t old_size = large_object_usable_size(ptr);
+            void* resized = large_object_realloc(&alloc->large, ptr, new_size);
+            if (resized) {
+                count_direct_free(alloc, old_size);
+                count_direct_alloc(alloc, new_size, large_object_usable_size(resized), true);
+            }
+            return resized;
+        }
+    } else {
+        // тот же размерный класс - блок подходит как есть
+        int class_idx = class_of_ptr(alloc, ptr);
+        if (class_idx >= 0 && class_idx == class_of_size(alloc, new_size)) {
+            return ptr;
+        }
+        if (new_size <= large_threshold(alloc)) {
+            pthread_mutex_lock(&alloc->lock);
+            size_t old_size = backend_usable_size(alloc, ptr);
+            void* resized = backend_resize(alloc, ptr, new_size);
+            size_t new_reserved = resized ? backend_usable_size(alloc, resized) : 0;
+            pthread_mutex_unlock(&alloc->lock);
+            if (resized) {
+                count_direct_free(alloc, old_size);
+                count_direct_alloc(alloc, new_size, new_reserved, false);
+                return resized;
+            }
+        }
+    }
+    
+    // перенос: копируем не больше, чем было доступно в старом блоке
+    size_t old_size = allocator_usable_size(alloc, ptr);
+    void* new_ptr = alloc_impl(alloc, new_size);
+    if (!new_ptr) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    free_impl(alloc, ptr);
+    
+    return new_ptr;
 }
 
 void* allocator_realloc(allocator_t* alloc, void* ptr, size_t new_size) {
@@ -71,20 +724,230 @@ void* allocator_realloc(allocator_t* alloc, void* ptr, size_t new_size) {
         return NULL;
     }
     
-    void* new_ptr = allocator_alloc(alloc, new_size);
-    if (new_ptr) {
-        allocator_free(alloc, ptr);
+    if (!alloc->trace) {
+        return realloc_impl(alloc, ptr, new_size);
     }
-    
+    trace_realloc_begin(alloc->trace);
+    void* new_ptr = realloc_impl(alloc, ptr, new_size);
+    trace_realloc_end(alloc->trace, ptr, new_ptr, new_size);
     return new_ptr;
 }
 
-void allocator_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
-    if (!alloc || !stats) return;
+size_t allocator_usable_size(allocator_t* alloc, void* ptr) {
+    if (!alloc || !ptr) return 0;
+    
+    if (alloc->type == ALLOCATOR_ARENA) {
+        // граница объекта зависит от top текущего чанка
+        pthread_mutex_lock(&alloc->lock);
+        size_t size = arena_usable_size(alloc, ptr);
+        pthread_mutex_unlock(&alloc->lock);
+        return size;
+    }
+    if (!backend_owns(alloc, ptr)) {
+        return large_object_usable_size(ptr);
+    }
+    return backend_usable_size(alloc, ptr);
+}
+
+allocator_mark_t allocator_mark(allocator_t* alloc) {
+    allocator_mark_t mark = { 0 };
+    if (!alloc || alloc->type != ALLOCATOR_ARENA) return mark;
+    
+    pthread_mutex_lock(&alloc->lock);
+    mark = arena_mark(alloc);
+    pthread_mutex_unlock(&alloc->lock);
+    return mark;
+}
+
+bool allocator_rewind(allocator_t* alloc, allocator_mark_t mark) {
+    if (!alloc || alloc->type != ALLOCATOR_ARENA) return false;
+    
+    pthread_mutex_lock(&alloc->lock);
+    arena_rewind(alloc, mark);
+    pthread_mutex_unlock(&alloc->lock);
+    return true;
+}
+
+bool allocator_reset(allocator_t* alloc) {
+    allocator_mark_t start = { 0 };
+    return allocator_rewind(alloc, start);
+}
+
+void allocator_set_trace(allocator_t* alloc, trace_recorder_t* rec) {
+    if (alloc) {
+        alloc->trace = rec;
+    }
+}
+
+size_t allocator_trim(allocator_t* alloc) {
+    if (!alloc) return 0;
+    
+    // блоки в магазине текущего потока не дают странице опустеть
+    tcache_flush(alloc);
+    
+    size_t released = large_object_trim(&alloc->large);
+    pthread_mutex_lock(&alloc->lock);
+    switch (alloc->type) {
+        case ALLOCATOR_MCKUSICK_KARELS:
+            released += mckusick_karels_trim(alloc);
+            break;
+        case ALLOCATOR_ARENA:
+            released += arena_trim(alloc);
+            break;
+        case ALLOCATOR_BUDDY:
+            released += buddy_trim(alloc);
+            break;
+        case ALLOCATOR_TLSF:
+            released += tlsf_trim(alloc);
+            break;
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&alloc->lock);
     
+    return released;
+}
+
+// сырые накопительные значения без вычета baseline (под lock)
+static void collect_stats(allocator_t* alloc, allocator_stats_t* stats) {
     memset(stats, 0, sizeof(allocator_stats_t));
+    
+    class_counters_t sum = alloc->retired;
+    tcache_collect(alloc, &sum);
+    // арена заполняет и счётчики операций, остальное к ним прибавляется
+    backend_get_stats(alloc, stats);
+    stats->large_mapped += large_object_mapped(&alloc->large);
+    
+    // у арены, buddy и TLSF размерных классов нет
+    size_t class_reserved = 0, class_live = 0;
+    bool classless = alloc->type == ALLOCATOR_ARENA || alloc->type == ALLOCATOR_BUDDY ||
+                     alloc->type == ALLOCATOR_TLSF;
+    stats->num_classes = classless ? 0 : NUM_SIZE_CLASSES;
+    for (size_t i = 0; i < stats->num_classes; i++) {
+        size_t size = class_size(alloc, i);
+        stats->classes[i].size = size;
+        stats->classes[i].allocations = sum.allocs[i];
+        stats->classes[i].frees = sum.frees[i];
+        stats->total_allocations += sum.allocs[i];
+        stats->total_frees += sum.frees[i];
+        class_reserved += sum.allocs[i] * size;
+        class_live += (sum.allocs[i] - sum.frees[i]) * size;
+    }
+    
+    direct_counters_t* direct = &alloc->direct;
+    stats->total_allocations += COUNTER_READ(direct->allocs);
+    stats->total_frees += COUNTER_READ(direct->frees);
+    stats->failed_allocations += COUNTER_READ(direct->failed);
+    stats->large_allocations += COUNTER_READ(direct->large_allocs);
+    stats->bytes_requested += sum.requested + COUNTER_READ(direct->requested);
+    stats->bytes_reserved += class_reserved + COUNTER_READ(direct->reserved);
+    stats->current_allocated += class_live + COUNTER_READ(direct->reserved)
+                             - COUNTER_READ(direct->released);
+    
+    if (stats->free_bytes > 0) {
+        stats->fragmentation = 1.0 - (double)stats->largest_free_block / stats->free_bytes;
+    }
 }
 
+void allocator_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(allocator_stats_t));
+    if (!alloc) return;
+    
+    pthread_mutex_lock(&alloc->lock);
+    collect_stats(alloc, stats);
+    allocator_stats_t* base = &alloc->baseline;
+    stats->total_allocations -= base->total_allocations;
+    stats->total_frees -= base->total_frees;
+    stats->failed_allocations -= base->failed_allocations;
+    stats->large_allocations -= base->large_allocations;
+    stats->bytes_requested -= base->bytes_requested;
+    stats->bytes_reserved -= base->bytes_reserved;
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        stats->classes[i].allocations -= base->classes[i].allocations;
+        stats->classes[i].frees -= base->classes[i].frees;
+    }
+    pthread_mutex_unlock(&alloc->lock);
+}
+
+// счётчики потоков не обнуляются (их пишут владельцы без синхронизации),
+// вместо этого запоминается снимок, который вычитается при чтении
 void allocator_reset_stats(allocator_t* alloc) {
     if (!alloc) return;
+    
+    pthread_mutex_lock(&alloc->lock);
+    collect_stats(alloc, &alloc->baseline);
+    backend_reset_peak(alloc);
+    pthread_mutex_unlock(&alloc->lock);
+}
+
+static const char* type_name(allocator_type_t type) {
+    switch (type) {
+        case ALLOCATOR_SEGREGATED_FREELIST:
+            return "segregated";
+        case ALLOCATOR_MCKUSICK_KARELS:
+            return "mckusick";
+        case ALLOCATOR_ARENA:
+            return "arena";
+        case ALLOCATOR_BUDDY:
+            return "buddy";
+        case ALLOCATOR_TLSF:
+            return "tlsf";
+        default:
+            return "unknown";
+    }
+}
+
+void allocator_dump_stats(allocator_t* alloc, FILE* out, allocator_stats_format_t format) {
+    if (!alloc || !out) return;
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    
+    const struct {
+        const char* name;
+        size_t value;
+    } fields[] = {
+        { "total_allocations", stats.total_allocations },
+        { "total_frees", stats.total_frees },
+        { "current_allocated", stats.current_allocated },
+        { "peak_allocated", stats.peak_allocated },
+        { "failed_allocations", stats.failed_allocations },
+        { "bytes_requested", stats.bytes_requested },
+        { "bytes_reserved", stats.bytes_reserved },
+        { "large_allocations", stats.large_allocations },
+        { "heap_size", stats.heap_size },
+        { "free_bytes", stats.free_bytes },
+        { "free_blocks", stats.free_blocks },
+        { "largest_free_block", stats.largest_free_block },
+        { "large_mapped", stats.large_mapped },
+    };
+    size_t num_fields = sizeof(fields) / sizeof(fields[0]);
+    
+    if (format == ALLOCATOR_STATS_CSV) {
+        fprintf(out, "metric,class_size,value\n");
+        fprintf(out, "allocator,,%s\n", type_name(alloc->type));
+        for (size_t i = 0; i < num_fields; i++) {
+            fprintf(out, "%s,,%zu\n", fields[i].name, fields[i].value);
+        }
+        fprintf(out, "fragmentation,,%.6f\n", stats.fragmentation);
+        for (size_t i = 0; i < stats.num_classes; i++) {
+            fprintf(out, "class_allocations,%zu,%zu\n", stats.classes[i].size, stats.classes[i].allocations);
+            fprintf(out, "class_frees,%zu,%zu\n", stats.classes[i].size, stats.classes[i].frees);
+        }
+        return;
+    }
+    
+    fprintf(out, "{\n  \"allocator\": \"%s\",\n", type_name(alloc->type));
+    for (size_t i = 0; i < num_fields; i++) {
+        fprintf(out, "  \"%s\": %zu,\n", fields[i].name, fields[i].value);
+    }
+    fprintf(out, "  \"fragmentation\": %.6f,\n", stats.fragmentation);
+    fprintf(out, "  \"classes\": [\n");
+    for (size_t i = 0; i < stats.num_classes; i++) {
+        fprintf(out, "    {\"size\": %zu, \"allocations\": %zu, \"frees\": %zu}%s\n",
+                stats.classes[i].size, stats.classes[i].allocations, stats.classes[i].frees,
+                i + 1 < stats.num_classes ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
 }
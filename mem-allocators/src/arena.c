@@ -0,0 +1,405 @@
+#include "../include/arena.h"
+#include "../include/allocator_internal.h"
+#include <stdint.h>
+#include <string.h>
+
+#define ARENA_GRANULE 16 // шаг адресов объектов (ALLOCATOR_MIN_ALIGNMENT)
+#define ARENA_GRANULES (ARENA_CHUNK_SIZE / ARENA_GRANULE)
+#define ARENA_BITMAP_WORDS (ARENA_GRANULES / 64)
+
+// Заголовок чанка. У обычного за ним битовая карта начал объектов: по биту
+// на гранулу, 1 - с неё начинается объект. Размеров объекты не хранят,
+// usable size - расстояние до начала следующего объекта или до top.
+// Биты не чистятся при сбросе (иначе он стал бы O(размера)), поэтому
+// выделение само обнуляет карту на занимаемом участке
+typedef struct arena_chunk {
+    struct arena_chunk* next; // обычные: следующий в цепочке, отдельные - более старый
+    struct arena_chunk* prev; // только у отдельных
+    size_t map_size;
+    size_t top; // смещение конца занятого от начала чанка; у отдельного - начала данных
+    size_t index; // номер обычного чанка в цепочке / номер отдельного
+    bool dedicated;
+    uint64_t starts[]; // только у обычных: ARENA_BITMAP_WORDS слов
+} arena_chunk_t;
+
+// начало данных обычного чанка: за заголовком и картой, по линии кэша
+#define ARENA_DATA_OFFSET \
+    ((sizeof(arena_chunk_t) + ARENA_BITMAP_WORDS * sizeof(uint64_t) + 63) & ~(size_t)63)
+
+// Цепочка обычных чанков: first..current заняты, за current - запасные,
+// оставшиеся от прошлых сбросов. Отдельные чанки - в своём списке от новых
+// к старым; откат снимает те, что выделены после метки
+typedef struct {
+    allocator_t base;
+    arena_chunk_t* first;
+    arena_chunk_t* current;
+    size_t num_chunks; // отображено обычных чанков
+    size_t max_chunks; // предел по heap_size
+    arena_chunk_t* large;
+    size_t large_seq; // номер следующего отдельного чанка
+    size_t large_bytes; // отображено под отдельные чанки
+    size_t large_used; // usable size живых объектов в них
+    size_t used; // занято в обычных чанках, вместе с промежутками выравнивания
+    size_t peak_used;
+    // счётчики операций (под lock)
+    size_t allocs;
+    size_t frees;
+    size_t failed;
+    size_t requested;
+    size_t reserved;
+    size_t large_allocs;
+} arena_allocator_t;
+
+static inline size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline arena_chunk_t* chunk_of(void* ptr) {
+    return (arena_chunk_t*)((uintptr_t)ptr & ~(uintptr_t)(ARENA_CHUNK_SIZE - 1));
+}
+
+// первая гранула из [from, limit), с которой начинается объект; limit - нет таких
+static size_t next_start(const arena_chunk_t* chunk, size_t from, size_t limit) {
+    while (from < limit) {
+        uint64_t word = chunk->starts[from / 64] >> (from % 64);
+        if (word) {
+            size_t granule = from + (size_t)__builtin_ctzll(word);
+            return granule < limit ? granule : limit;
+        }
+        from = (from / 64 + 1) * 64;
+    }
+    return limit;
+}
+
+// обнуляет биты гранул [from, to)
+static void clear_starts(arena_chunk_t* chunk, size_t from, size_t to) {
+    while (from < to) {
+        size_t word = from / 64;
+        size_t lo = from % 64;
+        size_t hi = to - word * 64 < 64 ? to - word * 64 : 64;
+        uint64_t mask = (hi == 64 ? ~0ull : (1ull << hi) - 1) & ~((1ull << lo) - 1);
+        chunk->starts[word] &= ~mask;
+        from = word * 64 + hi;
+    }
+}
+
+static void update_peak(arena_allocator_t* arena) {
+    size_t live = arena->used + arena->large_used;
+    if (live > arena->peak_used) {
+        arena->peak_used = live;
+    }
+}
+
+static arena_chunk_t* map_chunk(size_t map_size) {
+    // выравнивание по ARENA_CHUNK_SIZE нужно и отдельным: по нему chunk_of
+    return allocator_map(map_size, ARENA_CHUNK_SIZE);
+}
+
+// следующий обычный чанк: запасной из цепочки или новый в пределах heap_size
+static arena_chunk_t* advance_chunk(arena_allocator_t* arena) {
+    arena_chunk_t* next = arena->current->next;
+    if (!next) {
+        if (arena->num_chunks == arena->max_chunks) {
+            return NULL;
+        }
+        next = map_chunk(ARENA_CHUNK_SIZE);
+        if (!next) return NULL;
+        next->map_size = ARENA_CHUNK_SIZE;
+        next->index = arena->num_chunks++;
+        arena->current->next = next;
+    }
+    // всё, что дальше top прежнего чанка, пропадает до сброса
+    arena->used += ARENA_CHUNK_SIZE - arena->current->top;
+    next->top = ARENA_DATA_OFFSET;
+    arena->current = next;
+    return next;
+}
+
+static void* alloc_dedicated(arena_allocator_t* arena, size_t size, size_t alignment) {
+    size_t offset = align_up(sizeof(arena_chunk_t), alignment);
+    if (size > SIZE_MAX - offset - ARENA_CHUNK_SIZE) {
+        return NULL;
+    }
+    arena_chunk_t* chunk = map_chunk(offset + size);
+    if (!chunk) return NULL;
+
+    chunk->dedicated = true;
+    chunk->map_size = align_up(offset + size, 4096);
+    chunk->top = offset;
+    chunk->index = arena->large_seq++;
+    chunk->prev = NULL;
+    chunk->next = arena->large;
+    if (arena->large) {
+        arena->large->prev = chunk;
+    }
+    arena->large = chunk;
+    arena->large_bytes += chunk->map_size;
+    arena->large_used += chunk->map_size - offset;
+    arena->large_allocs++;
+    return (char*)chunk + offset;
+}
+
+static void free_dedicated(arena_allocator_t* arena, arena_chunk_t* chunk) {
+    if (chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        arena->large = chunk->next;
+    }
+    if (chunk->next) {
+        chunk->next->prev = chunk->prev;
+    }
+    arena->large_bytes -= chunk->map_size;
+    arena->large_used -= chunk->map_size - chunk->top;
+    allocator_unmap(chunk, chunk->map_size);
+}
+
+allocator_t* arena_create(size_t heap_size) {
+    if (heap_size == 0) {
+        return NULL;
+    }
+    arena_allocator_t* arena = allocator_map(sizeof(arena_allocator_t), 0);
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->first = map_chunk(ARENA_CHUNK_SIZE);
+    if (!arena->first) {
+        allocator_unmap(arena, sizeof(arena_allocator_t));
+        return NULL;
+    }
+    arena->base.type = ALLOCATOR_ARENA;
+    arena->first->map_size = ARENA_CHUNK_SIZE;
+    arena->first->top = ARENA_DATA_OFFSET;
+    arena->current = arena->first;
+    arena->num_chunks = 1;
+    arena->max_chunks = heap_size / ARENA_CHUNK_SIZE ? heap_size / ARENA_CHUNK_SIZE : 1;
+
+    return (allocator_t*)arena;
+}
+
+void arena_destroy(allocator_t* alloc) {
+    if (!alloc) return;
+
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    arena_chunk_t* chunk = arena->first;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        allocator_unmap(chunk, chunk->map_size);
+        chunk = next;
+    }
+    chunk = arena->large;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        allocator_unmap(chunk, chunk->map_size);
+        chunk = next;
+    }
+    allocator_unmap(arena, sizeof(arena_allocator_t));
+}
+
+void* arena_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    if (size == 0) {
+        return NULL;
+    }
+
+    void* ptr;
+    size_t reserved;
+    if (size > ARENA_LARGE_THRESHOLD) {
+        ptr = alloc_dedicated(arena, size, alignment);
+        reserved = ptr ? arena_usable_size(alloc, ptr) : 0;
+    } else {
+        // bump: выравниваем top, объект занимает целые гранулы
+        arena_chunk_t* chunk = arena->current;
+        size_t offset = align_up(chunk->top, alignment);
+        size_t end = offset + align_up(size, ARENA_GRANULE);
+        if (end > ARENA_CHUNK_SIZE) {
+            chunk = advance_chunk(arena);
+            if (!chunk) {
+                arena->failed++;
+                return NULL;
+            }
+            offset = align_up(chunk->top, alignment);
+            end = offset + align_up(size, ARENA_GRANULE);
+        }
+        clear_starts(chunk, chunk->top / ARENA_GRANULE, end / ARENA_GRANULE);
+        chunk->starts[offset / ARENA_GRANULE / 64] |= 1ull << (offset / ARENA_GRANULE % 64);
+        arena->used += end - chunk->top;
+        chunk->top = end;
+        ptr = (char*)chunk + offset;
+        reserved = end - offset;
+    }
+
+    if (!ptr) {
+        arena->failed++;
+        return NULL;
+    }
+    arena->allocs++;
+    arena->requested += size;
+    arena->reserved += reserved;
+    update_peak(arena);
+    return ptr;
+}
+
+void* arena_alloc(allocator_t* alloc, size_t size) {
+    return arena_alloc_aligned(alloc, size, ARENA_GRANULE);
+}
+
+// последний ли объект в текущем чанке (за ним до top других начал нет)
+static bool is_top(arena_allocator_t* arena, arena_chunk_t* chunk, size_t granule) {
+    return chunk == arena->current &&
+           next_start(chunk, granule + 1, chunk->top / ARENA_GRANULE) == chunk->top / ARENA_GRANULE;
+}
+
+void arena_free(allocator_t* alloc, void* ptr) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    arena_chunk_t* chunk = chunk_of(ptr);
+    arena->frees++;
+
+    if (chunk->dedicated) {
+        free_dedicated(arena, chunk);
+        return;
+    }
+    // последний объект можно вернуть сразу, остальные ждут сброса
+    size_t offset = (size_t)((char*)ptr - (char*)chunk);
+    if (is_top(arena, chunk, offset / ARENA_GRANULE)) {
+        arena->used -= chunk->top - offset;
+        chunk->top = offset;
+    }
+}
+
+void* arena_resize(allocator_t* alloc, void* ptr, size_t new_size) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    arena_chunk_t* chunk = chunk_of(ptr);
+    size_t old_size = arena_usable_size(alloc, ptr);
+    size_t reserved = old_size;
+
+    if (chunk->dedicated) {
+        // мелкий объект не должен держать целое отображение
+        if (new_size > old_size || new_size <= ARENA_LARGE_THRESHOLD) {
+            return NULL;
+        }
+    } else {
+        size_t offset = (size_t)((char*)ptr - (char*)chunk);
+        size_t end = offset + align_up(new_size, ARENA_GRANULE);
+        if (new_size > ARENA_LARGE_THRESHOLD) {
+            return NULL;
+        }
+        if (is_top(arena, chunk, offset / ARENA_GRANULE)) {
+            // последний объект растёт и сжимается сдвигом top
+            if (end > ARENA_CHUNK_SIZE) {
+                return NULL;
+            }
+            clear_starts(chunk, offset / ARENA_GRANULE + 1, end / ARENA_GRANULE);
+            arena->used = arena->used - (chunk->top - offset) + (end - offset);
+            chunk->top = end;
+            reserved = end - offset;
+        } else if (new_size > old_size) {
+            return NULL;
+        }
+    }
+
+    // как у остальных реализаций: освобождение старого и выделение нового
+    arena->frees++;
+    arena->allocs++;
+    arena->requested += new_size;
+    arena->reserved += reserved;
+    update_peak(arena);
+    return ptr;
+}
+
+size_t arena_usable_size(allocator_t* alloc, void* ptr) {
+    (void)alloc;
+    arena_chunk_t* chunk = chunk_of(ptr);
+    size_t offset = (size_t)((char*)ptr - (char*)chunk);
+    if (chunk->dedicated) {
+        return chunk->map_size - chunk->top;
+    }
+    size_t granule = offset / ARENA_GRANULE;
+    size_t limit = chunk->top / ARENA_GRANULE;
+    return (next_start(chunk, granule + 1, limit) - granule) * ARENA_GRANULE;
+}
+
+// все блоки арены лежат в её чанках, мимо large_object
+bool arena_owns(allocator_t* alloc, void* ptr) {
+    (void)alloc;
+    (void)ptr;
+    return true;
+}
+
+allocator_mark_t arena_mark(allocator_t* alloc) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    allocator_mark_t mark = {
+        .chunk = arena->current,
+        .position = arena->current->index * ARENA_CHUNK_SIZE + arena->current->top,
+        .large = arena->large_seq,
+        .used = arena->used
+    };
+    return mark;
+}
+
+// O(1) для обычных чанков: сдвигаются current и top, а чанки за меткой
+// становятся запасными. Отдельные чанки новее метки снимаются по одному
+void arena_rewind(allocator_t* alloc, allocator_mark_t mark) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    if (!mark.chunk) {
+        mark.chunk = arena->first;
+        mark.position = ARENA_DATA_OFFSET;
+        mark.used = 0;
+    }
+
+    // метка позади текущей позиции; иначе (после отката к более ранней
+    // метке) обычные чанки не трогаем
+    arena_chunk_t* current = arena->current;
+    if (mark.position < current->index * ARENA_CHUNK_SIZE + current->top) {
+        arena->current = mark.chunk;
+        arena->current->top = mark.position % ARENA_CHUNK_SIZE;
+        arena->used = mark.used;
+    }
+    while (arena->large && arena->large->index >= mark.large) {
+        free_dedicated(arena, arena->large);
+    }
+}
+
+size_t arena_trim(allocator_t* alloc) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    size_t released = 0;
+    arena_chunk_t* chunk = arena->current->next;
+    arena->current->next = NULL;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        released += chunk->map_size;
+        allocator_unmap(chunk, chunk->map_size);
+        arena->num_chunks--;
+        chunk = next;
+    }
+    return released;
+}
+
+void arena_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+
+    stats->heap_size = arena->num_chunks * ARENA_CHUNK_SIZE;
+    stats->free_bytes = ARENA_CHUNK_SIZE - arena->current->top;
+    stats->free_blocks = stats->free_bytes > 0;
+    stats->largest_free_block = stats->free_bytes;
+    for (arena_chunk_t* spare = arena->current->next; spare; spare = spare->next) {
+        stats->free_bytes += ARENA_CHUNK_SIZE - ARENA_DATA_OFFSET;
+        stats->free_blocks++;
+        stats->largest_free_block = ARENA_CHUNK_SIZE - ARENA_DATA_OFFSET;
+    }
+    stats->peak_allocated = arena->peak_used;
+    stats->large_mapped = arena->large_bytes;
+
+    stats->total_allocations = arena->allocs;
+    stats->total_frees = arena->frees;
+    stats->failed_allocations = arena->failed;
+    stats->bytes_requested = arena->requested;
+    stats->bytes_reserved = arena->reserved;
+    stats->current_allocated = arena->used + arena->large_used;
+    stats->large_allocations = arena->large_allocs;
+}
+
+void arena_reset_peak(allocator_t* alloc) {
+    arena_allocator_t* arena = (arena_allocator_t*)alloc;
+    arena->peak_used = arena->used + arena->large_used;
+}
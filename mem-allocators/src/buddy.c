@@ -0,0 +1,269 @@
+#include "../include/buddy.h"
+#include "../include/allocator_internal.h"
+#include <stdint.h>
+#include <string.h>
+
+#define BUDDY_FREE 0x80 // в orders[]: блок свободен
+#define BUDDY_ORDER_MASK 0x3F
+#define BUDDY_PAGE_SIZE 4096
+
+// Свободный блок: ссылки списка своего порядка лежат в нём самом.
+// Выданные блоки заголовков не имеют
+typedef struct buddy_block {
+    struct buddy_block* next;
+    struct buddy_block* prev;
+} buddy_block_t;
+
+// Метаданные вне блоков: байт на каждые BUDDY_MIN_BLOCK кучи. Для начала
+// блока в нём порядок и флаг BUDDY_FREE, внутренние байты не читаются:
+// близнец блока порядка k выровнен по 2^k и всегда начало блока
+typedef struct {
+    allocator_t base;
+    char* heap; // выровнена по BUDDY_MAX_BLOCK
+    size_t heap_size; // кратен BUDDY_MIN_BLOCK
+    uint8_t* orders;
+    size_t num_units; // heap_size / BUDDY_MIN_BLOCK
+    buddy_block_t* free_lists[BUDDY_MAX_ORDER + 1];
+    uint64_t free_mask; // бит k - список порядка k непуст
+    int max_order; // наибольший блок, поместившийся в кучу
+    size_t used; // байт в выданных блоках
+    size_t peak_used;
+    size_t free_bytes;
+    size_t free_blocks;
+} buddy_allocator_t;
+
+static inline size_t unit_of(buddy_allocator_t* buddy, void* block) {
+    return (size_t)((char*)block - buddy->heap) >> BUDDY_MIN_ORDER;
+}
+
+// наименьший порядок, блок которого вмещает size
+static inline int order_for(size_t size) {
+    if (size <= BUDDY_MIN_BLOCK) {
+        return BUDDY_MIN_ORDER;
+    }
+    return 64 - __builtin_clzl(size - 1);
+}
+
+static void push_free(buddy_allocator_t* buddy, void* ptr, int order) {
+    buddy_block_t* block = ptr;
+    buddy_block_t** head = &buddy->free_lists[order];
+    block->prev = NULL;
+    block->next = *head;
+    if (*head) {
+        (*head)->prev = block;
+    }
+    *head = block;
+    buddy->free_mask |= (uint64_t)1 << order;
+    buddy->orders[unit_of(buddy, block)] = BUDDY_FREE | (uint8_t)order;
+    buddy->free_bytes += (size_t)1 << order;
+    buddy->free_blocks++;
+}
+
+static void remove_free(buddy_allocator_t* buddy, buddy_block_t* block, int order) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        buddy->free_lists[order] = block->next;
+        if (!block->next) {
+            buddy->free_mask &= ~((uint64_t)1 << order);
+        }
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    buddy->free_bytes -= (size_t)1 << order;
+    buddy->free_blocks--;
+}
+
+static void mark_used(buddy_allocator_t* buddy, void* block, int order, size_t added) {
+    buddy->orders[unit_of(buddy, block)] = (uint8_t)order;
+    buddy->used += added;
+    if (buddy->used > buddy->peak_used) {
+        buddy->peak_used = buddy->used;
+    }
+}
+
+// свободный список нужного порядка находится по маске за O(1), больший
+// блок делится пополам до нужного порядка: верхние половины уходят в списки
+static void* alloc_order(buddy_allocator_t* buddy, int order) {
+    uint64_t mask = buddy->free_mask & (~(uint64_t)0 << order);
+    if (!mask) {
+        return NULL;
+    }
+    int found = __builtin_ctzll(mask);
+    buddy_block_t* block = buddy->free_lists[found];
+    remove_free(buddy, block, found);
+    while (found > order) {
+        found--;
+        push_free(buddy, (char*)block + ((size_t)1 << found), found);
+    }
+    mark_used(buddy, block, order, (size_t)1 << order);
+    return block;
+}
+
+allocator_t* buddy_create(size_t heap_size) {
+    heap_size &= ~(BUDDY_MIN_BLOCK - 1);
+    if (heap_size == 0) {
+        return NULL;
+    }
+
+    buddy_allocator_t* buddy = allocator_map(sizeof(buddy_allocator_t), 0);
+    if (!buddy) {
+        return NULL;
+    }
+    buddy->num_units = heap_size >> BUDDY_MIN_ORDER;
+    buddy->heap = allocator_map(heap_size, BUDDY_MAX_BLOCK);
+    buddy->orders = allocator_map(buddy->num_units, 0);
+    if (!buddy->heap || !buddy->orders) {
+        if (buddy->heap) allocator_unmap(buddy->heap, heap_size);
+        if (buddy->orders) allocator_unmap(buddy->orders, buddy->num_units);
+        allocator_unmap(buddy, sizeof(buddy_allocator_t));
+        return NULL;
+    }
+    buddy->base.type = ALLOCATOR_BUDDY;
+    buddy->heap_size = heap_size;
+
+    // куча не обязана быть степенью двойки: нарезается наибольшими
+    // выровненными блоками подряд
+    size_t offset = 0;
+    while (offset < heap_size) {
+        int order = BUDDY_MAX_ORDER;
+        while ((offset & (((size_t)1 << order) - 1)) != 0 || offset + ((size_t)1 << order) > heap_size) {
+            order--;
+        }
+        push_free(buddy, buddy->heap + offset, order);
+        if (order > buddy->max_order) {
+            buddy->max_order = order;
+        }
+        offset += (size_t)1 << order;
+    }
+
+    return (allocator_t*)buddy;
+}
+
+void buddy_destroy(allocator_t* alloc) {
+    if (!alloc) return;
+
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    allocator_unmap(buddy->heap, buddy->heap_size);
+    allocator_unmap(buddy->orders, buddy->num_units);
+    allocator_unmap(buddy, sizeof(buddy_allocator_t));
+}
+
+void* buddy_alloc(allocator_t* alloc, size_t size) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    if (size == 0 || size > ((size_t)1 << buddy->max_order)) {
+        return NULL;
+    }
+    return alloc_order(buddy, order_for(size));
+}
+
+void* buddy_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    int order = order_for(size > alignment ? size : alignment);
+    if (size == 0 || order > buddy->max_order) {
+        return NULL;
+    }
+    return alloc_order(buddy, order);
+}
+
+// сливает блок с близнецами, пока те свободны: O(log n)
+void buddy_free(allocator_t* alloc, void* ptr) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    size_t offset = (size_t)((char*)ptr - buddy->heap);
+    int order = buddy->orders[offset >> BUDDY_MIN_ORDER] & BUDDY_ORDER_MASK;
+    buddy->used -= (size_t)1 << order;
+
+    while (order < BUDDY_MAX_ORDER) {
+        size_t twin = offset ^ ((size_t)1 << order);
+        if (twin + ((size_t)1 << order) > buddy->heap_size ||
+            buddy->orders[twin >> BUDDY_MIN_ORDER] != (BUDDY_FREE | order)) {
+            break;
+        }
+        remove_free(buddy, (buddy_block_t*)(buddy->heap + twin), order);
+        offset &= ~((size_t)1 << order);
+        order++;
+    }
+    push_free(buddy, buddy->heap + offset, order);
+}
+
+void* buddy_resize(allocator_t* alloc, void* ptr, size_t new_size) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    size_t offset = (size_t)((char*)ptr - buddy->heap);
+    int order = buddy->orders[offset >> BUDDY_MIN_ORDER] & BUDDY_ORDER_MASK;
+    int new_order = order_for(new_size);
+
+    if (new_order < order) {
+        // верхние половины свободны сразу: их близнецы - сам блок
+        for (int k = order - 1; k >= new_order; k--) {
+            push_free(buddy, (char*)ptr + ((size_t)1 << k), k);
+        }
+        buddy->used -= ((size_t)1 << order) - ((size_t)1 << new_order);
+        mark_used(buddy, ptr, new_order, 0);
+        return ptr;
+    }
+
+    // рост: блок должен быть нижней половиной на каждом уровне,
+    // а верхние половины - свободными блоками своего порядка
+    if (new_order > buddy->max_order || (offset & (((size_t)1 << new_order) - 1)) != 0) {
+        return new_order == order ? ptr : NULL;
+    }
+    for (int k = order; k < new_order; k++) {
+        size_t twin = offset + ((size_t)1 << k);
+        if (twin + ((size_t)1 << k) > buddy->heap_size ||
+            buddy->orders[twin >> BUDDY_MIN_ORDER] != (BUDDY_FREE | k)) {
+            return NULL;
+        }
+    }
+    for (int k = order; k < new_order; k++) {
+        remove_free(buddy, (buddy_block_t*)(buddy->heap + offset + ((size_t)1 << k)), k);
+    }
+    mark_used(buddy, ptr, new_order, ((size_t)1 << new_order) - ((size_t)1 << order));
+    return ptr;
+}
+
+size_t buddy_usable_size(allocator_t* alloc, void* ptr) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    return (size_t)1 << (buddy->orders[unit_of(buddy, ptr)] & BUDDY_ORDER_MASK);
+}
+
+bool buddy_owns(allocator_t* alloc, void* ptr) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    return (char*)ptr >= buddy->heap && (char*)ptr < buddy->heap + buddy->heap_size;
+}
+
+size_t buddy_large_threshold(allocator_t* alloc) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    size_t threshold = buddy->heap_size / 8;
+    if (threshold < BUDDY_MIN_BLOCK) {
+        threshold = BUDDY_MIN_BLOCK;
+    }
+    return threshold < BUDDY_MAX_BLOCK ? threshold : BUDDY_MAX_BLOCK;
+}
+
+size_t buddy_trim(allocator_t* alloc) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    size_t released = 0;
+    for (int order = BUDDY_MAX_ORDER; order > 12; order--) {
+        size_t size = (size_t)1 << order;
+        for (buddy_block_t* block = buddy->free_lists[order]; block; block = block->next) {
+            released += allocator_release_pages((char*)block + BUDDY_PAGE_SIZE, size - BUDDY_PAGE_SIZE);
+        }
+    }
+    return released;
+}
+
+void buddy_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+
+    stats->heap_size = buddy->heap_size;
+    stats->free_bytes = buddy->free_bytes;
+    stats->free_blocks = buddy->free_blocks;
+    stats->largest_free_block = buddy->free_mask ? (size_t)1 << (63 - __builtin_clzll(buddy->free_mask)) : 0;
+    stats->peak_allocated = buddy->peak_used;
+}
+
+void buddy_reset_peak(allocator_t* alloc) {
+    buddy_allocator_t* buddy = (buddy_allocator_t*)alloc;
+    buddy->peak_used = buddy->used;
+}
@@ -0,0 +1,239 @@
+#include "../include/large_object.h"
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct large_header {
+    struct large_header* next; // список живых объектов
+    struct large_header* prev;
+    size_t map_size; // размер всего отображения вместе с заголовком
+    size_t offset; // от начала отображения до заголовка (ради выравнивания данных)
+} large_header_t;
+
+#define LARGE_HEADER_SIZE sizeof(large_header_t)
+
+static size_t page_round(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+// начало данных: сразу за заголовком или на первой границе alignment за ним
+static size_t data_offset(size_t alignment) {
+    return (LARGE_HEADER_SIZE + alignment - 1) & ~(alignment - 1);
+}
+
+static inline large_header_t* header_of(void* ptr) {
+    return (large_header_t*)((char*)ptr - LARGE_HEADER_SIZE);
+}
+
+static inline void* map_base(large_header_t* header) {
+    return (char*)header - header->offset;
+}
+
+static void live_push(large_object_space_t* space, large_header_t* header) {
+    header->prev = NULL;
+    header->next = space->live;
+    if (space->live) {
+        space->live->prev = header;
+    }
+    space->live = header;
+}
+
+static void live_unlink(large_object_space_t* space, large_header_t* header) {
+    if (header->prev) {
+        header->prev->next = header->next;
+    } else {
+        space->live = header->next;
+    }
+    if (header->next) {
+        header->next->prev = header->prev;
+    }
+}
+
+// лучшее подходящее отображение из кэша: не меньше нужного
+// и не больше чем вдвое, чтобы не раздувать потребление
+static void* cache_take(large_object_space_t* space, size_t map_size, size_t* taken_size) {
+    size_t best = space->cache_count;
+    for (size_t i = 0; i < space->cache_count; i++) {
+        size_t slot_size = space->cache[i].map_size;
+        if (slot_size >= map_size && slot_size / 2 <= map_size &&
+            (best == space->cache_count || slot_size < space->cache[best].map_size)) {
+            best = i;
+        }
+    }
+    if (best == space->cache_count) {
+        return NULL;
+    }
+
+    void* base = space->cache[best].base;
+    *taken_size = space->cache[best].map_size;
+    space->cache_bytes -= *taken_size;
+    space->cache_count--;
+    memmove(&space->cache[best], &space->cache[best + 1],
+            (space->cache_count - best) * sizeof(large_cache_slot_t));
+    return base;
+}
+
+// кладёт отображение в кэш, вытесняя самые старые;
+// возвращает отображения, которые нужно снять (не больше LARGE_CACHE_SLOTS)
+static size_t cache_put(large_object_space_t* space, void* base, size_t map_size,
+                        large_cache_slot_t* evicted) {
+    size_t num_evicted = 0;
+    if (map_size > LARGE_CACHE_MAX_BYTES / 2) {
+        evicted[num_evicted++] = (large_cache_slot_t){ map_size, base };
+        return num_evicted;
+    }
+
+    while (space->cache_count == LARGE_CACHE_SLOTS ||
+           space->cache_bytes + map_size > LARGE_CACHE_MAX_BYTES) {
+        evicted[num_evicted++] = space->cache[0];
+        space->cache_bytes -= space->cache[0].map_size;
+        space->cache_count--;
+        memmove(&space->cache[0], &space->cache[1],
+                space->cache_count * sizeof(large_cache_slot_t));
+    }
+    space->cache[space->cache_count++] = (large_cache_slot_t){ map_size, base };
+    space->cache_bytes += map_size;
+    return num_evicted;
+}
+
+void large_object_init(large_object_space_t* space) {
+    memset(space, 0, sizeof(*space));
+    pthread_mutex_init(&space->lock, NULL);
+}
+
+void large_object_destroy(large_object_space_t* space) {
+    large_object_trim(space);
+
+    large_header_t* header = space->live;
+    while (header) {
+        large_header_t* next = header->next;
+        munmap(map_base(header), header->map_size);
+        header = next;
+    }
+    space->live = NULL;
+    pthread_mutex_destroy(&space->lock);
+}
+
+void* large_object_alloc(large_object_space_t* space, size_t size) {
+    return large_object_alloc_aligned(space, size, LARGE_HEADER_SIZE);
+}
+
+void* large_object_alloc_aligned(large_object_space_t* space, size_t size, size_t alignment) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (alignment > page || size > SIZE_MAX - 2 * page) {
+        return NULL;
+    }
+    size_t offset = data_offset(alignment);
+    size_t map_size = page_round(size + offset);
+
+    pthread_mutex_lock(&space->lock);
+    size_t taken_size = 0;
+    void* base = cache_take(space, map_size, &taken_size);
+    pthread_mutex_unlock(&space->lock);
+
+    if (base) {
+        map_size = taken_size;
+    } else {
+        // системный вызов - вне блокировки
+        base = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+    }
+
+    void* data = (char*)base + offset;
+    large_header_t* header = header_of(data);
+    header->map_size = map_size;
+    header->offset = offset - LARGE_HEADER_SIZE;
+
+    pthread_mutex_lock(&space->lock);
+    live_push(space, header);
+    pthread_mutex_unlock(&space->lock);
+
+    return data;
+}
+
+void large_object_free(large_object_space_t* space, void* ptr) {
+    large_header_t* header = header_of(ptr);
+    large_cache_slot_t evicted[LARGE_CACHE_SLOTS + 1];
+
+    pthread_mutex_lock(&space->lock);
+    live_unlink(space, header);
+    size_t num_evicted = cache_put(space, map_base(header), header->map_size, evicted);
+    pthread_mutex_unlock(&space->lock);
+
+    for (size_t i = 0; i < num_evicted; i++) {
+        munmap(evicted[i].base, evicted[i].map_size);
+    }
+}
+
+void* large_object_realloc(large_object_space_t* space, void* ptr, size_t new_size) {
+    if (new_size > SIZE_MAX - 2 * (size_t)sysconf(_SC_PAGESIZE)) {
+        return NULL;
+    }
+    // сдвиг данных от начала отображения сохраняется, как и их выравнивание
+    large_header_t* header = header_of(ptr);
+    size_t offset = header->offset + LARGE_HEADER_SIZE;
+    size_t map_size = page_round(new_size + offset);
+    if (map_size == header->map_size) {
+        return ptr;
+    }
+
+    // отображение может переехать: на время mremap убираем его из списка
+    pthread_mutex_lock(&space->lock);
+    live_unlink(space, header);
+    pthread_mutex_unlock(&space->lock);
+
+    void* base = mremap(map_base(header), header->map_size, map_size, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) {
+        pthread_mutex_lock(&space->lock);
+        live_push(space, header);
+        pthread_mutex_unlock(&space->lock);
+        return NULL;
+    }
+
+    void* data = (char*)base + offset;
+    header = header_of(data);
+    header->map_size = map_size;
+
+    pthread_mutex_lock(&space->lock);
+    live_push(space, header);
+    pthread_mutex_unlock(&space->lock);
+
+    return data;
+}
+
+size_t large_object_usable_size(void* ptr) {
+    large_header_t* header = header_of(ptr);
+    return header->map_size - header->offset - LARGE_HEADER_SIZE;
+}
+
+size_t large_object_mapped(large_object_space_t* space) {
+    pthread_mutex_lock(&space->lock);
+    size_t bytes = space->cache_bytes;
+    for (large_header_t* header = space->live; header; header = header->next) {
+        bytes += header->map_size;
+    }
+    pthread_mutex_unlock(&space->lock);
+    return bytes;
+}
+
+size_t large_object_trim(large_object_space_t* space) {
+    large_cache_slot_t cache[LARGE_CACHE_SLOTS];
+
+    pthread_mutex_lock(&space->lock);
+    size_t count = space->cache_count;
+    size_t bytes = space->cache_bytes;
+    memcpy(cache, space->cache, count * sizeof(large_cache_slot_t));
+    space->cache_count = 0;
+    space->cache_bytes = 0;
+    pthread_mutex_unlock(&space->lock);
+
+    for (size_t i = 0; i < count; i++) {
+        munmap(cache[i].base, cache[i].map_size);
+    }
+    return bytes;
+}
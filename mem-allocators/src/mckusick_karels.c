@@ -1,159 +1,282 @@
 #include "../include/mckusick_karels.h"
-#include "../include/allocator.h"
+#include "../include/allocator_internal.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 
-#define NUM_BUCKETS 8
+#define NUM_BUCKETS NUM_SIZE_CLASSES
+#define MAX_OBJECTS_PER_PAGE (PAGE_SIZE / MIN_BUCKET_SIZE)
+#define BITMAP_WORDS ((MAX_OBJECTS_PER_PAGE + 63) / 64)
+// частичные страницы корзины раскладываются по четвертям заполненности,
+// за ними идут списки полных и полностью пустых страниц
+#define FULLNESS_BINS 4
+#define PAGE_LIST_FULL FULLNESS_BINS
+#define PAGE_LIST_EMPTY (FULLNESS_BINS + 1)
+#define NUM_PAGE_LISTS (FULLNESS_BINS + 2)
 
-// page
+// page descriptor (kmemusage): лежит в плотном массиве mk_alloc->pages,
+// индекс дескриптора = (адрес - heap) / PAGE_SIZE
 typedef struct page {
-    struct page* next;
-    size_t bucket_size; // size of objects in this page
-    unsigned char* free_bitmap; // bitmap of free objects
+    struct page* next; // двусвязный список buckets[bucket_idx][list]
+    struct page* prev;
+    int list; // в каком списке корзины стоит страница
+    size_t bucket_size; // size of objects in this page, 0 - page is unused
+    int bucket_idx; // index in buckets[]
+    uint64_t free_bitmap[BITMAP_WORDS]; // bitmap of free objects, 1 - free
+    size_t free_hint; // слова до free_hint не содержат свободных объектов
     size_t num_objects; // number of objects per page
     size_t free_count; // number of free objects
     void* data; // pointer to page data
+    // освобождения из чужих потоков: отдельная кэш-линия,
+    // чтобы не было ложного разделения с free_bitmap/free_count
+    char pad[64];
+    void* remote_free; // MPSC-стек объектов, связь через их данные
+    struct page* remote_next; // в списке mk_alloc->remote_pages
+    int remote_queued; // страница уже стоит в remote_pages
 } page_t;
 
-// header of block
+// Заголовков у объектов нет: страница и корзина находятся по адресу
+// через таблицу дескрипторов, индекс объекта - по смещению в странице
 typedef struct {
-    page_t* page; // what page  
-    size_t object_index; // object index
-    size_t magic; // != MK_BLOCK_MAGIC
-} mk_block_header_t;
-
-#define MK_BLOCK_MAGIC 0xBEEFCAFE // sub for control
-#define MK_ALIGN_SIZE 8 // 8 byte
-#define MK_HEADER_SIZE sizeof(mk_block_header_t) // for calculate address
-
-
-typedef struct {
-    allocator_type_t type;
-    void* heap; // указатель на сырой кусок памяти
+    allocator_t base;
+    void* heap; // указатель на сырой кусок памяти (выровнен по PAGE_SIZE)
     size_t heap_size; // размер этого куска
-    page_t* buckets[NUM_BUCKETS];  
-    page_t* full_pages;         
-    size_t bucket_sizes[NUM_BUCKETS]; // могут быть разные
+    page_t* pages; // дескрипторы страниц кучи
+    size_t num_pages; // heap_size / PAGE_SIZE
+    size_t pages_used; // страницы [0, pages_used) уже нарезаны
+    page_t* buckets[NUM_BUCKETS][NUM_PAGE_LISTS];
+    size_t empty_pages[NUM_BUCKETS]; // длина списка PAGE_LIST_EMPTY корзины
+    size_t page_reserve; // сколько пустых страниц корзина держит у себя
+    page_t* free_pages; // возвращённые ОС страницы, готовые к повторному использованию
+    size_t pages_released; // сколько страниц сейчас отдано ОС
+    size_t bucket_sizes[NUM_BUCKETS]; // копия общей таблицы SIZE_CLASSES
+    page_t* remote_pages; // страницы с непустым remote_free (атомарно)
     allocator_stats_t stats;
 } mckusick_karels_allocator_t;
 
 static void init_bucket_sizes(size_t* bucket_sizes) {
-    bucket_sizes[0] = 16;
-    bucket_sizes[1] = 32;
-    bucket_sizes[2] = 64;
-    bucket_sizes[3] = 128;
-    bucket_sizes[4] = 256;
-    bucket_sizes[5] = 512;
-    bucket_sizes[6] = 1024;
-    bucket_sizes[7] = 2048;
-}
-
-static int get_bucket_index(size_t size, const size_t* bucket_sizes) {
     for (int i = 0; i < NUM_BUCKETS; i++) {
-        if (size <= bucket_sizes[i]) {
-            return i;
-        }
+        bucket_sizes[i] = SIZE_CLASSES[i];
     }
-    return -1;  
 }
 
-static size_t mk_align_size(size_t size) {
-    // округляем до 8 кратного числа
-    // ~ обнуляет первые три бита
-    return (size + MK_ALIGN_SIZE - 1) & ~(MK_ALIGN_SIZE - 1);
+// корзины совпадают с общей таблицей классов, поэтому индекс - за O(1)
+static inline int get_bucket_index(size_t size, const size_t* bucket_sizes) {
+    (void)bucket_sizes;
+    return size_class_index(size);
 }
 
-static page_t* create_page(size_t bucket_size, void* heap_start, void* heap_end) {
-    size_t page_desc_size = sizeof(page_t);
-    size_t object_size = bucket_size + MK_HEADER_SIZE;
-    size_t num_objects = (PAGE_SIZE - page_desc_size) / object_size;
-    
-    if (num_objects == 0) {
-        num_objects = 1;
-    }
-    
-    size_t bitmap_size = (num_objects + 7) / 8;
-    size_t total_size = page_desc_size + bitmap_size + num_objects * object_size;
-    
-    page_t* page = (page_t*)malloc(sizeof(page_t));
-    if (!page) return NULL;
-    
-    page->data = malloc(num_objects * object_size);
-    if (!page->data) {
-        free(page);
+// берёт страницу, ранее возвращённую ОС, или отрезает следующую страницу кучи
+static page_t* create_page(mckusick_karels_allocator_t* mk_alloc, int bucket_idx) {
+    page_t* page = mk_alloc->free_pages;
+    size_t page_idx;
+    if (page) {
+        mk_alloc->free_pages = page->next;
+        mk_alloc->pages_released--;
+        page_idx = page - mk_alloc->pages;
+    } else if (mk_alloc->pages_used < mk_alloc->num_pages) {
+        // page_of читает pages_used без блокировки
+        page_idx = mk_alloc->pages_used;
+        __atomic_store_n(&mk_alloc->pages_used, page_idx + 1, __ATOMIC_RELAXED);
+        page = &mk_alloc->pages[page_idx];
+    } else {
         return NULL;
     }
     
-    page->free_bitmap = (unsigned char*)malloc(bitmap_size);
-    if (!page->free_bitmap) {
-        free(page->data);
-        free(page);
-        return NULL;
-    }
+    size_t bucket_size = mk_alloc->bucket_sizes[bucket_idx];
+    size_t num_objects = PAGE_SIZE / bucket_size;
     
+    page->data = (char*)mk_alloc->heap + page_idx * PAGE_SIZE;
     page->bucket_size = bucket_size;
+    page->bucket_idx = bucket_idx;
     page->num_objects = num_objects;
     page->free_count = num_objects;
     page->next = NULL;
+    page->prev = NULL;
+    page->list = -1;
+    // remote_* не трогаем: пустая страница может ещё стоять в remote_pages
+    // (её remote_free пуст), и сброс remote_queued поставил бы её туда дважды
+    
+    memset(page->free_bitmap, 0, sizeof(page->free_bitmap));
+    for (size_t i = 0; i < num_objects / 64; i++) {
+        page->free_bitmap[i] = ~(uint64_t)0;
+    }
+    if (num_objects % 64) {
+        page->free_bitmap[num_objects / 64] = ((uint64_t)1 << (num_objects % 64)) - 1;
+    }
+    page->free_hint = 0;
     
-    memset(page->free_bitmap, 0xFF, bitmap_size);
+    return page;
+}
+
+// страница, которой принадлежит указатель, или NULL для чужого указателя
+static page_t* page_of(mckusick_karels_allocator_t* mk_alloc, void* ptr) {
+    size_t offset = (size_t)((char*)ptr - (char*)mk_alloc->heap);
+    size_t pages_used = __atomic_load_n(&mk_alloc->pages_used, __ATOMIC_RELAXED);
+    if ((char*)ptr < (char*)mk_alloc->heap || offset >= pages_used * PAGE_SIZE) {
+        return NULL;
+    }
     
+    page_t* page = &mk_alloc->pages[offset >> PAGE_SHIFT];
+    if (page->bucket_size == 0 || (offset & (PAGE_SIZE - 1)) % page->bucket_size != 0) {
+        return NULL;
+    }
     return page;
 }
 
-// ищет первый свободный слот
+static inline int object_index(page_t* page, void* ptr) {
+    return (int)(((char*)ptr - (char*)page->data) / page->bucket_size);
+}
+
+static int page_list_of(page_t* page) {
+    if (page->free_count == 0) {
+        return PAGE_LIST_FULL;
+    }
+    if (page->free_count == page->num_objects) {
+        return PAGE_LIST_EMPTY;
+    }
+    return (int)((page->num_objects - page->free_count) * FULLNESS_BINS / page->num_objects);
+}
+
+static void page_unlink(mckusick_karels_allocator_t* mk_alloc, page_t* page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        mk_alloc->buckets[page->bucket_idx][page->list] = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    if (page->list == PAGE_LIST_EMPTY) {
+        mk_alloc->empty_pages[page->bucket_idx]--;
+    }
+}
+
+static void page_push(mckusick_karels_allocator_t* mk_alloc, page_t* page, int list) {
+    page_t** head = &mk_alloc->buckets[page->bucket_idx][list];
+    page->list = list;
+    page->prev = NULL;
+    page->next = *head;
+    if (*head) {
+        (*head)->prev = page;
+    }
+    *head = page;
+    if (list == PAGE_LIST_EMPTY) {
+        mk_alloc->empty_pages[page->bucket_idx]++;
+    }
+}
+
+// переносит страницу в список, соответствующий её заполненности, за O(1)
+static void page_update(mckusick_karels_allocator_t* mk_alloc, page_t* page) {
+    int list = page_list_of(page);
+    if (list != page->list) {
+        page_unlink(mk_alloc, page);
+        page_push(mk_alloc, page, list);
+    }
+}
+
+// самая заполненная частичная страница корзины: держит рабочий набор плотным;
+// пустые страницы из резерва - в последнюю очередь
+static page_t* find_partial_page(mckusick_karels_allocator_t* mk_alloc, int bucket_idx) {
+    for (int list = FULLNESS_BINS - 1; list >= 0; list--) {
+        if (mk_alloc->buckets[bucket_idx][list]) {
+            return mk_alloc->buckets[bucket_idx][list];
+        }
+    }
+    return mk_alloc->buckets[bucket_idx][PAGE_LIST_EMPTY];
+}
+
+// отдаёт пустую страницу ОС: физическая память освобождается,
+// адрес и дескриптор остаются за аллокатором до повторного использования
+static void release_page(mckusick_karels_allocator_t* mk_alloc, page_t* page) {
+    page_unlink(mk_alloc, page);
+    madvise(page->data, PAGE_SIZE, MADV_DONTNEED);
+    
+    page->bucket_size = 0;
+    page->list = -1;
+    page->next = mk_alloc->free_pages;
+    mk_alloc->free_pages = page;
+    mk_alloc->pages_released++;
+}
+
+// оставляет в корзине не больше keep пустых страниц
+static size_t trim_bucket(mckusick_karels_allocator_t* mk_alloc, int bucket_idx, size_t keep) {
+    size_t released = 0;
+    while (mk_alloc->empty_pages[bucket_idx] > keep) {
+        release_page(mk_alloc, mk_alloc->buckets[bucket_idx][PAGE_LIST_EMPTY]);
+        released++;
+    }
+    return released;
+}
+
+// ищет первый свободный слот: по слову за шаг, начиная с подсказки
 static int find_free_object(page_t* page) {
-    size_t bitmap_size = (page->num_objects + 7) / 8;
+    size_t words = (page->num_objects + 63) / 64;
     
-    for (size_t i = 0; i < page->num_objects; i++) {
-        size_t byte_idx = i / 8;
-        size_t bit_idx = i % 8;
-        
-        // 1 - free
-        // 0 - not free
-        if (page->free_bitmap[byte_idx] & (1 << bit_idx)) {
-            return i;
+    for (size_t w = page->free_hint; w < words; w++) {
+        uint64_t bits = page->free_bitmap[w];
+        if (bits) {
+            page->free_hint = w;
+            return (int)(w * 64 + __builtin_ctzll(bits));
         }
     }
     
+    page->free_hint = words;
     return -1;
 }
 
 static void mark_allocated(page_t* page, int obj_idx) {
-    size_t byte_idx = obj_idx / 8;
-    size_t bit_idx = obj_idx % 8;
-    page->free_bitmap[byte_idx] &= ~(1 << bit_idx);
+    page->free_bitmap[obj_idx / 64] &= ~((uint64_t)1 << (obj_idx % 64));
     page->free_count--;
 }
 
 static void mark_free(page_t* page, int obj_idx) {
-    size_t byte_idx = obj_idx / 8;
-    size_t bit_idx = obj_idx % 8;
-    page->free_bitmap[byte_idx] |= (1 << bit_idx);
+    size_t word = obj_idx / 64;
+    page->free_bitmap[word] |= (uint64_t)1 << (obj_idx % 64);
     page->free_count++;
+    if (word < page->free_hint) {
+        page->free_hint = word;
+    }
 }
 
 allocator_t* mckusick_karels_create(size_t heap_size) {
-    mckusick_karels_allocator_t* alloc = malloc(sizeof(mckusick_karels_allocator_t));
+    if (heap_size / PAGE_SIZE == 0) {
+        return NULL;
+    }
+    mckusick_karels_allocator_t* alloc = allocator_map(sizeof(mckusick_karels_allocator_t), 0);
     if (!alloc) {
         return NULL;
     }
     
-    alloc->type = ALLOCATOR_MCKUSICK_KARELS;
-    alloc->heap_size = heap_size;
-    alloc->heap = malloc(heap_size);
+    alloc->base.type = ALLOCATOR_MCKUSICK_KARELS;
+    alloc->num_pages = heap_size / PAGE_SIZE;
+    alloc->heap_size = alloc->num_pages * PAGE_SIZE;
+    alloc->pages_used = 0;
+    
+    // выровненная по странице память, которую ОС выделяет лениво
+    alloc->heap = allocator_map(alloc->heap_size, PAGE_SIZE);
     if (!alloc->heap) {
-        free(alloc);
+        allocator_unmap(alloc, sizeof(mckusick_karels_allocator_t));
+        return NULL;
+    }
+    
+    alloc->pages = allocator_map(alloc->num_pages * sizeof(page_t), 0);
+    if (!alloc->pages) {
+        allocator_unmap(alloc->heap, alloc->heap_size);
+        allocator_unmap(alloc, sizeof(mckusick_karels_allocator_t));
         return NULL;
     }
     
     init_bucket_sizes(alloc->bucket_sizes);
     
-    for (int i = 0; i < NUM_BUCKETS; i++) {
-        alloc->buckets[i] = NULL;
-    }
-    alloc->full_pages = NULL;
+    memset(alloc->buckets, 0, sizeof(alloc->buckets));
+    memset(alloc->empty_pages, 0, sizeof(alloc->empty_pages));
+    alloc->page_reserve = MK_PAGE_RESERVE;
+    alloc->free_pages = NULL;
+    alloc->pages_released = 0;
+    alloc->remote_pages = NULL;
     
     memset(&alloc->stats, 0, sizeof(allocator_stats_t));
     
@@ -165,31 +288,28 @@ void mckusick_karels_destroy(allocator_t* alloc) {
     
     mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
     
-    for (int i = 0; i < NUM_BUCKETS; i++) {
-        page_t* curr = mk_alloc->buckets[i];
-        while (curr) {
-            page_t* next = curr->next;
-            free(curr->free_bitmap);
-            free(curr->data);
-            free(curr);
-            curr = next;
-        }
+    allocator_unmap(mk_alloc->pages, mk_alloc->num_pages * sizeof(page_t));
+    allocator_unmap(mk_alloc->heap, mk_alloc->heap_size);
+    allocator_unmap(mk_alloc, sizeof(mckusick_karels_allocator_t));
+}
+
+// summary
+// страница корзины со свободными объектами: частичная, после сбора
+// чужих освобождений или новая
+static page_t* page_for_bucket(mckusick_karels_allocator_t* mk_alloc, int bucket_idx) {
+    page_t* page = find_partial_page(mk_alloc, bucket_idx);
+    if (!page && mckusick_karels_drain_remote(&mk_alloc->base) > 0) {
+        page = find_partial_page(mk_alloc, bucket_idx);
     }
-    
-    page_t* curr = mk_alloc->full_pages;
-    while (curr) {
-        page_t* next = curr->next;
-        free(curr->free_bitmap);
-        free(curr->data);
-        free(curr);
-        curr = next;
+    if (!page) {
+        page = create_page(mk_alloc, bucket_idx);
+        if (page) {
+            page_push(mk_alloc, page, page_list_of(page));
+        }
     }
-    
-    free(mk_alloc->heap);
-    free(mk_alloc);
+    return page;
 }
 
-// summary
 void* mckusick_karels_alloc(allocator_t* alloc, size_t size) {
     if (!alloc || size == 0) {
         return NULL;
@@ -203,19 +323,10 @@ void* mckusick_karels_alloc(allocator_t* alloc, size_t size) {
         return NULL;
     }
     
-    size_t bucket_size = mk_alloc->bucket_sizes[bucket_idx];
-    
-    page_t* page = mk_alloc->buckets[bucket_idx];
-    if (!page || page->free_count == 0) {
-        page = create_page(bucket_size, mk_alloc->heap, 
-                          (char*)mk_alloc->heap + mk_alloc->heap_size);
-        if (!page) {
-            mk_alloc->stats.failed_allocations++;
-            return NULL;
-        }
-        
-        page->next = mk_alloc->buckets[bucket_idx];
-        mk_alloc->buckets[bucket_idx] = page;
+    page_t* page = page_for_bucket(mk_alloc, bucket_idx);
+    if (!page) {
+        mk_alloc->stats.failed_allocations++;
+        return NULL;
     }
     
     int obj_idx = find_free_object(page);
@@ -226,27 +337,78 @@ void* mckusick_karels_alloc(allocator_t* alloc, size_t size) {
     
     mark_allocated(page, obj_idx);
     
-    size_t object_size = bucket_size + MK_HEADER_SIZE;
-    void* obj_ptr = (char*)page->data + obj_idx * object_size;
-    
-    mk_block_header_t* header = (mk_block_header_t*)obj_ptr;
-    header->page = page;
-    header->object_index = obj_idx;
-    header->magic = MK_BLOCK_MAGIC;
+    void* obj_ptr = (char*)page->data + obj_idx * page->bucket_size;
     
     mk_alloc->stats.total_allocations++;
-    mk_alloc->stats.current_allocated += bucket_size;
+    mk_alloc->stats.current_allocated += page->bucket_size;
     if (mk_alloc->stats.current_allocated > mk_alloc->stats.peak_allocated) {
         mk_alloc->stats.peak_allocated = mk_alloc->stats.current_allocated;
     }
     
-    if (page->free_count == 0) {
-        mk_alloc->buckets[bucket_idx] = page->next;
-        page->next = mk_alloc->full_pages;
-        mk_alloc->full_pages = page;
+    page_update(mk_alloc, page);
+    
+    return obj_ptr;
+}
+
+// Пачка объектов одной корзины: свободные слоты забираются целыми
+// словами битовой карты, страница переставляется в списках один раз
+size_t mckusick_karels_alloc_batch(allocator_t* alloc, int bucket_idx, void** ptrs, size_t count) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t filled = 0;
+    
+    while (filled < count) {
+        page_t* page = page_for_bucket(mk_alloc, bucket_idx);
+        if (!page) {
+            mk_alloc->stats.failed_allocations++;
+            break;
+        }
+        
+        size_t words = (page->num_objects + 63) / 64;
+        size_t taken = 0;
+        size_t w = page->free_hint;
+        while (w < words && filled < count) {
+            uint64_t bits = page->free_bitmap[w];
+            while (bits && filled < count) {
+                size_t obj_idx = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                ptrs[filled++] = (char*)page->data + obj_idx * page->bucket_size;
+                taken++;
+            }
+            page->free_bitmap[w] = bits;
+            if (bits) break;
+            w++;
+        }
+        page->free_hint = w;
+        page->free_count -= taken;
+        
+        mk_alloc->stats.total_allocations += taken;
+        mk_alloc->stats.current_allocated += taken * page->bucket_size;
+        page_update(mk_alloc, page);
+    }
+    
+    if (mk_alloc->stats.current_allocated > mk_alloc->stats.peak_allocated) {
+        mk_alloc->stats.peak_allocated = mk_alloc->stats.current_allocated;
     }
+    return filled;
+}
+
+// возвращает объект в страницу; вызывается только владельцем (под lock)
+static void release_object(mckusick_karels_allocator_t* mk_alloc, page_t* page, int obj_idx) {
+    mark_free(page, obj_idx);
     
-    return (char*)obj_ptr + MK_HEADER_SIZE;
+    mk_alloc->stats.total_frees++;
+    mk_alloc->stats.current_allocated -= page->bucket_size;
+    
+    page_update(mk_alloc, page);
+    
+    // гистерезис: пустые страницы копятся до 2 * page_reserve и только
+    // потом отдаются ОС до page_reserve, чтобы пульсирующая нагрузка
+    // не вызывала madvise на каждом освобождении
+    int bucket_idx = page->bucket_idx;
+    if (page->list == PAGE_LIST_EMPTY &&
+        mk_alloc->empty_pages[bucket_idx] > 2 * mk_alloc->page_reserve) {
+        trim_bucket(mk_alloc, bucket_idx, mk_alloc->page_reserve);
+    }
 }
 
 void mckusick_karels_free(allocator_t* alloc, void* ptr) {
@@ -255,35 +417,178 @@ void mckusick_karels_free(allocator_t* alloc, void* ptr) {
     }
     
     mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
-    mk_block_header_t* header = (mk_block_header_t*)((char*)ptr - MK_HEADER_SIZE);
+    page_t* page = page_of(mk_alloc, ptr);
     
-    if (header->magic != MK_BLOCK_MAGIC) {
+    if (!page) {
         fprintf(stderr, "Error: Invalid pointer or corrupted block\n");
         return;
     }
     
-    page_t* page = header->page;
-    int obj_idx = header->object_index;
+    release_object(mk_alloc, page, object_index(page, ptr));
+}
+
+// Освобождение без блокировки из любого потока: объект кладётся
+// в MPSC-стек своей страницы, а страница (один раз) - в remote_pages.
+// Владелец забирает их пачкой в mckusick_karels_drain_remote().
+void mckusick_karels_free_remote(allocator_t* alloc, void* ptr) {
+    if (!alloc || !ptr) {
+        return;
+    }
+    mckusick_karels_free_remote_batch(alloc, &ptr, 1);
+}
+
+// Пачка освобождений без блокировки: подряд идущие объекты одной страницы
+// связываются в цепочку и кладутся в её remote_free одним CAS
+void mckusick_karels_free_remote_batch(allocator_t* alloc, void** ptrs, size_t count) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t i = 0;
     
-    if (page->free_count == 0) {
-        page_t** prev_ptr = &mk_alloc->full_pages;
-        page_t* curr = mk_alloc->full_pages;
-        while (curr) {
-            if (curr == page) {
-                *prev_ptr = curr->next;
-                break;
-            }
-            prev_ptr = &curr->next;
-            curr = curr->next;
+    while (i < count) {
+        page_t* page = page_of(mk_alloc, ptrs[i]);
+        if (!page) {
+            fprintf(stderr, "Error: Invalid pointer or corrupted block\n");
+            i++;
+            continue;
         }
         
-        int bucket_idx = get_bucket_index(page->bucket_size, mk_alloc->bucket_sizes);
-        page->next = mk_alloc->buckets[bucket_idx];
-        mk_alloc->buckets[bucket_idx] = page;
+        void* first = ptrs[i];
+        void* last = first;
+        for (i++; i < count && (size_t)((char*)ptrs[i] - (char*)page->data) < PAGE_SIZE; i++) {
+            *(void**)last = ptrs[i];
+            last = ptrs[i];
+        }
+        
+        void* head = __atomic_load_n(&page->remote_free, __ATOMIC_RELAXED);
+        do {
+            *(void**)last = head;
+        } while (!__atomic_compare_exchange_n(&page->remote_free, &head, first, true,
+                                              __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+        
+        if (__atomic_exchange_n(&page->remote_queued, 1, __ATOMIC_SEQ_CST) == 0) {
+            page_t* pages = __atomic_load_n(&mk_alloc->remote_pages, __ATOMIC_RELAXED);
+            do {
+                page->remote_next = pages;
+            } while (!__atomic_compare_exchange_n(&mk_alloc->remote_pages, &pages, page, true,
+                                                  __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        }
     }
+}
+
+size_t mckusick_karels_drain_remote(allocator_t* alloc) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t drained = 0;
     
-    mark_free(page, obj_idx);
+    if (!__atomic_load_n(&mk_alloc->remote_pages, __ATOMIC_RELAXED)) {
+        return 0;
+    }
     
-    mk_alloc->stats.total_frees++;
-    mk_alloc->stats.current_allocated -= page->bucket_size;
+    // забираем весь список сразу, поэтому ABA невозможна
+    page_t* page = __atomic_exchange_n(&mk_alloc->remote_pages, NULL, __ATOMIC_ACQUIRE);
+    while (page) {
+        page_t* next = page->remote_next;
+        
+        // сначала снимаем флаг, потом забираем объекты: объект,
+        // пришедший после обмена, снова поставит страницу в очередь
+        __atomic_store_n(&page->remote_queued, 0, __ATOMIC_SEQ_CST);
+        void* obj = __atomic_exchange_n(&page->remote_free, NULL, __ATOMIC_SEQ_CST);
+        
+        while (obj) {
+            void* obj_next = *(void**)obj;
+            release_object(mk_alloc, page, object_index(page, obj));
+            drained++;
+            obj = obj_next;
+        }
+        
+        page = next;
+    }
+    
+    return drained;
+}
+
+void mckusick_karels_set_page_reserve(allocator_t* alloc, size_t pages) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    mk_alloc->page_reserve = pages;
+}
+
+size_t mckusick_karels_trim(allocator_t* alloc) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t released = 0;
+    
+    mckusick_karels_drain_remote(alloc);
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        released += trim_bucket(mk_alloc, i, 0);
+    }
+    return released * PAGE_SIZE;
+}
+
+int mckusick_karels_class_of(allocator_t* alloc, size_t size) {
+    if (size == 0) {
+        return -1;
+    }
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    return get_bucket_index(size, mk_alloc->bucket_sizes);
+}
+
+size_t mckusick_karels_class_size(allocator_t* alloc, int class_idx) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    return mk_alloc->bucket_sizes[class_idx];
+}
+
+// объекты лежат с шагом bucket_size от начала страницы
+size_t mckusick_karels_class_align(allocator_t* alloc, int class_idx) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t size = mk_alloc->bucket_sizes[class_idx];
+    return size & -size;
+}
+
+int mckusick_karels_class_of_ptr(allocator_t* alloc, void* ptr) {
+    page_t* page = page_of((mckusick_karels_allocator_t*)alloc, ptr);
+    return page ? page->bucket_idx : -1;
+}
+
+size_t mckusick_karels_usable_size(allocator_t* alloc, void* ptr) {
+    page_t* page = page_of((mckusick_karels_allocator_t*)alloc, ptr);
+    return page ? page->bucket_size : 0;
+}
+
+bool mckusick_karels_owns(allocator_t* alloc, void* ptr) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    return (char*)ptr >= (char*)mk_alloc->heap &&
+           (char*)ptr < (char*)mk_alloc->heap + mk_alloc->heap_size;
+}
+
+// Свободные страницы (пустые, отданные ОС и ещё не нарезанные) считаются
+// блоками по сериям подряд идущих страниц, свободные объекты - поштучно
+void mckusick_karels_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    size_t run = 0, largest_run = 0, largest_object = 0;
+    
+    stats->heap_size = mk_alloc->heap_size;
+    stats->peak_allocated = mk_alloc->stats.peak_allocated;
+    for (size_t i = 0; i <= mk_alloc->num_pages; i++) {
+        page_t* page = i < mk_alloc->pages_used ? &mk_alloc->pages[i] : NULL;
+        bool page_free = i < mk_alloc->num_pages &&
+                         (!page || page->bucket_size == 0 || page->list == PAGE_LIST_EMPTY);
+        if (page_free) {
+            run++;
+            continue;
+        }
+        if (run > 0) {
+            stats->free_blocks++;
+            stats->free_bytes += run * PAGE_SIZE;
+            if (run > largest_run) largest_run = run;
+            run = 0;
+        }
+        if (page && page->free_count > 0) {
+            stats->free_blocks += page->free_count;
+            stats->free_bytes += page->free_count * page->bucket_size;
+            if (page->bucket_size > largest_object) largest_object = page->bucket_size;
+        }
+    }
+    stats->largest_free_block = largest_run > 0 ? largest_run * PAGE_SIZE : largest_object;
+}
+
+void mckusick_karels_reset_peak(allocator_t* alloc) {
+    mckusick_karels_allocator_t* mk_alloc = (mckusick_karels_allocator_t*)alloc;
+    mk_alloc->stats.peak_allocated = mk_alloc->stats.current_allocated;
 }
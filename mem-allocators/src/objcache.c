@@ -0,0 +1,257 @@
+#include "../include/objcache.h"
+#include "../include/allocator_internal.h"
+#include "../include/size_classes.h"
+#include <stdint.h>
+#include <string.h>
+
+#define SLAB_LIST_PARTIAL 0
+#define SLAB_LIST_FULL 1
+#define SLAB_LIST_EMPTY 2
+#define NUM_SLAB_LISTS 3
+
+// Заголовок slab'а. Свободные объекты хранятся стеком индексов в заголовке,
+// а не списком через сами объекты: связь затёрла бы сконструированное
+// состояние. Slab выровнен по своему размеру, заголовок объекта - его адрес,
+// округлённый вниз до slab_size
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    int list;
+    char* data; // первый объект: за заголовком и смещением раскраски
+    size_t free_count;
+    uint16_t free[]; // индексы свободных объектов, вершина - free[free_count - 1]
+} slab_t;
+
+struct objcache {
+    pthread_mutex_t lock;
+    size_t size;
+    size_t stride; // шаг объектов: size, округлённый до align
+    size_t slab_size;
+    size_t num_objects; // объектов в slab'е
+    size_t data_offset; // начало объектов без раскраски
+    size_t color_step;
+    size_t color_max; // наибольшее смещение раскраски
+    size_t color_next; // смещение для следующего slab'а
+    objcache_ctor_t ctor;
+    objcache_dtor_t dtor;
+    slab_t* slabs[NUM_SLAB_LISTS];
+    size_t num_slabs;
+    objcache_stats_t stats; // счётчики операций (под lock)
+};
+
+static inline size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline slab_t* slab_of(objcache_t* cache, void* obj) {
+    return (slab_t*)((uintptr_t)obj & ~(uintptr_t)(cache->slab_size - 1));
+}
+
+// раскладка slab'а размера slab_size: объекты, заголовок со стеком
+// индексов и остаток, который уходит на раскраску
+static bool plan_slab(objcache_t* cache, size_t slab_size, size_t align) {
+    size_t count = (slab_size - sizeof(slab_t)) / (cache->stride + sizeof(uint16_t));
+    if (count > UINT16_MAX + 1) {
+        count = UINT16_MAX + 1;
+    }
+    size_t offset = align_up(sizeof(slab_t) + count * sizeof(uint16_t), align);
+    while (count > 0 && offset + count * cache->stride > slab_size) {
+        count--;
+        offset = align_up(sizeof(slab_t) + count * sizeof(uint16_t), align);
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    cache->slab_size = slab_size;
+    cache->num_objects = count;
+    cache->data_offset = offset;
+    size_t leftover = slab_size - offset - count * cache->stride;
+    cache->color_max = leftover / cache->color_step * cache->color_step;
+    return true;
+}
+
+static void slab_unlink(objcache_t* cache, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->slabs[slab->list] = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+static void slab_push(objcache_t* cache, slab_t* slab, int list) {
+    slab_t** head = &cache->slabs[list];
+    slab->list = list;
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_update(objcache_t* cache, slab_t* slab) {
+    int list = slab->free_count == 0 ? SLAB_LIST_FULL
+             : slab->free_count == cache->num_objects ? SLAB_LIST_EMPTY : SLAB_LIST_PARTIAL;
+    if (list != slab->list) {
+        slab_unlink(cache, slab);
+        slab_push(cache, slab, list);
+    }
+}
+
+// новый slab: все объекты конструируются сразу, смещение раскраски
+// идёт по кругу 0, color_step, ..., color_max
+static slab_t* create_slab(objcache_t* cache) {
+    slab_t* slab = allocator_map(cache->slab_size, cache->slab_size);
+    if (!slab) {
+        return NULL;
+    }
+
+    slab->data = (char*)slab + cache->data_offset + cache->color_next;
+    cache->color_next = cache->color_next + cache->color_step > cache->color_max
+                      ? 0 : cache->color_next + cache->color_step;
+    // индекс 0 на вершине: объекты выдаются по возрастанию адресов
+    slab->free_count = cache->num_objects;
+    for (size_t i = 0; i < cache->num_objects; i++) {
+        slab->free[i] = (uint16_t)(cache->num_objects - 1 - i);
+    }
+    if (cache->ctor) {
+        for (size_t i = 0; i < cache->num_objects; i++) {
+            cache->ctor(slab->data + i * cache->stride);
+        }
+        cache->stats.constructed += cache->num_objects;
+    }
+
+    slab->list = -1;
+    slab_push(cache, slab, SLAB_LIST_EMPTY);
+    cache->num_slabs++;
+    return slab;
+}
+
+static void destroy_slab(objcache_t* cache, slab_t* slab) {
+    slab_unlink(cache, slab);
+    if (cache->dtor) {
+        for (size_t i = 0; i < cache->num_objects; i++) {
+            cache->dtor(slab->data + i * cache->stride);
+        }
+        cache->stats.destructed += cache->num_objects;
+    }
+    cache->num_slabs--;
+    allocator_unmap(slab, cache->slab_size);
+}
+
+objcache_t* objcache_create(size_t size, size_t align, objcache_ctor_t ctor, objcache_dtor_t dtor) {
+    if (align == 0) {
+        align = ALLOCATOR_MIN_ALIGNMENT;
+    }
+    if (size == 0 || size > OBJCACHE_MAX_SLAB || (align & (align - 1)) != 0 ||
+        align > ALLOCATOR_MAX_ALIGNMENT) {
+        return NULL;
+    }
+
+    objcache_t* cache = allocator_map(sizeof(objcache_t), 0);
+    if (!cache) {
+        return NULL;
+    }
+    cache->size = size;
+    cache->stride = align_up(size, align);
+    cache->color_step = align > CACHE_LINE_SIZE ? align : CACHE_LINE_SIZE;
+    cache->ctor = ctor;
+    cache->dtor = dtor;
+
+    // наименьший slab из целых страниц, куда влезает OBJCACHE_MIN_OBJECTS объектов
+    size_t slab_size = 4096;
+    bool planned = plan_slab(cache, slab_size, align);
+    while (slab_size < OBJCACHE_MAX_SLAB &&
+           (!planned || cache->num_objects < OBJCACHE_MIN_OBJECTS)) {
+        slab_size *= 2;
+        planned = plan_slab(cache, slab_size, align);
+    }
+    if (!planned) {
+        allocator_unmap(cache, sizeof(objcache_t));
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void objcache_destroy(objcache_t* cache) {
+    if (!cache) return;
+
+    for (int list = 0; list < NUM_SLAB_LISTS; list++) {
+        while (cache->slabs[list]) {
+            destroy_slab(cache, cache->slabs[list]);
+        }
+    }
+    pthread_mutex_destroy(&cache->lock);
+    allocator_unmap(cache, sizeof(objcache_t));
+}
+
+void* objcache_alloc(objcache_t* cache) {
+    if (!cache) return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    // частичные slab'ы первыми: пустые остаются целыми и могут уйти ОС
+    slab_t* slab = cache->slabs[SLAB_LIST_PARTIAL];
+    if (!slab) {
+        slab = cache->slabs[SLAB_LIST_EMPTY];
+    }
+    if (!slab) {
+        slab = create_slab(cache);
+    }
+    if (!slab) {
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+
+    uint16_t index = slab->free[--slab->free_count];
+    slab_update(cache, slab);
+    cache->stats.allocations++;
+    cache->stats.in_use++;
+    pthread_mutex_unlock(&cache->lock);
+    return slab->data + index * cache->stride;
+}
+
+void objcache_free(objcache_t* cache, void* obj) {
+    if (!cache || !obj) return;
+
+    pthread_mutex_lock(&cache->lock);
+    slab_t* slab = slab_of(cache, obj);
+    slab->free[slab->free_count++] = (uint16_t)(((char*)obj - slab->data) / cache->stride);
+    slab_update(cache, slab);
+    cache->stats.frees++;
+    cache->stats.in_use--;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+size_t objcache_reap(objcache_t* cache) {
+    if (!cache) return 0;
+
+    size_t released = 0;
+    pthread_mutex_lock(&cache->lock);
+    while (cache->slabs[SLAB_LIST_EMPTY]) {
+        destroy_slab(cache, cache->slabs[SLAB_LIST_EMPTY]);
+        released += cache->slab_size;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return released;
+}
+
+void objcache_get_stats(objcache_t* cache, objcache_stats_t* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(objcache_stats_t));
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    stats->slabs = cache->num_slabs;
+    stats->slab_bytes = cache->num_slabs * cache->slab_size;
+    stats->slab_size = cache->slab_size;
+    stats->objects_per_slab = cache->num_objects;
+    stats->colors = cache->color_max / cache->color_step + 1;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,401 @@
+// Подмена malloc/free для LD_PRELOAD: собирается в build/libmemalloc.so
+// (make preload) и позволяет гонять реальные программы поверх наших аллокаторов.
+//
+//   MEMALLOC_ALLOCATOR=segregated|mckusick|buddy|tlsf - реализация (по умолчанию segregated)
+//   MEMALLOC_HEAP_MB=<n>                               - размер кучи реализации (1024 МБ)
+//   MEMALLOC_STATS=1                                   - статистика в stderr при выходе
+//   MEMALLOC_TRACE=<файл>                              - запись трассы выделений (trace.h)
+//
+// Загрузка: аллокатор создаётся лениво при первом вызове, а не в конструкторе -
+// libc и загрузчик зовут malloc раньше, чем отрабатывают конструкторы. Сам
+// аллокатор служебную память берёт через mmap, но вызовы изнутри него (например,
+// calloc в pthread_setspecific) и из инициализации обслуживает статическая
+// затравочная арена: признак вложенности лежит в TLS модели initial-exec,
+// обращение к которой само malloc не вызывает.
+#include "../include/allocator.h"
+#include "../include/allocator_internal.h"
+#include "../include/trace.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define SHIM_EXPORT __attribute__((visibility("default")))
+
+#define SHIM_DEFAULT_HEAP_MB 1024
+#define BOOTSTRAP_ARENA_SIZE (256 * 1024)
+
+enum { SHIM_UNINITIALIZED, SHIM_INITIALIZING, SHIM_READY };
+
+static allocator_t* shim_alloc;
+static int shim_state = SHIM_UNINITIALIZED;
+static __thread int shim_depth __attribute__((tls_model("initial-exec")));
+static trace_recorder_t* shim_trace;
+static pid_t shim_trace_pid; // трассу дописывает только записавший её процесс
+
+// Затравочная арена: только выделение вперёд, освобождение - пустая операция.
+// Перед блоком хранится его размер (для realloc и malloc_usable_size).
+static char bootstrap_arena[BOOTSTRAP_ARENA_SIZE] __attribute__((aligned(ALLOCATOR_MAX_ALIGNMENT)));
+static size_t bootstrap_used;
+
+static void* bootstrap_alloc(size_t alignment, size_t size) {
+    if (alignment < ALLOCATOR_MIN_ALIGNMENT) {
+        alignment = ALLOCATOR_MIN_ALIGNMENT;
+    }
+    size_t used = __atomic_load_n(&bootstrap_used, __ATOMIC_RELAXED);
+    size_t start;
+    do {
+        start = (used + ALLOCATOR_MIN_ALIGNMENT + alignment - 1) & ~(alignment - 1);
+        if (size > BOOTSTRAP_ARENA_SIZE || start > BOOTSTRAP_ARENA_SIZE - size) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&bootstrap_used, &used, start + size, false,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *(size_t*)(bootstrap_arena + start - sizeof(size_t)) = size;
+    return bootstrap_arena + start;
+}
+
+static inline bool in_bootstrap(void* ptr) {
+    return (char*)ptr >= bootstrap_arena && (char*)ptr < bootstrap_arena + BOOTSTRAP_ARENA_SIZE;
+}
+
+static inline size_t bootstrap_size(void* ptr) {
+    return *(size_t*)((char*)ptr - sizeof(size_t));
+}
+
+static void shim_dump_stats(void) {
+    shim_depth++;
+    allocator_dump_stats(shim_alloc, stderr, ALLOCATOR_STATS_JSON);
+    shim_depth--;
+}
+
+// память журнала не снимается: другие потоки и деструкторы после
+// atexit ещё могут зайти в запись, она будет просто проигнорирована
+static void shim_finish_trace(void) {
+    if (getpid() == shim_trace_pid) {
+        trace_recorder_finish(shim_trace);
+    }
+}
+
+// fork в многопоточной программе: блокировки не должны остаться
+// захваченными потоками, которых в потомке уже нет
+static void shim_prepare_fork(void) {
+    pthread_mutex_lock(&shim_alloc->lock);
+    pthread_mutex_lock(&shim_alloc->large.lock);
+}
+
+static void shim_parent_after_fork(void) {
+    pthread_mutex_unlock(&shim_alloc->large.lock);
+    pthread_mutex_unlock(&shim_alloc->lock);
+}
+
+static void shim_child_after_fork(void) {
+    pthread_mutex_init(&shim_alloc->large.lock, NULL);
+    pthread_mutex_init(&shim_alloc->lock, NULL);
+    // журнал мог остаться захваченным другим потоком, потомок его не пишет
+    allocator_set_trace(shim_alloc, NULL);
+}
+
+static void shim_init(void) {
+    const char* type_name = getenv("MEMALLOC_ALLOCATOR");
+    allocator_type_t type = ALLOCATOR_SEGREGATED_FREELIST;
+    if (type_name && strcmp(type_name, "mckusick") == 0) {
+        type = ALLOCATOR_MCKUSICK_KARELS;
+    } else if (type_name && strcmp(type_name, "buddy") == 0) {
+        type = ALLOCATOR_BUDDY;
+    } else if (type_name && strcmp(type_name, "tlsf") == 0) {
+        type = ALLOCATOR_TLSF;
+    }
+
+    const char* heap_mb = getenv("MEMALLOC_HEAP_MB");
+    size_t heap_size = (size_t)SHIM_DEFAULT_HEAP_MB << 20;
+    if (heap_mb && atol(heap_mb) > 0) {
+        heap_size = (size_t)atol(heap_mb) << 20;
+    }
+
+    shim_alloc = allocator_create(type, heap_size);
+    if (!shim_alloc) {
+        static const char msg[] = "memalloc: failed to create allocator\n";
+        write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        abort();
+    }
+
+    pthread_atfork(shim_prepare_fork, shim_parent_after_fork, shim_child_after_fork);
+    const char* stats = getenv("MEMALLOC_STATS");
+    if (stats && strcmp(stats, "1") == 0) {
+        atexit(shim_dump_stats);
+    }
+
+    const char* trace_path = getenv("MEMALLOC_TRACE");
+    if (trace_path && *trace_path) {
+        shim_trace = trace_recorder_create(trace_path);
+        if (shim_trace) {
+            shim_trace_pid = getpid();
+            allocator_set_trace(shim_alloc, shim_trace);
+            atexit(shim_finish_trace);
+        }
+    }
+}
+
+// Аллокатор процесса; NULL - вызов вложенный, его обслуживает арена
+static allocator_t* shim_get(void) {
+    if (shim_depth > 0) {
+        return NULL;
+    }
+
+    int state = __atomic_load_n(&shim_state, __ATOMIC_ACQUIRE);
+    if (state == SHIM_READY) {
+        return shim_alloc;
+    }
+
+    int expected = SHIM_UNINITIALIZED;
+    if (__atomic_compare_exchange_n(&shim_state, &expected, SHIM_INITIALIZING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        shim_depth++;
+        shim_init();
+        shim_depth--;
+        __atomic_store_n(&shim_state, SHIM_READY, __ATOMIC_RELEASE);
+        return shim_alloc;
+    }
+
+    // инициализацию ведёт другой поток
+    while (__atomic_load_n(&shim_state, __ATOMIC_ACQUIRE) != SHIM_READY) {
+        sched_yield();
+    }
+    return shim_alloc;
+}
+
+static void* shim_malloc(size_t size) {
+    allocator_t* alloc = shim_get();
+    if (!alloc) {
+        return bootstrap_alloc(ALLOCATOR_MIN_ALIGNMENT, size ? size : 1);
+    }
+
+    shim_depth++;
+    // malloc(0) обязан вернуть уникальный указатель
+    void* ptr = allocator_alloc(alloc, size ? size : 1);
+    shim_depth--;
+    if (!ptr) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+static void* shim_aligned(size_t alignment, size_t size) {
+    if (alignment > ALLOCATOR_MAX_ALIGNMENT) {
+        errno = EINVAL;
+        return NULL;
+    }
+    allocator_t* alloc = shim_get();
+    if (!alloc) {
+        return bootstrap_alloc(alignment, size ? size : 1);
+    }
+
+    shim_depth++;
+    void* ptr = allocator_aligned_alloc(alloc, alignment, size ? size : 1);
+    shim_depth--;
+    if (!ptr) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+static void shim_free(void* ptr) {
+    if (!ptr || in_bootstrap(ptr)) {
+        return;
+    }
+    shim_depth++;
+    allocator_free(shim_alloc, ptr);
+    shim_depth--;
+}
+
+static void shim_free_sized(void* ptr, size_t size) {
+    if (!ptr || in_bootstrap(ptr)) {
+        return;
+    }
+    shim_depth++;
+    allocator_free_sized(shim_alloc, ptr, size ? size : 1);
+    shim_depth--;
+}
+
+static void shim_free_aligned_sized(void* ptr, size_t alignment, size_t size) {
+    if (!ptr || in_bootstrap(ptr)) {
+        return;
+    }
+    shim_depth++;
+    allocator_free_aligned_sized(shim_alloc, ptr, alignment, size ? size : 1);
+    shim_depth--;
+}
+
+static size_t shim_usable_size(void* ptr) {
+    if (!ptr) {
+        return 0;
+    }
+    if (in_bootstrap(ptr)) {
+        return bootstrap_size(ptr);
+    }
+    return allocator_usable_size(shim_alloc, ptr);
+}
+
+SHIM_EXPORT void* malloc(size_t size) {
+    return shim_malloc(size);
+}
+
+SHIM_EXPORT void free(void* ptr) {
+    shim_free(ptr);
+}
+
+SHIM_EXPORT void* calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    // переиспользованные блоки грязные, обнуляем всегда
+    void* ptr = shim_malloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+SHIM_EXPORT void* realloc(void* ptr, size_t size) {
+    if (ptr && in_bootstrap(ptr)) {
+        // блоки арены не освобождаются, только переезжают
+        void* moved = shim_malloc(size);
+        if (moved) {
+            size_t old_size = bootstrap_size(ptr);
+            memcpy(moved, ptr, old_size < size ? old_size : size);
+        }
+        return moved;
+    }
+
+    allocator_t* alloc = shim_get();
+    if (!alloc) {
+        return ptr ? NULL : bootstrap_alloc(ALLOCATOR_MIN_ALIGNMENT, size ? size : 1);
+    }
+
+    shim_depth++;
+    void* resized = allocator_realloc(alloc, ptr, size);
+    shim_depth--;
+    if (!resized && size > 0) {
+        errno = ENOMEM;
+    }
+    return resized;
+}
+
+SHIM_EXPORT int posix_memalign(void** out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    int saved_errno = errno;
+    void* ptr = shim_aligned(alignment, size);
+    if (!ptr) {
+        int err = errno;
+        errno = saved_errno;
+        return err;
+    }
+    *out = ptr;
+    return 0;
+}
+
+SHIM_EXPORT void* aligned_alloc(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return shim_aligned(alignment, size);
+}
+
+SHIM_EXPORT void* memalign(size_t alignment, size_t size) {
+    return aligned_alloc(alignment, size);
+}
+
+SHIM_EXPORT void* valloc(size_t size) {
+    return shim_aligned((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+SHIM_EXPORT void* pvalloc(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return shim_aligned(page, (size + page - 1) & ~(page - 1));
+}
+
+SHIM_EXPORT size_t malloc_usable_size(void* ptr) {
+    return shim_usable_size(ptr);
+}
+
+// operator new/delete под именами Itanium C++ ABI, без зависимости от
+// libstdc++. Исключение std::bad_alloc из C не бросить: при нехватке
+// памяти бросающие формы завершают процесс, как непойманное исключение.
+static void* shim_new(size_t size) {
+    void* ptr = shim_malloc(size);
+    if (!ptr) {
+        static const char msg[] = "memalloc: operator new: out of memory\n";
+        write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        abort();
+    }
+    return ptr;
+}
+
+static void* shim_new_aligned(size_t size, size_t alignment) {
+    void* ptr = shim_aligned(alignment, size);
+    if (!ptr) {
+        static const char msg[] = "memalloc: aligned operator new: out of memory\n";
+        write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        abort();
+    }
+    return ptr;
+}
+
+// operator new(size_t), new[](size_t) и nothrow-формы
+SHIM_EXPORT void* _Znwm(size_t size) { return shim_new(size); }
+SHIM_EXPORT void* _Znam(size_t size) { return shim_new(size); }
+SHIM_EXPORT void* _ZnwmRKSt9nothrow_t(size_t size, const void* tag) { (void)tag; return shim_malloc(size); }
+SHIM_EXPORT void* _ZnamRKSt9nothrow_t(size_t size, const void* tag) { (void)tag; return shim_malloc(size); }
+
+// operator new(size_t, std::align_val_t) (C++17)
+SHIM_EXPORT void* _ZnwmSt11align_val_t(size_t size, size_t alignment) {
+    return shim_new_aligned(size, alignment);
+}
+SHIM_EXPORT void* _ZnamSt11align_val_t(size_t size, size_t alignment) {
+    return shim_new_aligned(size, alignment);
+}
+SHIM_EXPORT void* _ZnwmSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const void* tag) {
+    (void)tag;
+    return shim_aligned(alignment, size);
+}
+SHIM_EXPORT void* _ZnamSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const void* tag) {
+    (void)tag;
+    return shim_aligned(alignment, size);
+}
+
+// operator delete: обычные, sized (C++14) - через allocator_free_sized, nothrow
+SHIM_EXPORT void _ZdlPv(void* ptr) { shim_free(ptr); }
+SHIM_EXPORT void _ZdaPv(void* ptr) { shim_free(ptr); }
+SHIM_EXPORT void _ZdlPvm(void* ptr, size_t size) { shim_free_sized(ptr, size); }
+SHIM_EXPORT void _ZdaPvm(void* ptr, size_t size) { shim_free_sized(ptr, size); }
+SHIM_EXPORT void _ZdlPvRKSt9nothrow_t(void* ptr, const void* tag) { (void)tag; shim_free(ptr); }
+SHIM_EXPORT void _ZdaPvRKSt9nothrow_t(void* ptr, const void* tag) { (void)tag; shim_free(ptr); }
+
+// выровненные блоки без размера - обычным освобождением, с размером -
+// классом, подобранным по размеру и выравниванию, как при выделении
+SHIM_EXPORT void _ZdlPvSt11align_val_t(void* ptr, size_t alignment) { (void)alignment; shim_free(ptr); }
+SHIM_EXPORT void _ZdaPvSt11align_val_t(void* ptr, size_t alignment) { (void)alignment; shim_free(ptr); }
+SHIM_EXPORT void _ZdlPvmSt11align_val_t(void* ptr, size_t size, size_t alignment) {
+    shim_free_aligned_sized(ptr, alignment, size);
+}
+SHIM_EXPORT void _ZdaPvmSt11align_val_t(void* ptr, size_t size, size_t alignment) {
+    shim_free_aligned_sized(ptr, alignment, size);
+}
+SHIM_EXPORT void _ZdlPvSt11align_val_tRKSt9nothrow_t(void* ptr, size_t alignment, const void* tag) {
+    (void)alignment;
+    (void)tag;
+    shim_free(ptr);
+}
+SHIM_EXPORT void _ZdaPvSt11align_val_tRKSt9nothrow_t(void* ptr, size_t alignment, const void* tag) {
+    (void)alignment;
+    (void)tag;
+    shim_free(ptr);
+}
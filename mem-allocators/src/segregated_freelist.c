@@ -1,71 +1,435 @@
 #include "../include/segregated_freelist.h"
-#include "../include/allocator.h"
+#include "../include/allocator_internal.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
-const size_t SIZE_CLASSES[NUM_SIZE_CLASSES] = {
-    16, 32, 64, 128, 256, 512, 1024, 2048
-};
-
+// Граничные теги: в заголовке каждого блока хранится его размер и флаги,
+// свободный блок дополнительно хранит размер в последнем слове (footer).
+// Поэтому при освобождении за O(1) находятся оба соседа и сливаются.
 typedef struct free_block {
+    size_t size; // размер | флаги, совпадает с block_header_t.size
     struct free_block* next;
-    size_t size;
+    struct free_block* prev;
 } free_block_t;
 
 typedef struct {
-    size_t size;
+    size_t size; // размер блока | BLOCK_USED | PREV_USED
     size_t magic;
 } block_header_t;
 
 #define BLOCK_MAGIC 0xDEADBEEF
-#define ALIGN_SIZE 8
+#define ALIGN_SIZE 16 // как у malloc на x86-64: данные выровнены под SSE
 #define HEADER_SIZE sizeof(block_header_t)
 
+#define BLOCK_USED ((size_t)1) // блок занят
+#define PREV_USED ((size_t)2) // предыдущий блок занят (footer у него нет)
+// Объект класса, выданный пачкой вместе с неотрезанным хвостом: остаток
+// меньше MIN_BLOCK_SIZE (32 байта) кратен ALIGN_SIZE, значит хвост ровно
+// ALIGN_SIZE байт. Такой объект по-прежнему считается объектом класса
+#define CLASS_SLACK ((size_t)4)
+#define SIZE_MASK (~(size_t)(ALIGN_SIZE - 1))
+#define FOOTER_SIZE sizeof(size_t)
+#define MIN_BLOCK_SIZE (sizeof(free_block_t) + FOOTER_SIZE)
+
+// Индекс крупных свободных блоков: 4 корзины на каждую степень двойки
+// от 32 байт до 1 МБ, всё крупнее - в последней корзине. Битовая карта
+// непустых корзин позволяет найти подходящую корзину за O(1).
+#define LARGE_BIN_SUBBITS 2
+#define LARGE_BIN_MIN_SHIFT 5
+#define NUM_LARGE_BINS 64
+#define BIN_SEARCH_LIMIT 16 // сколько блоков своей корзины смотрим ради best-fit
+
+// Куча выровнена по RUN_SIZE, чтобы участок кучи находился по адресу сдвигом.
+// В режиме SEGREGATED_HEADERLESS объекты размерных классов не имеют
+// заголовка: они нарезаются из прогонов (run) - выровненных участков по
+// RUN_SIZE байт. Сам прогон - обычный занятый блок кучи, его заголовок
+// лежит перед границей участка; класс объекта берётся из дескриптора
+// прогона по индексу участка. Без размера в заголовке такие объекты не
+// сливаются с соседями - прогон возвращается в кучу целиком, когда опустеет.
+#define RUN_SHIFT 14
+#define RUN_SIZE ((size_t)1 << RUN_SHIFT)
+
+// выровнять объекты классов по линии кэша можно только в прогонах
+#if defined(ALLOCATOR_CACHE_ALIGNED) && !defined(SEGREGATED_HEADERLESS)
+#define SEGREGATED_HEADERLESS
+#endif
+
+#ifdef SEGREGATED_HEADERLESS
+typedef struct run {
+    int class_idx; // -1: участок не является прогоном
+    unsigned num_objects;
+    unsigned free_count;
+    unsigned bump; // объекты дальше bump ещё ни разу не выдавались
+    void* free_list; // освобождённые объекты, связь - в первом слове
+    struct run* next; // прогоны класса со свободными объектами
+    struct run* prev;
+} run_t;
+#endif
+
 typedef struct {
-    allocator_type_t type;
+    allocator_t base;
     void* heap; // заранее резервируем участок памяти
     size_t heap_size;
     free_block_t* free_lists[NUM_SIZE_CLASSES]; // свободные блоки для каждого класса
-    free_block_t* large_blocks; // доп блоки
+    free_block_t* large_bins[NUM_LARGE_BINS]; // доп блоки по корзинам размеров
+    uint64_t large_bitmap; // бит i - корзина i непуста
+#ifdef SEGREGATED_HEADERLESS
+    run_t* runs; // дескриптор на каждый участок RUN_SIZE кучи
+    run_t* partial_runs[NUM_SIZE_CLASSES];
+#endif
     allocator_stats_t stats;
 } segregated_freelist_allocator_t;
 
-static int get_size_class(size_t size) {
-    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
-        if (size <= SIZE_CLASSES[i]) {
-            return i;
-        }
-    }
-    return -1;
+static inline int get_size_class(size_t size) {
+    return size_class_index(size);
 }
 
 static size_t align_size(size_t size) {
     return (size + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
 }
 
+static inline size_t block_size(const void* block) {
+    return ((const free_block_t*)block)->size & SIZE_MASK;
+}
+
+// размер занятого блока без неотрезанного хвоста объекта класса
+static inline size_t object_size(const block_header_t* header) {
+    return block_size(header) - ((header->size & CLASS_SLACK) ? ALIGN_SIZE : 0);
+}
+
+static inline free_block_t* next_block(segregated_freelist_allocator_t* sf_alloc, void* block) {
+    char* next = (char*)block + block_size(block);
+    if (next >= (char*)sf_alloc->heap + sf_alloc->heap_size) {
+        return NULL;
+    }
+    return (free_block_t*)next;
+}
+
+static int large_bin_index(size_t size) {
+    int lg = 63 - __builtin_clzl(size);
+    int bin = (lg - LARGE_BIN_MIN_SHIFT) * (1 << LARGE_BIN_SUBBITS)
+            + (int)((size >> (lg - LARGE_BIN_SUBBITS)) & ((1 << LARGE_BIN_SUBBITS) - 1));
+    return bin < NUM_LARGE_BINS ? bin : NUM_LARGE_BINS - 1;
+}
+
+// блоки ровно размера класса живут в списке класса, остальные - в корзинах;
+// *bin = -1 для списков классов
+static free_block_t** list_for_size(segregated_freelist_allocator_t* sf_alloc, size_t size, int* bin) {
+    int class_idx = get_size_class(size);
+    if (class_idx >= 0 && size == SIZE_CLASSES[class_idx]) {
+        *bin = -1;
+        return &sf_alloc->free_lists[class_idx];
+    }
+    *bin = large_bin_index(size);
+    return &sf_alloc->large_bins[*bin];
+}
+
+static void remove_free(segregated_freelist_allocator_t* sf_alloc, free_block_t* block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        int bin;
+        free_block_t** head = list_for_size(sf_alloc, block_size(block), &bin);
+        *head = block->next;
+        if (!*head && bin >= 0) {
+            sf_alloc->large_bitmap &= ~((uint64_t)1 << bin);
+        }
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+}
+
+// соседние свободные блоки всегда слиты, поэтому предыдущий блок занят
+static void insert_free(segregated_freelist_allocator_t* sf_alloc, free_block_t* block, size_t size) {
+    block->size = size | PREV_USED;
+    *(size_t*)((char*)block + size - FOOTER_SIZE) = size;
+    
+    free_block_t* next = next_block(sf_alloc, block);
+    if (next) {
+        next->size &= ~PREV_USED;
+    }
+    
+    int bin;
+    free_block_t** head = list_for_size(sf_alloc, size, &bin);
+    if (bin >= 0) {
+        sf_alloc->large_bitmap |= (uint64_t)1 << bin;
+    }
+    block->prev = NULL;
+    block->next = *head;
+    if (*head) {
+        (*head)->prev = block;
+    }
+    *head = block;
+}
+
+static void account_alloc(segregated_freelist_allocator_t* sf_alloc, size_t size) {
+    sf_alloc->stats.total_allocations++;
+    sf_alloc->stats.current_allocated += size;
+    if (sf_alloc->stats.current_allocated > sf_alloc->stats.peak_allocated) {
+        sf_alloc->stats.peak_allocated = sf_alloc->stats.current_allocated;
+    }
+}
+
+// помечает уже снятый со списков блок занятым
+static void* mark_used(segregated_freelist_allocator_t* sf_alloc, free_block_t* block, size_t size) {
+    block_header_t* header = (block_header_t*)block;
+    header->size = size | BLOCK_USED | PREV_USED;
+    header->magic = BLOCK_MAGIC;
+    
+    free_block_t* next = next_block(sf_alloc, block);
+    if (next) {
+        next->size |= PREV_USED;
+    }
+    
+    account_alloc(sf_alloc, size);
+    return (char*)block + HEADER_SIZE;
+}
+
+// забирает свободный блок под выделение, отрезая остаток, если он не меньше MIN_BLOCK_SIZE
+static void* use_block(segregated_freelist_allocator_t* sf_alloc, free_block_t* block, size_t size) {
+    remove_free(sf_alloc, block);
+    
+    size_t available = block_size(block);
+    if (available - size >= MIN_BLOCK_SIZE) {
+        insert_free(sf_alloc, (free_block_t*)((char*)block + size), available - size);
+    } else {
+        size = available;
+    }
+    
+    return mark_used(sf_alloc, block, size);
+}
+
+// Поиск в корзинах: best-fit среди первых BIN_SEARCH_LIMIT блоков своей
+// корзины, иначе - любой блок первой непустой корзины выше (все они
+// заведомо больше). Если выше пусто, досматриваем остаток своей корзины:
+// подходящий блок может лежать глубже. Последняя корзина не ограничена
+// сверху - её просматриваем целиком.
+static free_block_t* find_large(segregated_freelist_allocator_t* sf_alloc, size_t size) {
+    int bin = large_bin_index(size);
+    free_block_t* best = NULL;
+    int limit = (bin == NUM_LARGE_BINS - 1) ? -1 : BIN_SEARCH_LIMIT;
+    free_block_t* curr = sf_alloc->large_bins[bin];
+    
+    for (; curr && limit != 0; curr = curr->next, limit--) {
+        size_t curr_size = block_size(curr);
+        if (curr_size >= size && (!best || curr_size < block_size(best))) {
+            best = curr;
+            if (curr_size == size) break;
+        }
+    }
+    if (best || bin == NUM_LARGE_BINS - 1) {
+        return best;
+    }
+    
+    uint64_t higher = sf_alloc->large_bitmap & (~(uint64_t)0 << (bin + 1));
+    if (higher) {
+        return sf_alloc->large_bins[__builtin_ctzll(higher)];
+    }
+    for (; curr; curr = curr->next) {
+        if (block_size(curr) >= size) {
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+// Где в свободном блоке начнутся данные, выровненные по alignment;
+// 0 - блок мал. Остаток спереди либо пуст, либо сам становится блоком.
+static uintptr_t aligned_data(free_block_t* block, size_t total_size, size_t alignment) {
+    uintptr_t start = (uintptr_t)block;
+    uintptr_t data = (start + HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (data - HEADER_SIZE != start && data - HEADER_SIZE - start < MIN_BLOCK_SIZE) {
+        data += alignment;
+    }
+    if (data - HEADER_SIZE - start + total_size > block_size(block)) {
+        return 0;
+    }
+    return data;
+}
+
+// Занятый блок, данные которого начинаются с адреса, кратного alignment
+// (степень двойки не меньше ALIGN_SIZE). Сначала пробуем обычный best-fit,
+// затем блок с запасом на любой сдвиг; отрезанное до и после выровненного
+// блока возвращается в списки.
+static void* alloc_aligned_block(segregated_freelist_allocator_t* sf_alloc, size_t size, size_t alignment) {
+    size_t total_size = align_size(size + HEADER_SIZE);
+    free_block_t* block = find_large(sf_alloc, total_size);
+    uintptr_t data = block ? aligned_data(block, total_size, alignment) : 0;
+    if (!data) {
+        block = find_large(sf_alloc, total_size + alignment + MIN_BLOCK_SIZE);
+        if (!block) {
+            return NULL;
+        }
+        data = aligned_data(block, total_size, alignment);
+    }
+    remove_free(sf_alloc, block);
+    
+    size_t lead = data - HEADER_SIZE - (uintptr_t)block;
+    size_t rest = block_size(block) - lead;
+    if (rest - total_size < MIN_BLOCK_SIZE) {
+        total_size = rest;
+    }
+    
+    block_header_t* header = (block_header_t*)(data - HEADER_SIZE);
+    header->size = total_size | BLOCK_USED | (lead ? 0 : PREV_USED);
+    header->magic = BLOCK_MAGIC;
+    if (lead) {
+        insert_free(sf_alloc, block, lead);
+    }
+    if (rest > total_size) {
+        insert_free(sf_alloc, (free_block_t*)((char*)header + total_size), rest - total_size);
+    } else {
+        free_block_t* next = next_block(sf_alloc, header);
+        if (next) {
+            next->size |= PREV_USED;
+        }
+    }
+    
+    account_alloc(sf_alloc, total_size);
+    return (void*)data;
+}
+
+#ifdef SEGREGATED_HEADERLESS
+static inline char* run_data(segregated_freelist_allocator_t* sf_alloc, run_t* run) {
+    return (char*)sf_alloc->heap + ((size_t)(run - sf_alloc->runs) << RUN_SHIFT);
+}
+
+// прогон, которому принадлежит объект; NULL - обычный блок с заголовком
+static inline run_t* run_of(segregated_freelist_allocator_t* sf_alloc, void* ptr) {
+    run_t* run = &sf_alloc->runs[((char*)ptr - (char*)sf_alloc->heap) >> RUN_SHIFT];
+    return run->class_idx >= 0 ? run : NULL;
+}
+
+static void run_push(segregated_freelist_allocator_t* sf_alloc, run_t* run) {
+    run_t** head = &sf_alloc->partial_runs[run->class_idx];
+    run->prev = NULL;
+    run->next = *head;
+    if (*head) {
+        (*head)->prev = run;
+    }
+    *head = run;
+}
+
+static void run_unlink(segregated_freelist_allocator_t* sf_alloc, run_t* run) {
+    if (run->prev) {
+        run->prev->next = run->next;
+    } else {
+        sf_alloc->partial_runs[run->class_idx] = run->next;
+    }
+    if (run->next) {
+        run->next->prev = run->prev;
+    }
+}
+
+// данные прогона короче участка на заголовок следующего блока: так
+// прогоны, нарезанные подряд, ложатся на соседние участки без зазоров
+static run_t* run_create(segregated_freelist_allocator_t* sf_alloc, int class_idx) {
+    char* data = alloc_aligned_block(sf_alloc, RUN_SIZE - HEADER_SIZE, RUN_SIZE);
+    if (!data) {
+        return NULL;
+    }
+    
+    run_t* run = &sf_alloc->runs[(data - (char*)sf_alloc->heap) >> RUN_SHIFT];
+    run->class_idx = class_idx;
+    run->num_objects = (unsigned)((RUN_SIZE - HEADER_SIZE) / SIZE_CLASSES[class_idx]);
+    run->free_count = run->num_objects;
+    run->bump = 0;
+    run->free_list = NULL;
+    run_push(sf_alloc, run);
+    return run;
+}
+
+static void* run_alloc(segregated_freelist_allocator_t* sf_alloc, int class_idx) {
+    run_t* run = sf_alloc->partial_runs[class_idx];
+    if (!run) {
+        run = run_create(sf_alloc, class_idx);
+        if (!run) {
+            sf_alloc->stats.failed_allocations++;
+            return NULL;
+        }
+    }
+    
+    void* obj = run->free_list;
+    if (obj) {
+        run->free_list = *(void**)obj;
+    } else {
+        obj = run_data(sf_alloc, run) + (size_t)run->bump++ * SIZE_CLASSES[class_idx];
+    }
+    if (--run->free_count == 0) {
+        run_unlink(sf_alloc, run);
+    }
+    return obj;
+}
+
+// опустевший прогон уходит обратно в кучу, если у класса есть другой
+// прогон со свободными объектами (иначе чередование alloc/free на
+// границе прогона каждый раз резало бы кучу заново)
+static void run_free(segregated_freelist_allocator_t* sf_alloc, run_t* run, void* ptr) {
+    *(void**)ptr = run->free_list;
+    run->free_list = ptr;
+    if (run->free_count++ == 0) {
+        run_push(sf_alloc, run);
+    }
+    
+    if (run->free_count == run->num_objects && (run->prev || run->next)) {
+        run_unlink(sf_alloc, run);
+        run->class_idx = -1;
+        segregated_freelist_free((allocator_t*)sf_alloc, run_data(sf_alloc, run));
+    }
+}
+#endif
+
+#ifdef SEGREGATED_HEADERLESS
+// лишний дескриптор - для хвоста кучи, не кратного RUN_SIZE
+#define RUNS_MAP_SIZE(heap_size) ((((heap_size) >> RUN_SHIFT) + 1) * sizeof(run_t))
+#endif
+
 allocator_t* segregated_freelist_create(size_t heap_size) {
-    segregated_freelist_allocator_t* alloc = malloc(sizeof(segregated_freelist_allocator_t));
+    heap_size &= SIZE_MASK;
+    if (heap_size < MIN_BLOCK_SIZE) {
+        return NULL;
+    }
+    
+    segregated_freelist_allocator_t* alloc = allocator_map(sizeof(segregated_freelist_allocator_t), 0);
     if (!alloc) {
         return NULL;
     }
     
-    alloc->type = ALLOCATOR_SEGREGATED_FREELIST;
+    alloc->base.type = ALLOCATOR_SEGREGATED_FREELIST;
     alloc->heap_size = heap_size;
-    alloc->heap = malloc(heap_size);
+    alloc->heap = allocator_map(heap_size, RUN_SIZE);
     if (!alloc->heap) {
-        free(alloc);
+        allocator_unmap(alloc, sizeof(segregated_freelist_allocator_t));
         return NULL;
     }
+#ifdef SEGREGATED_HEADERLESS
+    alloc->runs = allocator_map(RUNS_MAP_SIZE(heap_size), 0);
+    if (!alloc->runs) {
+        allocator_unmap(alloc->heap, heap_size);
+        allocator_unmap(alloc, sizeof(segregated_freelist_allocator_t));
+        return NULL;
+    }
+    for (size_t i = 0; i <= heap_size >> RUN_SHIFT; i++) {
+        alloc->runs[i].class_idx = -1;
+    }
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        alloc->partial_runs[i] = NULL;
+    }
+#endif
     
     for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
         alloc->free_lists[i] = NULL;
     }
-    alloc->large_blocks = NULL;
+    for (int i = 0; i < NUM_LARGE_BINS; i++) {
+        alloc->large_bins[i] = NULL;
+    }
+    alloc->large_bitmap = 0;
     
-    alloc->large_blocks = (free_block_t*)alloc->heap;
-    alloc->large_blocks->next = NULL;
-    alloc->large_blocks->size = heap_size;
+    // вся куча - один свободный блок, слева от него "занято"
+    insert_free(alloc, (free_block_t*)alloc->heap, heap_size);
     
     memset(&alloc->stats, 0, sizeof(allocator_stats_t));
     
@@ -76,8 +440,11 @@ void segregated_freelist_destroy(allocator_t* alloc) {
     if (!alloc) return;
     
     segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
-    free(sf_alloc->heap);
-    free(sf_alloc);
+#ifdef SEGREGATED_HEADERLESS
+    allocator_unmap(sf_alloc->runs, RUNS_MAP_SIZE(sf_alloc->heap_size));
+#endif
+    allocator_unmap(sf_alloc->heap, sf_alloc->heap_size);
+    allocator_unmap(sf_alloc, sizeof(segregated_freelist_allocator_t));
 }
 
 void* segregated_freelist_alloc(allocator_t* alloc, size_t size) {
@@ -86,120 +453,327 @@ void* segregated_freelist_alloc(allocator_t* alloc, size_t size) {
     }
     
     segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+#ifdef SEGREGATED_HEADERLESS
+    int run_class = get_size_class(size);
+    if (run_class >= 0) {
+        return run_alloc(sf_alloc, run_class);
+    }
+#endif
     size_t total_size = align_size(size + HEADER_SIZE);
+    if (total_size < MIN_BLOCK_SIZE) {
+        total_size = MIN_BLOCK_SIZE;
+    }
     int class_idx = get_size_class(total_size);
     
     free_block_t* block = NULL;
     
     if (class_idx >= 0) {
-        if (sf_alloc->free_lists[class_idx]) {
-            block = sf_alloc->free_lists[class_idx];
-            sf_alloc->free_lists[class_idx] = block->next;
-        } else {
-            free_block_t** prev_ptr = &sf_alloc->large_blocks;
-            free_block_t* curr = sf_alloc->large_blocks;
-            
-            while (curr) {
-                if (curr->size >= SIZE_CLASSES[class_idx]) {
-                    *prev_ptr = curr->next;
-                    
-                    size_t block_size = SIZE_CLASSES[class_idx];
-                    size_t remaining = curr->size - block_size;
-                    
-                    block = curr;
-                    
-                    if (remaining >= SIZE_CLASSES[0]) {
-                        free_block_t* remainder = (free_block_t*)((char*)curr + block_size);
-                        remainder->size = remaining;
-                        remainder->next = sf_alloc->large_blocks;
-                        sf_alloc->large_blocks = remainder;
-                    }
-                    
-                    break;
-                }
-                prev_ptr = &curr->next;
-                curr = curr->next;
-            }
-        }
+        total_size = SIZE_CLASSES[class_idx];
+        block = sf_alloc->free_lists[class_idx];
         
-        if (block) {
-            block_header_t* header = (block_header_t*)block;
-            header->size = total_size;
-            header->magic = BLOCK_MAGIC;
-            
-            sf_alloc->stats.total_allocations++;
-            sf_alloc->stats.current_allocated += total_size;
-            if (sf_alloc->stats.current_allocated > sf_alloc->stats.peak_allocated) {
-                sf_alloc->stats.peak_allocated = sf_alloc->stats.current_allocated;
-            }
-            
-            return (char*)block + HEADER_SIZE;
+        if (!block) {
+            block = find_large(sf_alloc, total_size);
         }
-    } else {
-        free_block_t** prev_ptr = &sf_alloc->large_blocks;
-        free_block_t* curr = sf_alloc->large_blocks;
-        
-        while (curr) {
-            if (curr->size >= total_size) {
-                *prev_ptr = curr->next;
-                
-                size_t remaining = curr->size - total_size;
-                block = curr;
-                
-                if (remaining >= SIZE_CLASSES[0]) {
-                    free_block_t* remainder = (free_block_t*)((char*)curr + total_size);
-                    remainder->size = remaining;
-                    remainder->next = sf_alloc->large_blocks;
-                    sf_alloc->large_blocks = remainder;
-                }
-                
-                block_header_t* header = (block_header_t*)block;
-                header->size = total_size;
-                header->magic = BLOCK_MAGIC;
-                
-                sf_alloc->stats.total_allocations++;
-                sf_alloc->stats.current_allocated += total_size;
-                if (sf_alloc->stats.current_allocated > sf_alloc->stats.peak_allocated) {
-                    sf_alloc->stats.peak_allocated = sf_alloc->stats.current_allocated;
-                }
-                
-                return (char*)block + HEADER_SIZE;
-            }
-            prev_ptr = &curr->next;
-            curr = curr->next;
+        // в крайнем случае делим блок большего класса
+        for (int i = class_idx + 1; !block && i < NUM_SIZE_CLASSES; i++) {
+            block = sf_alloc->free_lists[i];
         }
+    } else {
+        block = find_large(sf_alloc, total_size);
+    }
+    
+    if (block) {
+        return use_block(sf_alloc, block, total_size);
     }
     
     sf_alloc->stats.failed_allocations++;
     return NULL;
 }
 
+void* segregated_freelist_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment) {
+    if (!alloc || size == 0) {
+        return NULL;
+    }
+    
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+    if (alignment <= ALIGN_SIZE) {
+        return segregated_freelist_alloc(alloc, size);
+    }
+    // не меньше объекта своего класса: allocator_free_sized отправит
+    // такой блок в магазин класса
+    int class_idx = segregated_freelist_class_of(alloc, size);
+    if (class_idx >= 0) {
+        size = segregated_freelist_class_size(alloc, class_idx);
+    }
+    void* ptr = alloc_aligned_block(sf_alloc, size, alignment);
+    if (!ptr) {
+        sf_alloc->stats.failed_allocations++;
+    }
+    return ptr;
+}
+
+// Пачка блоков одного класса: начало списка класса отрезается целиком
+// (один разрыв связей вместо remove_free на каждый блок), недостающее -
+// обычным путём из корзин и старших классов. В безголовом режиме - из прогонов
+size_t segregated_freelist_alloc_batch(allocator_t* alloc, int class_idx, void** ptrs, size_t count) {
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+    size_t filled = 0;
+#ifdef SEGREGATED_HEADERLESS
+    while (filled < count) {
+        void* ptr = run_alloc(sf_alloc, class_idx);
+        if (!ptr) break;
+        ptrs[filled++] = ptr;
+    }
+#else
+    size_t size = SIZE_CLASSES[class_idx];
+    
+    free_block_t* block = sf_alloc->free_lists[class_idx];
+    while (block && filled < count) {
+        free_block_t* next = block->next;
+        ptrs[filled++] = mark_used(sf_alloc, block, size);
+        block = next;
+    }
+    sf_alloc->free_lists[class_idx] = block;
+    if (block) {
+        block->prev = NULL;
+    }
+    
+    // блок из корзины может остаться с хвостом: отмечаем его, чтобы
+    // освобождение и usable_size видели размер класса, как при выделении
+    while (filled < count) {
+        void* ptr = segregated_freelist_alloc(alloc, size - HEADER_SIZE);
+        if (!ptr) break;
+        block_header_t* header = (block_header_t*)((char*)ptr - HEADER_SIZE);
+        if (block_size(header) != size) {
+            header->size |= CLASS_SLACK;
+        }
+        ptrs[filled++] = ptr;
+    }
+#endif
+    return filled;
+}
+
 void segregated_freelist_free(allocator_t* alloc, void* ptr) {
     if (!alloc || !ptr) {
         return;
     }
     
     segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+#ifdef SEGREGATED_HEADERLESS
+    run_t* run = run_of(sf_alloc, ptr);
+    if (run) {
+        run_free(sf_alloc, run, ptr);
+        return;
+    }
+#endif
     block_header_t* header = (block_header_t*)((char*)ptr - HEADER_SIZE);
     
-    if (header->magic != BLOCK_MAGIC) {
+    if (header->magic != BLOCK_MAGIC || !(header->size & BLOCK_USED)) {
         fprintf(stderr, "Error: Invalid pointer or corrupted block\n");
         return;
     }
     
-    size_t total_size = header->size;
+    size_t total_size = block_size(header);
     sf_alloc->stats.total_frees++;
     sf_alloc->stats.current_allocated -= total_size;
     
-    int class_idx = get_size_class(total_size);
+    header->magic = 0;
     free_block_t* block = (free_block_t*)header;
-    block->size = total_size;
     
-    if (class_idx >= 0 && total_size == SIZE_CLASSES[class_idx]) {
-        block->next = sf_alloc->free_lists[class_idx];
-        sf_alloc->free_lists[class_idx] = block;
-    } else {
-        block->next = sf_alloc->large_blocks;
-        sf_alloc->large_blocks = block;
+    // слияние с правым соседом
+    free_block_t* next = next_block(sf_alloc, block);
+    if (next && !(next->size & BLOCK_USED)) {
+        remove_free(sf_alloc, next);
+        total_size += block_size(next);
+    }
+    
+    // слияние с левым соседом: его размер лежит в footer перед нашим заголовком
+    if (!(block->size & PREV_USED)) {
+        size_t prev_size = *((size_t*)block - 1);
+        free_block_t* prev = (free_block_t*)((char*)block - prev_size);
+        remove_free(sf_alloc, prev);
+        total_size += prev_size;
+        block = prev;
+    }
+    
+    insert_free(sf_alloc, block, total_size);
+}
+
+// отдаёт хвост занятого блока, оставляя keep байт; хвост сливается
+// со свободным правым соседом
+static void release_tail(segregated_freelist_allocator_t* sf_alloc, block_header_t* header, size_t keep) {
+    size_t tail_size = block_size(header) - keep;
+    
+    free_block_t* next = next_block(sf_alloc, header);
+    if (next && !(next->size & BLOCK_USED)) {
+        remove_free(sf_alloc, next);
+        tail_size += block_size(next);
+    }
+    
+    header->size = keep | (header->size & ~SIZE_MASK);
+    insert_free(sf_alloc, (free_block_t*)((char*)header + keep), tail_size);
+}
+
+void* segregated_freelist_resize(allocator_t* alloc, void* ptr, size_t new_size) {
+    if (!alloc || !ptr || new_size == 0) {
+        return NULL;
+    }
+    
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+#ifdef SEGREGATED_HEADERLESS
+    // объекты классов живут только в прогонах
+    if (run_of(sf_alloc, ptr) || get_size_class(new_size) >= 0) {
+        return NULL;
+    }
+#endif
+    block_header_t* header = (block_header_t*)((char*)ptr - HEADER_SIZE);
+    if (header->magic != BLOCK_MAGIC || !(header->size & BLOCK_USED)) {
+        return NULL;
+    }
+    
+    size_t total_size = align_size(new_size + HEADER_SIZE);
+    if (total_size < MIN_BLOCK_SIZE) {
+        total_size = MIN_BLOCK_SIZE;
+    }
+    int class_idx = get_size_class(total_size);
+    if (class_idx >= 0) {
+        total_size = SIZE_CLASSES[class_idx];
+    }
+    
+    size_t old_size = block_size(header);
+    if (total_size > old_size) {
+        // рост на месте: поглощаем свободного правого соседа
+        free_block_t* next = next_block(sf_alloc, header);
+        if (!next || (next->size & BLOCK_USED) || old_size + block_size(next) < total_size) {
+            return NULL;
+        }
+        remove_free(sf_alloc, next);
+        header->size = (old_size + block_size(next)) | (header->size & ~SIZE_MASK);
+        
+        free_block_t* after = next_block(sf_alloc, header);
+        if (after) {
+            after->size |= PREV_USED;
+        }
+    }
+    
+    if (block_size(header) - total_size >= MIN_BLOCK_SIZE) {
+        release_tail(sf_alloc, header, total_size);
+    }
+    // изменённый блок учитывается по прямому пути целиком
+    header->size &= ~CLASS_SLACK;
+    
+    sf_alloc->stats.current_allocated += block_size(header);
+    sf_alloc->stats.current_allocated -= old_size;
+    if (sf_alloc->stats.current_allocated > sf_alloc->stats.peak_allocated) {
+        sf_alloc->stats.peak_allocated = sf_alloc->stats.current_allocated;
+    }
+    
+    return ptr;
+}
+
+// без заголовков класс объекта - это класс запрошенного размера как есть
+#ifdef SEGREGATED_HEADERLESS
+#define SMALL_HEADER_SIZE 0
+#else
+#define SMALL_HEADER_SIZE HEADER_SIZE
+#endif
+
+int segregated_freelist_class_of(allocator_t* alloc, size_t size) {
+    (void)alloc;
+    if (size == 0) {
+        return -1;
+    }
+    return get_size_class(align_size(size + SMALL_HEADER_SIZE));
+}
+
+size_t segregated_freelist_class_size(allocator_t* alloc, int class_idx) {
+    (void)alloc;
+    return SIZE_CLASSES[class_idx] - SMALL_HEADER_SIZE;
+}
+
+// Объекты прогона лежат с шагом размера класса от начала, выровненного по
+// RUN_SIZE, поэтому выровнены по младшему биту размера. Блоки с заголовком
+// выровнены только по ALIGN_SIZE.
+size_t segregated_freelist_class_align(allocator_t* alloc, int class_idx) {
+    (void)alloc;
+#ifdef SEGREGATED_HEADERLESS
+    size_t size = SIZE_CLASSES[class_idx];
+    return size & -size;
+#else
+    (void)class_idx;
+    return ALIGN_SIZE;
+#endif
+}
+
+int segregated_freelist_class_of_ptr(allocator_t* alloc, void* ptr) {
+#ifdef SEGREGATED_HEADERLESS
+    // блоки с заголовком в этом режиме в магазины не попадают
+    run_t* run = run_of((segregated_freelist_allocator_t*)alloc, ptr);
+    return run ? run->class_idx : -1;
+#else
+    (void)alloc;
+    block_header_t* header = (block_header_t*)((char*)ptr - HEADER_SIZE);
+    if (header->magic != BLOCK_MAGIC) {
+        return -1;
+    }
+    
+    size_t size = object_size(header);
+    int class_idx = get_size_class(size);
+    if (class_idx >= 0 && size == SIZE_CLASSES[class_idx]) {
+        return class_idx;
+    }
+    return -1;
+#endif
+}
+
+size_t segregated_freelist_usable_size(allocator_t* alloc, void* ptr) {
+#ifdef SEGREGATED_HEADERLESS
+    run_t* run = run_of((segregated_freelist_allocator_t*)alloc, ptr);
+    if (run) {
+        return SIZE_CLASSES[run->class_idx];
+    }
+#else
+    (void)alloc;
+#endif
+    block_header_t* header = (block_header_t*)((char*)ptr - HEADER_SIZE);
+    if (header->magic != BLOCK_MAGIC) {
+        return 0;
+    }
+    return object_size(header) - HEADER_SIZE;
+}
+
+bool segregated_freelist_owns(allocator_t* alloc, void* ptr) {
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+    return (char*)ptr >= (char*)sf_alloc->heap &&
+           (char*)ptr < (char*)sf_alloc->heap + sf_alloc->heap_size;
+}
+
+static void account_free_list(free_block_t* list, allocator_stats_t* stats) {
+    for (free_block_t* curr = list; curr; curr = curr->next) {
+        size_t size = block_size(curr);
+        stats->free_bytes += size;
+        stats->free_blocks++;
+        if (size > stats->largest_free_block) {
+            stats->largest_free_block = size;
+        }
+    }
+}
+
+// обходит все свободные блоки: вызывается редко, при чтении статистики
+void segregated_freelist_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+    
+    stats->heap_size = sf_alloc->heap_size;
+    stats->peak_allocated = sf_alloc->stats.peak_allocated;
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        account_free_list(sf_alloc->free_lists[i], stats);
+    }
+    for (int i = 0; i < NUM_LARGE_BINS; i++) {
+        account_free_list(sf_alloc->large_bins[i], stats);
     }
 }
+
+void segregated_freelist_reset_peak(allocator_t* alloc) {
+    segregated_freelist_allocator_t* sf_alloc = (segregated_freelist_allocator_t*)alloc;
+    sf_alloc->stats.peak_allocated = sf_alloc->stats.current_allocated;
+}
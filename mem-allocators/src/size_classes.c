@@ -0,0 +1,7 @@
+#include "../include/size_classes.h"
+
+#define SIZE_CLASS_ENTRY(size) size,
+
+const size_t SIZE_CLASSES[NUM_SIZE_CLASSES] = {
+    SIZE_CLASS_LIST(SIZE_CLASS_ENTRY)
+};
@@ -0,0 +1,234 @@
+#include "../include/thread_cache.h"
+#include "../include/allocator_internal.h"
+#include <string.h>
+
+// магазин: стек указателей на свободные блоки одного класса
+typedef struct {
+    size_t count;
+    void* slots[TCACHE_MAGAZINE_SIZE];
+} tcache_magazine_t;
+
+typedef struct thread_cache {
+    allocator_t* owner;
+    struct thread_cache* next; // список всех кэшей аллокатора
+    struct thread_cache* prev;
+    tcache_magazine_t magazines[TCACHE_MAX_CLASSES];
+    class_counters_t counters; // статистика потока, см. tcache_collect
+} thread_cache_t;
+
+static void counters_merge(class_counters_t* sum, class_counters_t* counters) {
+    for (int i = 0; i < TCACHE_MAX_CLASSES; i++) {
+        sum->allocs[i] += COUNTER_READ(counters->allocs[i]);
+        sum->frees[i] += COUNTER_READ(counters->frees[i]);
+    }
+    sum->requested += COUNTER_READ(counters->requested);
+}
+
+static void tcache_flush_all(thread_cache_t* tc) {
+    for (int i = 0; i < TCACHE_MAX_CLASSES; i++) {
+        tcache_magazine_t* mag = &tc->magazines[i];
+        if (mag->count > 0) {
+            allocator_flush_class(tc->owner, i, mag->slots, mag->count);
+            mag->count = 0;
+        }
+    }
+}
+
+static void tcache_unlink(allocator_t* alloc, thread_cache_t* tc) {
+    if (tc->prev) {
+        tc->prev->next = tc->next;
+    } else {
+        alloc->tcaches = tc->next;
+    }
+    if (tc->next) {
+        tc->next->prev = tc->prev;
+    }
+}
+
+// деструктор ключа: поток завершился, возвращаем его блоки
+static void tcache_thread_exit(void* arg) {
+    thread_cache_t* tc = (thread_cache_t*)arg;
+    allocator_t* alloc = tc->owner;
+
+    tcache_flush_all(tc);
+
+    pthread_mutex_lock(&alloc->lock);
+    tcache_unlink(alloc, tc);
+    counters_merge(&alloc->retired, &tc->counters);
+    pthread_mutex_unlock(&alloc->lock);
+
+    allocator_unmap(tc, sizeof(thread_cache_t));
+}
+
+static thread_cache_t* tcache_create(allocator_t* alloc) {
+    thread_cache_t* tc = allocator_map(sizeof(thread_cache_t), 0);
+    if (!tc) return NULL;
+
+    tc->owner = alloc;
+
+    // без ключа деструктор потока кэш не найдёт: он бы утёк вместе со
+    // счётчиками, поэтому такой поток работает прямым путём
+    if (pthread_setspecific(alloc->tcache_key, tc) != 0) {
+        allocator_unmap(tc, sizeof(thread_cache_t));
+        return NULL;
+    }
+
+    pthread_mutex_lock(&alloc->lock);
+    tc->next = alloc->tcaches;
+    if (alloc->tcaches) {
+        alloc->tcaches->prev = tc;
+    }
+    alloc->tcaches = tc;
+    pthread_mutex_unlock(&alloc->lock);
+
+    return tc;
+}
+
+static inline thread_cache_t* tcache_get(allocator_t* alloc) {
+    thread_cache_t* tc = pthread_getspecific(alloc->tcache_key);
+    if (!tc) {
+        tc = tcache_create(alloc);
+    }
+    return tc;
+}
+
+bool tcache_init(allocator_t* alloc) {
+    alloc->tcaches = NULL;
+    return pthread_key_create(&alloc->tcache_key, tcache_thread_exit) == 0;
+}
+
+// вызывается при уничтожении аллокатора: блоки в магазинах
+// принадлежат его куче, поэтому освобождаем только сами кэши
+void tcache_teardown(allocator_t* alloc) {
+    pthread_key_delete(alloc->tcache_key);
+
+    thread_cache_t* tc = alloc->tcaches;
+    while (tc) {
+        thread_cache_t* next = tc->next;
+        allocator_unmap(tc, sizeof(thread_cache_t));
+        tc = next;
+    }
+    alloc->tcaches = NULL;
+}
+
+// Пачка из магазина; крупные пачки идут мимо магазина прямо из реализации
+size_t tcache_alloc_batch(allocator_t* alloc, int class_idx, size_t size, void** ptrs, size_t count) {
+    thread_cache_t* tc = tcache_get(alloc);
+    if (!tc) {
+        size_t filled = allocator_refill_class(alloc, class_idx, ptrs, count);
+        SHARED_COUNTER_ADD(alloc->direct.allocs, filled);
+        SHARED_COUNTER_ADD(alloc->direct.requested, filled * size);
+        SHARED_COUNTER_ADD(alloc->direct.reserved, filled * allocator_class_size(alloc, class_idx));
+        return filled;
+    }
+
+    tcache_magazine_t* mag = &tc->magazines[class_idx];
+    size_t filled = 0;
+    while (filled < count) {
+        if (mag->count == 0) {
+            size_t want = count - filled;
+            if (want >= TCACHE_BATCH) {
+                filled += allocator_refill_class(alloc, class_idx, ptrs + filled, want);
+                break;
+            }
+            mag->count = allocator_refill_class(alloc, class_idx, mag->slots, TCACHE_BATCH);
+            if (mag->count == 0) {
+                break;
+            }
+        }
+
+        size_t take = mag->count < count - filled ? mag->count : count - filled;
+        mag->count -= take;
+        memcpy(ptrs + filled, mag->slots + mag->count, take * sizeof(void*));
+        filled += take;
+    }
+
+    COUNTER_ADD(tc->counters.allocs[class_idx], filled);
+    COUNTER_ADD(tc->counters.requested, filled * size);
+    return filled;
+}
+
+// Пачка в магазин; то, что в него не помещается, сразу уходит в реализацию
+void tcache_free_batch(allocator_t* alloc, int class_idx, void** ptrs, size_t count) {
+    thread_cache_t* tc = tcache_get(alloc);
+    if (!tc) {
+        SHARED_COUNTER_ADD(alloc->direct.frees, count);
+        SHARED_COUNTER_ADD(alloc->direct.released, count * allocator_class_size(alloc, class_idx));
+        allocator_flush_class(alloc, class_idx, ptrs, count);
+        return;
+    }
+
+    tcache_magazine_t* mag = &tc->magazines[class_idx];
+    size_t room = TCACHE_MAGAZINE_SIZE - mag->count;
+    size_t keep = count < room ? count : room;
+    memcpy(mag->slots + mag->count, ptrs, keep * sizeof(void*));
+    mag->count += keep;
+    if (keep < count) {
+        allocator_flush_class(alloc, class_idx, ptrs + keep, count - keep);
+    }
+
+    COUNTER_ADD(tc->counters.frees[class_idx], count);
+}
+
+void tcache_flush(allocator_t* alloc) {
+    thread_cache_t* tc = pthread_getspecific(alloc->tcache_key);
+    if (tc) {
+        tcache_flush_all(tc);
+    }
+}
+
+void tcache_collect(allocator_t* alloc, class_counters_t* sum) {
+    for (thread_cache_t* tc = alloc->tcaches; tc; tc = tc->next) {
+        counters_merge(sum, &tc->counters);
+    }
+}
+
+void* tcache_alloc(allocator_t* alloc, int class_idx, size_t size) {
+    thread_cache_t* tc = tcache_get(alloc);
+    if (!tc) {
+        // без кэша счётчики класса недоступны, считаем как прямой путь:
+        // блок может вернуться через магазин другого потока, поэтому размер
+        // класса входит в reserved, а освобождение без кэша - в released
+        void* ptr = NULL;
+        if (allocator_refill_class(alloc, class_idx, &ptr, 1)) {
+            SHARED_COUNTER_ADD(alloc->direct.allocs, 1);
+            SHARED_COUNTER_ADD(alloc->direct.requested, size);
+            SHARED_COUNTER_ADD(alloc->direct.reserved, allocator_class_size(alloc, class_idx));
+        }
+        return ptr;
+    }
+
+    tcache_magazine_t* mag = &tc->magazines[class_idx];
+    if (mag->count == 0) {
+        mag->count = allocator_refill_class(alloc, class_idx, mag->slots, TCACHE_BATCH);
+        if (mag->count == 0) {
+            return NULL;
+        }
+    }
+
+    COUNTER_ADD(tc->counters.allocs[class_idx], 1);
+    COUNTER_ADD(tc->counters.requested, size);
+    return mag->slots[--mag->count];
+}
+
+void tcache_free(allocator_t* alloc, int class_idx, void* ptr) {
+    thread_cache_t* tc = tcache_get(alloc);
+    if (!tc) {
+        SHARED_COUNTER_ADD(alloc->direct.frees, 1);
+        SHARED_COUNTER_ADD(alloc->direct.released, allocator_class_size(alloc, class_idx));
+        allocator_flush_class(alloc, class_idx, &ptr, 1);
+        return;
+    }
+
+    tcache_magazine_t* mag = &tc->magazines[class_idx];
+    if (mag->count == TCACHE_MAGAZINE_SIZE) {
+        // сбрасываем самые старые блоки, горячие остаются на вершине
+        allocator_flush_class(alloc, class_idx, mag->slots, TCACHE_BATCH);
+        memmove(mag->slots, mag->slots + TCACHE_BATCH,
+                (TCACHE_MAGAZINE_SIZE - TCACHE_BATCH) * sizeof(void*));
+        mag->count -= TCACHE_BATCH;
+    }
+
+    mag->slots[mag->count++] = ptr;
+    COUNTER_ADD(tc->counters.frees[class_idx], 1);
+}
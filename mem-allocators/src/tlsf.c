@@ -0,0 +1,368 @@
+#include "../include/tlsf.h"
+#include "../include/allocator_internal.h"
+#include <stdint.h>
+#include <string.h>
+
+#define TLSF_ALIGN_LOG2 4
+#define TLSF_ALIGN ((size_t)1 << TLSF_ALIGN_LOG2) // как у malloc на x86-64
+// блоки меньше TLSF_SMALL_BLOCK лежат в списках нулевого первого уровня
+// с шагом TLSF_ALIGN, дальше каждый уровень - степень двойки
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK ((size_t)1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+#define TLSF_PAGE_SIZE 4096
+
+#define BLOCK_FREE ((size_t)1)
+#define PREV_FREE ((size_t)2) // предыдущий блок свободен, prev_size действителен
+#define SIZE_MASK (~(TLSF_ALIGN - 1))
+
+// Граничные теги: размер предыдущего свободного блока лежит в заголовке
+// следующего, поэтому при освобождении оба соседа находятся за O(1) и
+// сливаются сразу. Ссылки списка есть только у свободных блоков
+typedef struct tlsf_block {
+    size_t prev_size;
+    size_t size; // размер с заголовком | BLOCK_FREE | PREV_FREE
+    struct tlsf_block* next_free;
+    struct tlsf_block* prev_free;
+} tlsf_block_t;
+
+#define HEADER_SIZE offsetof(tlsf_block_t, next_free)
+#define MIN_BLOCK_SIZE sizeof(tlsf_block_t)
+
+typedef struct {
+    allocator_t base;
+    char* heap; // заранее резервируем участок памяти
+    size_t heap_size;
+    uint32_t fl_bitmap; // бит fl - на уровне fl есть непустой список
+    uint32_t sl_bitmap[TLSF_FL_COUNT]; // бит sl - список [fl][sl] непуст
+    tlsf_block_t* free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    size_t used; // байт в занятых блоках
+    size_t peak_used;
+    size_t free_bytes;
+    size_t free_blocks;
+} tlsf_allocator_t;
+
+static inline size_t block_size(const tlsf_block_t* block) {
+    return block->size & SIZE_MASK;
+}
+
+static inline tlsf_block_t* next_block(tlsf_block_t* block) {
+    return (tlsf_block_t*)((char*)block + block_size(block));
+}
+
+static inline tlsf_block_t* block_of(void* ptr) {
+    return (tlsf_block_t*)((char*)ptr - HEADER_SIZE);
+}
+
+// размер блока с заголовком под size байт данных
+static inline size_t total_size(size_t size) {
+    size_t total = (size + HEADER_SIZE + TLSF_ALIGN - 1) & SIZE_MASK;
+    return total < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : total;
+}
+
+// список, в котором лежит свободный блок размера size
+static inline void mapping(size_t size, int* fl, int* sl) {
+    if (size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size >> TLSF_ALIGN_LOG2);
+        return;
+    }
+    int lg = 63 - __builtin_clzl(size);
+    *fl = lg - TLSF_FL_SHIFT + 1;
+    *sl = (int)(size >> (lg - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+}
+
+// соседние свободные блоки всегда слиты, поэтому предыдущий блок занят
+static void insert_free(tlsf_allocator_t* tlsf, tlsf_block_t* block, size_t size) {
+    block->size = size | BLOCK_FREE;
+    tlsf_block_t* next = next_block(block);
+    next->prev_size = size;
+    next->size |= PREV_FREE;
+
+    int fl, sl;
+    mapping(size, &fl, &sl);
+    tlsf_block_t** head = &tlsf->free_lists[fl][sl];
+    block->prev_free = NULL;
+    block->next_free = *head;
+    if (*head) {
+        (*head)->prev_free = block;
+    }
+    *head = block;
+    tlsf->fl_bitmap |= 1u << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+    tlsf->free_bytes += size;
+    tlsf->free_blocks++;
+}
+
+static void remove_free(tlsf_allocator_t* tlsf, tlsf_block_t* block) {
+    size_t size = block_size(block);
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        int fl, sl;
+        mapping(size, &fl, &sl);
+        tlsf->free_lists[fl][sl] = block->next_free;
+        if (!block->next_free) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (!tlsf->sl_bitmap[fl]) {
+                tlsf->fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    if (block->next_free) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    tlsf->free_bytes -= size;
+    tlsf->free_blocks--;
+}
+
+// Good-fit за O(1): size округляется вверх до начала следующего списка,
+// тогда подходит голова первого непустого списка не меньше него - его
+// находят две инструкции ctz по битовым картам, без прохода по блокам
+static tlsf_block_t* find_free(tlsf_allocator_t* tlsf, size_t size) {
+    if (size >= TLSF_SMALL_BLOCK) {
+        size += ((size_t)1 << (63 - __builtin_clzl(size) - TLSF_SL_LOG2)) - 1;
+    }
+    int fl, sl;
+    mapping(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+
+    uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+    return tlsf->free_lists[fl][__builtin_ctz(sl_map)];
+}
+
+// отрезает от блока хвост сверх size, если тот не меньше MIN_BLOCK_SIZE;
+// хвост сливается со свободным соседом справа и уходит в списки
+static void split_tail(tlsf_allocator_t* tlsf, tlsf_block_t* block, size_t size) {
+    size_t available = block_size(block);
+    if (available - size < MIN_BLOCK_SIZE) {
+        return;
+    }
+    block->size = size | (block->size & PREV_FREE);
+    tlsf_block_t* tail = next_block(block);
+    size_t tail_size = available - size;
+    tlsf_block_t* next = (tlsf_block_t*)((char*)tail + tail_size);
+    if (next->size & BLOCK_FREE) {
+        remove_free(tlsf, next);
+        tail_size += block_size(next);
+    }
+    insert_free(tlsf, tail, tail_size);
+}
+
+static void account_used(tlsf_allocator_t* tlsf, size_t old_size, size_t new_size) {
+    tlsf->used = tlsf->used - old_size + new_size;
+    if (tlsf->used > tlsf->peak_used) {
+        tlsf->peak_used = tlsf->used;
+    }
+}
+
+// помечает уже снятый со списков блок занятым и отрезает лишнее
+static void* use_block(tlsf_allocator_t* tlsf, tlsf_block_t* block, size_t size) {
+    block->size &= ~BLOCK_FREE;
+    next_block(block)->size &= ~PREV_FREE;
+    split_tail(tlsf, block, size);
+    account_used(tlsf, 0, block_size(block));
+    return (char*)block + HEADER_SIZE;
+}
+
+allocator_t* tlsf_create(size_t heap_size) {
+    heap_size &= SIZE_MASK;
+    if (heap_size < MIN_BLOCK_SIZE + HEADER_SIZE || heap_size >= (size_t)1 << TLSF_FL_MAX) {
+        return NULL;
+    }
+
+    tlsf_allocator_t* tlsf = allocator_map(sizeof(tlsf_allocator_t), 0);
+    if (!tlsf) {
+        return NULL;
+    }
+    tlsf->heap = allocator_map(heap_size, 0);
+    if (!tlsf->heap) {
+        allocator_unmap(tlsf, sizeof(tlsf_allocator_t));
+        return NULL;
+    }
+    tlsf->base.type = ALLOCATOR_TLSF;
+    tlsf->heap_size = heap_size;
+
+    // в конце кучи - занятый блок нулевого размера: у любого настоящего
+    // блока есть сосед справа, и проверять границу кучи не нужно
+    tlsf_block_t* sentinel = (tlsf_block_t*)(tlsf->heap + heap_size - HEADER_SIZE);
+    sentinel->size = 0;
+    insert_free(tlsf, (tlsf_block_t*)tlsf->heap, heap_size - HEADER_SIZE);
+
+    return (allocator_t*)tlsf;
+}
+
+void tlsf_destroy(allocator_t* alloc) {
+    if (!alloc) return;
+
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    allocator_unmap(tlsf->heap, tlsf->heap_size);
+    allocator_unmap(tlsf, sizeof(tlsf_allocator_t));
+}
+
+void* tlsf_alloc(allocator_t* alloc, size_t size) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+#ifdef ALLOCATOR_CACHE_ALIGNED
+    // как у размерных классов: объекты от линии кэша до SIZE_CLASS_MAX
+    // кратны ей и выровнены по ней
+    if (size >= CACHE_LINE_SIZE && size <= SIZE_CLASS_MAX) {
+        size = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+        return tlsf_alloc_aligned(alloc, size, CACHE_LINE_SIZE);
+    }
+#endif
+    if (size == 0 || size > tlsf->heap_size) {
+        return NULL;
+    }
+    size_t total = total_size(size);
+    tlsf_block_t* block = find_free(tlsf, total);
+    if (!block) {
+        return NULL;
+    }
+    remove_free(tlsf, block);
+    return use_block(tlsf, block, total);
+}
+
+void* tlsf_alloc_aligned(allocator_t* alloc, size_t size, size_t alignment) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    if (alignment <= TLSF_ALIGN) {
+        return tlsf_alloc(alloc, size);
+    }
+    if (size == 0 || size > tlsf->heap_size) {
+        return NULL;
+    }
+
+    // запас на любой сдвиг данных и на отрезанный спереди блок: поиск
+    // остаётся одним обращением к битовым картам
+    size_t total = total_size(size);
+    tlsf_block_t* block = find_free(tlsf, total + alignment + MIN_BLOCK_SIZE);
+    if (!block) {
+        return NULL;
+    }
+    remove_free(tlsf, block);
+
+    uintptr_t data = ((uintptr_t)block + HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    size_t lead = data - HEADER_SIZE - (uintptr_t)block;
+    if (lead != 0 && lead < MIN_BLOCK_SIZE) {
+        lead += alignment;
+    }
+    if (lead) {
+        tlsf_block_t* aligned = (tlsf_block_t*)((char*)block + lead);
+        aligned->size = block_size(block) - lead;
+        insert_free(tlsf, block, lead);
+        block = aligned;
+    }
+    return use_block(tlsf, block, total);
+}
+
+void tlsf_free(allocator_t* alloc, void* ptr) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    tlsf_block_t* block = block_of(ptr);
+    size_t size = block_size(block);
+    tlsf_block_t* next = next_block(block);
+    account_used(tlsf, size, 0);
+
+    if (block->size & PREV_FREE) {
+        block = (tlsf_block_t*)((char*)block - block->prev_size);
+        remove_free(tlsf, block);
+        size += block_size(block);
+    }
+    if (next->size & BLOCK_FREE) {
+        remove_free(tlsf, next);
+        size += block_size(next);
+    }
+    insert_free(tlsf, block, size);
+}
+
+void* tlsf_resize(allocator_t* alloc, void* ptr, size_t new_size) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    if (new_size > tlsf->heap_size) {
+        return NULL;
+    }
+    tlsf_block_t* block = block_of(ptr);
+    size_t size = block_size(block);
+    size_t total = total_size(new_size);
+
+    if (total > size) {
+        tlsf_block_t* next = next_block(block);
+        if (!(next->size & BLOCK_FREE) || size + block_size(next) < total) {
+            return NULL;
+        }
+        remove_free(tlsf, next);
+        block->size += block_size(next);
+        next_block(block)->size &= ~PREV_FREE;
+    }
+    split_tail(tlsf, block, total);
+    account_used(tlsf, size, block_size(block));
+    return ptr;
+}
+
+size_t tlsf_usable_size(allocator_t* alloc, void* ptr) {
+    (void)alloc;
+    return block_size(block_of(ptr)) - HEADER_SIZE;
+}
+
+bool tlsf_owns(allocator_t* alloc, void* ptr) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    return (char*)ptr >= tlsf->heap && (char*)ptr < tlsf->heap + tlsf->heap_size;
+}
+
+size_t tlsf_large_threshold(allocator_t* alloc) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    return tlsf->heap_size / 8;
+}
+
+size_t tlsf_trim(allocator_t* alloc) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    size_t released = 0;
+    for (int fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            for (tlsf_block_t* block = tlsf->free_lists[fl][sl]; block; block = block->next_free) {
+                uintptr_t start = ((uintptr_t)block + MIN_BLOCK_SIZE + TLSF_PAGE_SIZE - 1) &
+                                  ~(uintptr_t)(TLSF_PAGE_SIZE - 1);
+                uintptr_t end = ((uintptr_t)block + block_size(block)) & ~(uintptr_t)(TLSF_PAGE_SIZE - 1);
+                if (end > start) {
+                    released += allocator_release_pages((void*)start, end - start);
+                }
+            }
+        }
+    }
+    return released;
+}
+
+void tlsf_get_stats(allocator_t* alloc, allocator_stats_t* stats) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+
+    stats->heap_size = tlsf->heap_size;
+    stats->free_bytes = tlsf->free_bytes;
+    stats->free_blocks = tlsf->free_blocks;
+    stats->peak_allocated = tlsf->peak_used;
+
+    // наибольший блок - в старшем непустом списке, но внутри списка
+    // размеры различаются: его просматриваем целиком
+    size_t largest = 0;
+    if (tlsf->fl_bitmap) {
+        int fl = 31 - __builtin_clz(tlsf->fl_bitmap);
+        int sl = 31 - __builtin_clz(tlsf->sl_bitmap[fl]);
+        for (tlsf_block_t* block = tlsf->free_lists[fl][sl]; block; block = block->next_free) {
+            if (block_size(block) > largest) {
+                largest = block_size(block);
+            }
+        }
+    }
+    stats->largest_free_block = largest;
+}
+
+void tlsf_reset_peak(allocator_t* alloc) {
+    tlsf_allocator_t* tlsf = (tlsf_allocator_t*)alloc;
+    tlsf->peak_used = tlsf->used;
+}
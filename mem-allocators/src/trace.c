@@ -0,0 +1,342 @@
+#include "../include/trace.h"
+#include "../include/allocator_internal.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_BUFFER_RECORDS 4096
+#define TRACE_MAP_INITIAL 4096 // начальная ёмкость таблицы адресов (степень двойки)
+
+// живой объект: адрес -> номер; пустой слот - address == 0
+typedef struct {
+    uintptr_t address;
+    uint32_t object;
+} trace_slot_t;
+
+struct trace_recorder {
+    pthread_mutex_t lock;
+    int fd;
+    bool finished;
+    uint64_t start_ns;
+    uint64_t records;
+    uint32_t objects; // выдано номеров
+    uint32_t threads;
+
+    // открытая адресация с линейным пробированием
+    trace_slot_t* map;
+    size_t map_capacity;
+    size_t map_count;
+
+    // номера освобождённых объектов (стек)
+    uint32_t* free_objects;
+    size_t free_count;
+    size_t free_capacity;
+
+    size_t buffered;
+    trace_record_t buffer[TRACE_BUFFER_RECORDS];
+};
+
+// номер потока для записей: выдаётся при первом обращении, 0 - ещё нет
+static uint32_t trace_next_thread;
+static __thread uint32_t trace_thread;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline size_t slot_of(uintptr_t address, size_t capacity) {
+    // младшие биты адресов одинаковы из-за выравнивания
+    return (size_t)(((address >> 4) * 0x9E3779B97F4A7C15ull) >> 17) & (capacity - 1);
+}
+
+static bool write_all(int fd, const void* data, size_t size, off_t offset, bool positioned) {
+    const char* p = data;
+    while (size > 0) {
+        ssize_t written = positioned ? pwrite(fd, p, size, offset) : write(fd, p, size);
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        offset += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static void flush_buffer(trace_recorder_t* rec) {
+    if (rec->buffered > 0 &&
+        !write_all(rec->fd, rec->buffer, rec->buffered * sizeof(trace_record_t), 0, false)) {
+        rec->finished = true; // диск кончился - дальше не пишем
+    }
+    rec->buffered = 0;
+}
+
+static void append(trace_recorder_t* rec, trace_op_t op, uint32_t object, size_t size, size_t alignment) {
+    if (trace_thread == 0) {
+        trace_thread = __atomic_add_fetch(&trace_next_thread, 1, __ATOMIC_RELAXED);
+    }
+    uint32_t thread = trace_thread - 1;
+    if (thread >= rec->threads) {
+        rec->threads = thread + 1;
+    }
+
+    trace_record_t* r = &rec->buffer[rec->buffered++];
+    r->timestamp = now_ns() - rec->start_ns;
+    r->size = size;
+    r->object = object;
+    r->thread = (uint16_t)thread;
+    r->op = (uint8_t)op;
+    r->align_shift = 0;
+    if (alignment > ALLOCATOR_MIN_ALIGNMENT) {
+        while (((size_t)1 << r->align_shift) < alignment) {
+            r->align_shift++;
+        }
+    }
+    rec->records++;
+
+    if (rec->buffered == TRACE_BUFFER_RECORDS) {
+        flush_buffer(rec);
+    }
+}
+
+static bool map_grow(trace_recorder_t* rec) {
+    size_t capacity = rec->map_capacity * 2;
+    trace_slot_t* map = allocator_map(capacity * sizeof(trace_slot_t), 0);
+    if (!map) return false;
+
+    for (size_t i = 0; i < rec->map_capacity; i++) {
+        trace_slot_t* slot = &rec->map[i];
+        if (slot->address) {
+            size_t j = slot_of(slot->address, capacity);
+            while (map[j].address) {
+                j = (j + 1) & (capacity - 1);
+            }
+            map[j] = *slot;
+        }
+    }
+    allocator_unmap(rec->map, rec->map_capacity * sizeof(trace_slot_t));
+    rec->map = map;
+    rec->map_capacity = capacity;
+    return true;
+}
+
+static bool map_insert(trace_recorder_t* rec, void* ptr, uint32_t object) {
+    // заполнение не больше половины
+    if ((rec->map_count + 1) * 2 > rec->map_capacity && !map_grow(rec)) {
+        return false;
+    }
+    size_t mask = rec->map_capacity - 1;
+    size_t i = slot_of((uintptr_t)ptr, rec->map_capacity);
+    while (rec->map[i].address && rec->map[i].address != (uintptr_t)ptr) {
+        i = (i + 1) & mask;
+    }
+    if (!rec->map[i].address) {
+        rec->map_count++;
+    }
+    rec->map[i].address = (uintptr_t)ptr;
+    rec->map[i].object = object;
+    return true;
+}
+
+// удаляет адрес и возвращает номер его объекта; false - адрес не записан
+// (выделен до начала записи)
+static bool map_remove(trace_recorder_t* rec, void* ptr, uint32_t* object) {
+    size_t mask = rec->map_capacity - 1;
+    size_t i = slot_of((uintptr_t)ptr, rec->map_capacity);
+    while (rec->map[i].address != (uintptr_t)ptr) {
+        if (!rec->map[i].address) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    *object = rec->map[i].object;
+    rec->map_count--;
+
+    // сдвиг назад вместо надгробий: следующие элементы цепочки, чей
+    // домашний слот не лежит в (i, j], переезжают в освободившийся слот
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!rec->map[j].address) {
+            break;
+        }
+        size_t home = slot_of(rec->map[j].address, rec->map_capacity);
+        bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            rec->map[i] = rec->map[j];
+            i = j;
+        }
+    }
+    rec->map[i].address = 0;
+    return true;
+}
+
+static bool release_object(trace_recorder_t* rec, uint32_t object) {
+    if (rec->free_count == rec->free_capacity) {
+        size_t capacity = rec->free_capacity ? rec->free_capacity * 2 : 1024;
+        uint32_t* ids = allocator_map(capacity * sizeof(uint32_t), 0);
+        if (!ids) return false;
+        if (rec->free_objects) {
+            memcpy(ids, rec->free_objects, rec->free_count * sizeof(uint32_t));
+            allocator_unmap(rec->free_objects, rec->free_capacity * sizeof(uint32_t));
+        }
+        rec->free_objects = ids;
+        rec->free_capacity = capacity;
+    }
+    rec->free_objects[rec->free_count++] = object;
+    return true;
+}
+
+static uint32_t acquire_object(trace_recorder_t* rec) {
+    return rec->free_count > 0 ? rec->free_objects[--rec->free_count] : rec->objects++;
+}
+
+static void record_alloc_locked(trace_recorder_t* rec, void* ptr, size_t size, size_t alignment) {
+    uint32_t object = acquire_object(rec);
+    if (!map_insert(rec, ptr, object)) {
+        rec->finished = true;
+        return;
+    }
+    append(rec, TRACE_ALLOC, object, size, alignment);
+}
+
+trace_recorder_t* trace_recorder_create(const char* path) {
+    trace_recorder_t* rec = allocator_map(sizeof(trace_recorder_t), 0);
+    if (!rec) return NULL;
+
+    rec->map_capacity = TRACE_MAP_INITIAL;
+    rec->map = allocator_map(rec->map_capacity * sizeof(trace_slot_t), 0);
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    // место под заголовок, настоящий пишется в trace_recorder_finish
+    trace_header_t header = { .magic = TRACE_MAGIC, .version = TRACE_VERSION };
+    if (!rec->map || rec->fd < 0 || !write_all(rec->fd, &header, sizeof(header), 0, false)) {
+        if (rec->fd >= 0) {
+            close(rec->fd);
+        }
+        allocator_unmap(rec->map, rec->map_capacity * sizeof(trace_slot_t));
+        allocator_unmap(rec, sizeof(trace_recorder_t));
+        return NULL;
+    }
+
+    pthread_mutex_init(&rec->lock, NULL);
+    rec->start_ns = now_ns();
+    return rec;
+}
+
+void trace_recorder_finish(trace_recorder_t* rec) {
+    if (!rec) return;
+
+    pthread_mutex_lock(&rec->lock);
+    if (rec->fd >= 0) {
+        bool failed = rec->finished;
+        flush_buffer(rec);
+        trace_header_t header = {
+            .magic = TRACE_MAGIC,
+            .version = TRACE_VERSION,
+            .records = rec->records,
+            .objects = rec->objects,
+            .threads = rec->threads
+        };
+        if (failed || rec->finished) {
+            header.magic = 0; // неполная трасса не должна читаться как целая
+        }
+        write_all(rec->fd, &header, sizeof(header), 0, true);
+        close(rec->fd);
+        rec->fd = -1;
+        rec->finished = true;
+    }
+    pthread_mutex_unlock(&rec->lock);
+}
+
+void trace_recorder_destroy(trace_recorder_t* rec) {
+    if (!rec) return;
+
+    trace_recorder_finish(rec);
+    pthread_mutex_destroy(&rec->lock);
+    allocator_unmap(rec->map, rec->map_capacity * sizeof(trace_slot_t));
+    allocator_unmap(rec->free_objects, rec->free_capacity * sizeof(uint32_t));
+    allocator_unmap(rec, sizeof(trace_recorder_t));
+}
+
+void trace_record_alloc(trace_recorder_t* rec, void* ptr, size_t size, size_t alignment) {
+    if (!ptr) return;
+
+    pthread_mutex_lock(&rec->lock);
+    if (!rec->finished) {
+        record_alloc_locked(rec, ptr, size, alignment);
+    }
+    pthread_mutex_unlock(&rec->lock);
+}
+
+void trace_record_free(trace_recorder_t* rec, void* ptr, size_t size) {
+    if (!ptr) return;
+
+    pthread_mutex_lock(&rec->lock);
+    uint32_t object;
+    if (!rec->finished && map_remove(rec, ptr, &object)) {
+        append(rec, size ? TRACE_FREE_SIZED : TRACE_FREE, object, size, 0);
+        if (!release_object(rec, object)) {
+            rec->finished = true;
+        }
+    }
+    pthread_mutex_unlock(&rec->lock);
+}
+
+void trace_realloc_begin(trace_recorder_t* rec) {
+    pthread_mutex_lock(&rec->lock);
+}
+
+void trace_realloc_end(trace_recorder_t* rec, void* old_ptr, void* new_ptr, size_t size) {
+    // неудачный realloc оставляет старый блок как был
+    if (new_ptr && !rec->finished) {
+        uint32_t object;
+        if (!map_remove(rec, old_ptr, &object)) {
+            record_alloc_locked(rec, new_ptr, size, 0);
+        } else if (!map_insert(rec, new_ptr, object)) {
+            rec->finished = true;
+        } else {
+            append(rec, TRACE_REALLOC, object, size, 0);
+        }
+    }
+    pthread_mutex_unlock(&rec->lock);
+}
+
+trace_t* trace_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    trace_t* trace = calloc(1, sizeof(trace_t));
+    if (!trace || fread(&trace->header, sizeof(trace_header_t), 1, f) != 1 ||
+        trace->header.magic != TRACE_MAGIC || trace->header.version != TRACE_VERSION) {
+        free(trace);
+        fclose(f);
+        return NULL;
+    }
+
+    size_t count = trace->header.records;
+    trace->records = malloc((count ? count : 1) * sizeof(trace_record_t));
+    bool valid = trace->records && fread(trace->records, sizeof(trace_record_t), count, f) == count;
+    for (size_t i = 0; valid && i < count; i++) {
+        trace_record_t* r = &trace->records[i];
+        valid = r->op < TRACE_NUM_OPS && r->object < trace->header.objects &&
+                r->thread < trace->header.threads && r->align_shift < 64;
+    }
+    fclose(f);
+
+    if (!valid) {
+        trace_free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+void trace_free(trace_t* trace) {
+    if (!trace) return;
+    free(trace->records);
+    free(trace);
+}
@@ -1,7 +1,13 @@
 #include "../include/allocator.h"
+#include "../include/size_classes.h"
+#include "../include/trace.h"
+#include "../include/objcache.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define TEST_HEAP_SIZE (1024 * 1024)  /* 1 MB */
 
@@ -155,10 +161,1063 @@ void test_edge_cases(allocator_type_t type, const char* name) {
     TEST_PASS();
 }
 
+/* Test that freed neighbours merge back into one large block */
+void test_coalescing(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    void* ptrs[256];
+    int count = 0;
+    while (count < 256) {
+        ptrs[count] = allocator_alloc(alloc, 5000);
+        if (!ptrs[count]) break;
+        count++;
+    }
+    ASSERT(count > 100, "Failed to fill the heap");
+    
+    /* Освобождаем через один, потом остальные: каждое второе
+     * освобождение сливается с обоими соседями */
+    for (int i = 0; i < count; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    void* big = allocator_alloc(alloc, 2 * 5000);
+    ASSERT(big == NULL, "Heap should be fragmented before coalescing");
+    for (int i = 1; i < count; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    
+    big = allocator_alloc(alloc, TEST_HEAP_SIZE / 2);
+    ASSERT(big != NULL, "Freed blocks were not coalesced");
+    allocator_free(alloc, big);
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define BIN_DEPTH 17
+
+/* Test that a fitting block deep in its own bin is found when no higher bin has blocks */
+void test_bin_search(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    /* подходящий блок оказывается последним в корзине, перед ним
+     * BIN_DEPTH блоков той же корзины, которые малы для запроса;
+     * прослойки не дают свободным блокам слиться */
+    void* pins[BIN_DEPTH + 1];
+    void* small[BIN_DEPTH];
+    void* fit = allocator_alloc(alloc, 5000);
+    pins[0] = allocator_alloc(alloc, 3000);
+    ASSERT(fit != NULL && pins[0] != NULL, "Failed to allocate memory");
+    for (int i = 0; i < BIN_DEPTH; i++) {
+        small[i] = allocator_alloc(alloc, 4200);
+        pins[i + 1] = allocator_alloc(alloc, 3000);
+        ASSERT(small[i] != NULL && pins[i + 1] != NULL, "Failed to allocate memory");
+    }
+    
+    /* остаток кучи занят, корзины выше пусты */
+    void* rest[512];
+    int count = 0;
+    while (count < 512) {
+        rest[count] = allocator_alloc(alloc, 3000);
+        if (!rest[count]) break;
+        count++;
+    }
+    ASSERT(count < 512, "Failed to fill the heap");
+    
+    allocator_free(alloc, fit);
+    for (int i = 0; i < BIN_DEPTH; i++) {
+        allocator_free(alloc, small[i]);
+    }
+    
+    void* ptr = allocator_alloc(alloc, 4600);
+    ASSERT(ptr != NULL, "Fitting free block was not found");
+    allocator_free(alloc, ptr);
+    
+    for (int i = 0; i < count; i++) {
+        allocator_free(alloc, rest[i]);
+    }
+    for (int i = 0; i <= BIN_DEPTH; i++) {
+        allocator_free(alloc, pins[i]);
+    }
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test O(1) size class lookup against a linear scan of the table */
+void test_size_classes(const char* name) {
+    TEST(name);
+    
+    ASSERT(SIZE_CLASSES[0] == SIZE_CLASS_MIN, "First class must be SIZE_CLASS_MIN");
+    ASSERT(SIZE_CLASSES[NUM_SIZE_CLASSES - 1] == SIZE_CLASS_MAX, "Last class must be SIZE_CLASS_MAX");
+    
+    for (size_t size = 1; size <= SIZE_CLASS_MAX + 1; size++) {
+        size_t rounded = size;
+#ifdef ALLOCATOR_CACHE_ALIGNED
+        /* классы больше линии кэша - только кратные ей */
+        if (size > CACHE_LINE_SIZE) {
+            rounded = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+        }
+#endif
+        int expected = -1;
+        for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+            if (rounded <= SIZE_CLASSES[i]) {
+                expected = i;
+                break;
+            }
+        }
+        ASSERT(size_class_index(size) == expected, "Lookup differs from table scan");
+    }
+    
+    TEST_PASS();
+}
+
+/* Test that usable size covers the request and the class rounding */
+void test_usable_size(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    for (size_t size = 1; size <= 1500; size += 37) {
+        void* ptr = allocator_alloc(alloc, size);
+        ASSERT(ptr != NULL, "Failed to allocate memory");
+        size_t usable = allocator_usable_size(alloc, ptr);
+        ASSERT(usable >= size, "Usable size smaller than request");
+        /* 4 класса на удвоение: потери не больше четверти запроса + заголовок */
+#ifdef ALLOCATOR_CACHE_ALIGNED
+        ASSERT(usable <= size + size / 4 + CACHE_LINE_SIZE, "Size class too coarse");
+#else
+        ASSERT(usable <= size + size / 4 + 32, "Size class too coarse");
+#endif
+        memset(ptr, 0x11, usable);
+        allocator_free(alloc, ptr);
+    }
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define TEST_THREADS 4
+#define TEST_THREAD_OPS 20000
+
+typedef struct {
+    allocator_t* alloc;
+    int id;
+    int errors;
+} thread_test_arg_t;
+
+static void* thread_alloc_free_worker(void* arg) {
+    thread_test_arg_t* t = (thread_test_arg_t*)arg;
+    void* ptrs[64] = {0};
+    size_t sizes[64] = {0};
+    
+    for (int i = 0; i < TEST_THREAD_OPS; i++) {
+        int slot = (i * 7 + t->id) % 64;
+        if (ptrs[slot]) {
+            /* Проверяем, что блок не перезаписан другим потоком */
+            unsigned char* p = ptrs[slot];
+            for (size_t j = 0; j < sizes[slot]; j++) {
+                if (p[j] != (unsigned char)t->id) {
+                    t->errors++;
+                    break;
+                }
+            }
+            allocator_free(t->alloc, ptrs[slot]);
+            ptrs[slot] = NULL;
+        } else {
+            sizes[slot] = 8 + (i % 500);
+            ptrs[slot] = allocator_alloc(t->alloc, sizes[slot]);
+            if (!ptrs[slot]) {
+                t->errors++;
+                continue;
+            }
+            memset(ptrs[slot], t->id, sizes[slot]);
+        }
+    }
+    
+    for (int i = 0; i < 64; i++) {
+        allocator_free(t->alloc, ptrs[i]);
+    }
+    return NULL;
+}
+
+/* Test concurrent allocations through per-thread caches */
+void test_threaded_alloc_free(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    pthread_t threads[TEST_THREADS];
+    thread_test_arg_t args[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        args[i].alloc = alloc;
+        args[i].id = i + 1;
+        args[i].errors = 0;
+        pthread_create(&threads[i], NULL, thread_alloc_free_worker, &args[i]);
+    }
+    
+    int errors = 0;
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+    ASSERT(errors == 0, "Corrupted or failed allocation in worker thread");
+    
+    /* Блоки, возвращённые завершившимися потоками, снова доступны */
+    void* ptr = allocator_alloc(alloc, 100);
+    ASSERT(ptr != NULL, "Failed to allocate after threads exited");
+    allocator_free(alloc, ptr);
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define CROSS_FREE_OBJECTS 4096
+
+typedef struct {
+    allocator_t* alloc;
+    void** ptrs;
+    int begin;
+    int end;
+} cross_free_arg_t;
+
+static void* cross_free_worker(void* arg) {
+    cross_free_arg_t* t = (cross_free_arg_t*)arg;
+    for (int i = t->begin; i < t->end; i++) {
+        allocator_free(t->alloc, t->ptrs[i]);
+    }
+    return NULL;
+}
+
+/* Test frees issued by threads other than the allocating one */
+void test_cross_thread_free(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[CROSS_FREE_OBJECTS];
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < CROSS_FREE_OBJECTS; i++) {
+            ptrs[i] = allocator_alloc(alloc, 48);
+            ASSERT(ptrs[i] != NULL, "Failed to allocate memory");
+            memset(ptrs[i], 0x5A, 48);
+        }
+        
+        pthread_t threads[TEST_THREADS];
+        cross_free_arg_t args[TEST_THREADS];
+        int chunk = CROSS_FREE_OBJECTS / TEST_THREADS;
+        for (int i = 0; i < TEST_THREADS; i++) {
+            args[i].alloc = alloc;
+            args[i].ptrs = ptrs;
+            args[i].begin = i * chunk;
+            args[i].end = (i + 1) * chunk;
+            pthread_create(&threads[i], NULL, cross_free_worker, &args[i]);
+        }
+        for (int i = 0; i < TEST_THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test requests served outside the heap by mmap regions */
+void test_large_objects(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    /* 4 МБ больше всей тестовой кучи */
+    size_t sizes[] = {3000, 200 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    for (int round = 0; round < 3; round++) {
+        void* ptrs[4];
+        for (int i = 0; i < 4; i++) {
+            ptrs[i] = allocator_alloc(alloc, sizes[i]);
+            ASSERT(ptrs[i] != NULL, "Failed to allocate large object");
+            ASSERT(((size_t)ptrs[i] & 15) == 0, "Large object is misaligned");
+            ASSERT(allocator_usable_size(alloc, ptrs[i]) >= sizes[i], "Usable size too small");
+            memset(ptrs[i], 0x77, sizes[i]);
+        }
+        for (int i = 0; i < 4; i++) {
+            unsigned char* p = ptrs[i];
+            ASSERT(p[0] == 0x77 && p[sizes[i] - 1] == 0x77, "Large object overwritten");
+            allocator_free(alloc, ptrs[i]);
+        }
+    }
+    
+    /* закэшированные отображения отдаются при trim */
+    ASSERT(allocator_trim(alloc) >= 4 * 1024 * 1024, "Cached regions were not released");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+static int check_pattern(const unsigned char* p, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != (unsigned char)(i * 31)) return 0;
+    }
+    return 1;
+}
+
+/* Test that realloc keeps contents while growing and shrinking in and out of the heap */
+void test_realloc(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    size_t size = 10;
+    unsigned char* p = allocator_alloc(alloc, size);
+    ASSERT(p != NULL, "Failed to allocate memory");
+    for (size_t i = 0; i < size; i++) p[i] = (unsigned char)(i * 31);
+    
+    /* рост до 2 МБ (за пределы кучи и порога крупных объектов) и обратно */
+    while (size < 2 * 1024 * 1024) {
+        size_t new_size = size * 2 + 3;
+        p = allocator_realloc(alloc, p, new_size);
+        ASSERT(p != NULL, "Failed to grow block");
+        ASSERT(check_pattern(p, size), "Contents lost while growing");
+        for (size_t i = size; i < new_size; i++) p[i] = (unsigned char)(i * 31);
+        size = new_size;
+    }
+    while (size > 8) {
+        size /= 3;
+        p = allocator_realloc(alloc, p, size);
+        ASSERT(p != NULL, "Failed to shrink block");
+        ASSERT(check_pattern(p, size), "Contents lost while shrinking");
+    }
+    
+    /* блок того же класса остаётся на месте */
+    void* q = allocator_realloc(alloc, p, size + 1);
+    ASSERT(q == p, "Realloc within the size class moved the block");
+    
+    ASSERT(allocator_realloc(alloc, q, 0) == NULL, "Realloc to 0 should free");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+static void* stats_worker(void* arg) {
+    allocator_t* alloc = arg;
+    for (int i = 0; i < 1000; i++) {
+        allocator_free(alloc, allocator_alloc(alloc, 40));
+    }
+    return NULL;
+}
+
+/* Test that stats merge per-thread counters and describe the heap */
+void test_stats(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    void* ptrs[100];
+    for (int i = 0; i < 100; i++) {
+        ptrs[i] = allocator_alloc(alloc, 100);
+        ASSERT(ptrs[i] != NULL, "Failed to allocate memory");
+    }
+    void* large = allocator_alloc(alloc, 300 * 1024);
+    ASSERT(large != NULL, "Failed to allocate large object");
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_allocations == 101, "Wrong allocation count");
+    ASSERT(stats.large_allocations == 1, "Wrong large allocation count");
+    ASSERT(stats.bytes_requested == 100 * 100 + 300 * 1024, "Wrong requested bytes");
+    ASSERT(stats.bytes_reserved >= stats.bytes_requested, "Reserved less than requested");
+    ASSERT(stats.current_allocated == stats.bytes_reserved, "Wrong current allocated");
+    ASSERT(stats.heap_size > 0 && stats.free_bytes > 0, "Heap state missing");
+    ASSERT(stats.largest_free_block <= stats.free_bytes, "Largest free block too big");
+    ASSERT(stats.fragmentation >= 0.0 && stats.fragmentation < 1.0, "Bad fragmentation ratio");
+    ASSERT(stats.large_mapped >= 300 * 1024, "Large mapping missing");
+    
+    size_t class_allocs = 0;
+    for (size_t i = 0; i < stats.num_classes; i++) {
+        class_allocs += stats.classes[i].allocations;
+    }
+    ASSERT(class_allocs == 100, "Wrong per-class allocation count");
+    
+    for (int i = 0; i < 100; i++) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    allocator_free(alloc, large);
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_frees == 101 && stats.current_allocated == 0, "Frees not counted");
+    
+    /* счётчики завершившихся потоков сохраняются */
+    allocator_reset_stats(alloc);
+    pthread_t threads[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, stats_worker, alloc);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_allocations == TEST_THREADS * 1000, "Thread counters lost");
+    ASSERT(stats.total_frees == TEST_THREADS * 1000, "Thread frees lost");
+    
+    char buf[8192];
+    FILE* out = fmemopen(buf, sizeof(buf), "w");
+    ASSERT(out != NULL, "fmemopen failed");
+    allocator_dump_stats(alloc, out, ALLOCATOR_STATS_JSON);
+    fclose(out);
+    ASSERT(strstr(buf, "\"total_allocations\": 4000") != NULL, "JSON dump missing counters");
+    ASSERT(strstr(buf, "\"classes\"") != NULL, "JSON dump missing classes");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define BALANCE_SLOTS 256
+#define BALANCE_OPS 20000
+
+/* Test that current_allocated returns to zero after a random alloc/realloc/free mix */
+void test_stats_balance(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[BALANCE_SLOTS];
+    memset(ptrs, 0, sizeof(ptrs));
+    uint32_t seed = 12345;
+    for (int op = 0; op < BALANCE_OPS; op++) {
+        seed = seed * 1103515245 + 12345;
+        int slot = (seed >> 8) % BALANCE_SLOTS;
+        size_t size = 1 + (seed >> 16) % 3000;
+        if (!ptrs[slot]) {
+            ptrs[slot] = allocator_alloc(alloc, size);
+        } else if (seed & 1) {
+            void* resized = allocator_realloc(alloc, ptrs[slot], size);
+            if (resized) {
+                ptrs[slot] = resized;
+            }
+        } else {
+            allocator_free(alloc, ptrs[slot]);
+            ptrs[slot] = NULL;
+        }
+    }
+    for (int i = 0; i < BALANCE_SLOTS; i++) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_allocations == stats.total_frees, "Allocations and frees differ");
+    ASSERT(stats.current_allocated == 0, "Current allocated did not return to zero");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define BATCH_OBJECTS 500
+
+/* Test bulk allocation and free, including mixed sizes in one free batch */
+void test_batch(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[2 * BATCH_OBJECTS];
+    for (int round = 0; round < 5; round++) {
+        size_t got = allocator_alloc_batch(alloc, 72, ptrs, BATCH_OBJECTS);
+        ASSERT(got == BATCH_OBJECTS, "Batch allocation came up short");
+        got = allocator_alloc_batch(alloc, 300, ptrs + BATCH_OBJECTS, BATCH_OBJECTS);
+        ASSERT(got == BATCH_OBJECTS, "Batch allocation came up short");
+        
+        for (int i = 0; i < 2 * BATCH_OBJECTS; i++) {
+            ASSERT(allocator_usable_size(alloc, ptrs[i]) >= (i < BATCH_OBJECTS ? 72u : 300u),
+                   "Batch block too small");
+            memset(ptrs[i], i & 0xFF, i < BATCH_OBJECTS ? 72 : 300);
+        }
+        for (int i = 0; i < 2 * BATCH_OBJECTS; i++) {
+            unsigned char* p = ptrs[i];
+            ASSERT(p[0] == (i & 0xFF) && p[71] == (i & 0xFF), "Batch blocks overlap");
+        }
+        
+        allocator_free_batch(alloc, ptrs, 2 * BATCH_OBJECTS);
+    }
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_allocations == 10 * BATCH_OBJECTS, "Batch allocations not counted");
+    ASSERT(stats.current_allocated == 0, "Batch frees not counted");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test aligned allocation for every supported alignment, class and large sizes */
+void test_aligned_alloc(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static const size_t sizes[] = {1, 24, 100, 1000, 3000, 200000};
+    size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    void* ptrs[64];
+    int count = 0;
+    for (size_t alignment = 1; alignment <= ALLOCATOR_MAX_ALIGNMENT; alignment *= 2) {
+        for (size_t i = 0; i < num_sizes; i++) {
+            void* ptr = allocator_aligned_alloc(alloc, alignment, sizes[i]);
+            ASSERT(ptr != NULL, "Aligned allocation failed");
+            ASSERT((uintptr_t)ptr % alignment == 0, "Block is misaligned");
+            ASSERT(allocator_usable_size(alloc, ptr) >= sizes[i], "Usable size smaller than request");
+            memset(ptr, count & 0xFF, sizes[i]);
+            if (count < 64) {
+                ptrs[count++] = ptr;
+            } else {
+                allocator_free(alloc, ptr);
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    
+    ASSERT(allocator_aligned_alloc(alloc, 3, 64) == NULL, "Non power of two alignment accepted");
+    ASSERT(allocator_aligned_alloc(alloc, 2 * ALLOCATOR_MAX_ALIGNMENT, 64) == NULL,
+           "Alignment above the maximum accepted");
+    
+    /* обычные блоки выровнены минимум по ALLOCATOR_MIN_ALIGNMENT */
+    for (size_t size = 1; size <= 3000; size += 37) {
+        void* ptr = allocator_alloc(alloc, size);
+        ASSERT((uintptr_t)ptr % ALLOCATOR_MIN_ALIGNMENT == 0, "Block below minimum alignment");
+#ifdef ALLOCATOR_CACHE_ALIGNED
+        if (size >= CACHE_LINE_SIZE && size <= SIZE_CLASS_MAX) {
+            ASSERT((uintptr_t)ptr % CACHE_LINE_SIZE == 0, "Class object not cache-line aligned");
+        }
+#endif
+        allocator_free(alloc, ptr);
+    }
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.current_allocated == 0, "Aligned blocks leaked");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define SIZED_OBJECTS 200
+
+/* Test sized free for class, non-class and large sizes, and after realloc */
+void test_free_sized(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[SIZED_OBJECTS];
+    static size_t sizes[SIZED_OBJECTS];
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < SIZED_OBJECTS; i++) {
+            sizes[i] = 1 + (size_t)i * 13;
+            ptrs[i] = allocator_alloc(alloc, sizes[i]);
+            ASSERT(ptrs[i] != NULL, "Failed to allocate memory");
+            memset(ptrs[i], i & 0xFF, sizes[i]);
+        }
+        for (int i = 0; i < SIZED_OBJECTS; i++) {
+            unsigned char* p = ptrs[i];
+            ASSERT(p[0] == (i & 0xFF) && p[sizes[i] - 1] == (i & 0xFF), "Blocks overlap");
+            allocator_free_sized(alloc, ptrs[i], sizes[i]);
+        }
+    }
+    
+    /* освобождённый блок класса сразу переиспользуется */
+    void* ptr = allocator_alloc(alloc, 48);
+    allocator_free_sized(alloc, ptr, 48);
+    ASSERT(allocator_alloc(alloc, 48) == ptr, "Sized free did not reach the class cache");
+    allocator_free_sized(alloc, ptr, 48);
+    
+    /* крупный объект и блок, уменьшенный realloc'ом до размера класса */
+    ptr = allocator_alloc(alloc, 200000);
+    ASSERT(ptr != NULL, "Failed to allocate large object");
+    allocator_free_sized(alloc, ptr, 200000);
+    ptr = allocator_alloc(alloc, 3000);
+    ptr = allocator_realloc(alloc, ptr, 100);
+    ASSERT(ptr != NULL, "Realloc failed");
+    allocator_free_sized(alloc, ptr, 100);
+    
+    /* блок aligned_alloc возвращается в класс, подобранный с учётом выравнивания */
+    allocator_stats_t before, after;
+    allocator_get_stats(alloc, &before);
+    ptr = allocator_aligned_alloc(alloc, 64, 48);
+    ASSERT(ptr != NULL, "Failed to allocate aligned block");
+    allocator_free_aligned_sized(alloc, ptr, 64, 48);
+    void* again = allocator_aligned_alloc(alloc, 64, 48);
+    ASSERT(((uintptr_t)again & 63) == 0, "Aligned block reused from a smaller class");
+    allocator_free_aligned_sized(alloc, again, 64, 48);
+    allocator_get_stats(alloc, &after);
+    /* с заголовками блок ровно размера класса уходит в класс при любом освобождении */
+    size_t checked = after.num_classes;
+#ifndef SEGREGATED_HEADERLESS
+    if (type == ALLOCATOR_SEGREGATED_FREELIST) {
+        checked = 0;
+    }
+#endif
+    for (size_t i = 0; i < checked; i++) {
+        ASSERT(after.classes[i].frees - before.classes[i].frees ==
+               after.classes[i].allocations - before.classes[i].allocations,
+               "Aligned block freed into the wrong class");
+    }
+    
+#ifdef SEGREGATED_HEADERLESS
+    /* объекты класса идут вплотную, без заголовков */
+    if (type == ALLOCATOR_SEGREGATED_FREELIST) {
+        ptr = allocator_alloc(alloc, 16);
+        ASSERT(allocator_usable_size(alloc, ptr) == 16, "Small object carries a header");
+        allocator_free_sized(alloc, ptr, 16);
+    }
+#endif
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_frees == stats.total_allocations, "Sized frees not counted");
+    ASSERT(stats.current_allocated == 0, "Sized frees leaked bytes");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test that the trace recorder logs API calls with dense, reused object ids */
+void test_trace(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_allocators_%d.trace", (int)getpid());
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    trace_recorder_t* rec = trace_recorder_create(path);
+    ASSERT(alloc != NULL && rec != NULL, "Failed to create allocator or recorder");
+    
+    /* блок, выделенный до начала записи, в трассу не попадает */
+    void* before = allocator_alloc(alloc, 64);
+    allocator_set_trace(alloc, rec);
+    allocator_free(alloc, before);
+    
+    void* a = allocator_alloc(alloc, 100);
+    void* b = allocator_aligned_alloc(alloc, 64, 200);
+    a = allocator_realloc(alloc, a, 5000);
+    allocator_free_sized(alloc, b, 200);
+    void* batch[4];
+    ASSERT(allocator_alloc_batch(alloc, 32, batch, 4) == 4, "Batch allocation failed");
+    allocator_free_batch(alloc, batch, 4);
+    allocator_free(alloc, a);
+    
+    allocator_set_trace(alloc, NULL);
+    trace_recorder_destroy(rec);
+    allocator_destroy(alloc);
+    
+    trace_t* trace = trace_load(path);
+    remove(path);
+    ASSERT(trace != NULL, "Failed to load trace");
+    
+    static const struct {
+        trace_op_t op;
+        uint32_t object;
+        uint64_t size;
+    } expected[] = {
+        { TRACE_ALLOC, 0, 100 }, { TRACE_ALLOC, 1, 200 }, { TRACE_REALLOC, 0, 5000 },
+        { TRACE_FREE_SIZED, 1, 200 },
+        { TRACE_ALLOC, 1, 32 }, { TRACE_ALLOC, 2, 32 }, { TRACE_ALLOC, 3, 32 }, { TRACE_ALLOC, 4, 32 },
+        { TRACE_FREE, 1, 0 }, { TRACE_FREE, 2, 0 }, { TRACE_FREE, 3, 0 }, { TRACE_FREE, 4, 0 },
+        { TRACE_FREE, 0, 0 },
+    };
+    size_t num_expected = sizeof(expected) / sizeof(expected[0]);
+    int ok = trace->header.records == num_expected && trace->header.objects == 5 &&
+             trace->header.threads >= 1;
+    for (size_t i = 0; ok && i < num_expected; i++) {
+        trace_record_t* r = &trace->records[i];
+        ok = r->op == expected[i].op && r->object == expected[i].object &&
+             r->size == expected[i].size && (i == 0 || r->timestamp >= r[-1].timestamp);
+    }
+    int aligned = trace->records[1].align_shift == 6 && trace->records[0].align_shift == 0;
+    trace_free(trace);
+    ASSERT(ok, "Trace records do not match the calls");
+    ASSERT(aligned, "Alignment not recorded");
+    
+    TEST_PASS();
+}
+
+#define RELEASE_OBJECTS 4000
+
+/* Test that empty pages go back to the OS and can be reused afterwards */
+void test_page_release(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[RELEASE_OBJECTS];
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < RELEASE_OBJECTS; i++) {
+            ptrs[i] = allocator_alloc(alloc, 64);
+            ASSERT(ptrs[i] != NULL, "Failed to allocate memory");
+            memset(ptrs[i], 0x3C, 64);
+        }
+        for (int i = 0; i < RELEASE_OBJECTS; i++) {
+            allocator_free(alloc, ptrs[i]);
+        }
+        
+        /* большая часть страниц уже отдана при освобождении,
+         * trim забирает оставшийся резерв пустых страниц */
+        size_t released = allocator_trim(alloc);
+        ASSERT(released > 0 && released % 4096 == 0, "Empty pages were not released");
+        ASSERT(allocator_trim(alloc) == 0, "Second trim released pages again");
+    }
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define ARENA_OBJECTS 1000
+
+/* Test that reset releases everything at once and the memory is reused in place */
+void test_arena_reset(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    static void* ptrs[ARENA_OBJECTS];
+    void* first = NULL;
+    for (int round = 0; round < 5; round++) {
+        /* 1000 объектов по ~450 байт - несколько чанков */
+        for (int i = 0; i < ARENA_OBJECTS; i++) {
+            size_t size = 1 + (size_t)(i * 37) % 900;
+            ptrs[i] = allocator_alloc(alloc, size);
+            ASSERT(ptrs[i] != NULL, "Failed to allocate memory");
+            ASSERT((uintptr_t)ptrs[i] % ALLOCATOR_MIN_ALIGNMENT == 0, "Block below minimum alignment");
+            ASSERT(allocator_usable_size(alloc, ptrs[i]) >= size, "Usable size smaller than request");
+            memset(ptrs[i], i & 0xFF, size);
+        }
+        for (int i = 0; i < ARENA_OBJECTS; i++) {
+            unsigned char* p = ptrs[i];
+            size_t size = 1 + (size_t)(i * 37) % 900;
+            ASSERT(p[0] == (i & 0xFF) && p[size - 1] == (i & 0xFF), "Blocks overlap");
+        }
+        
+        /* после сброса выделение начинается с того же места */
+        if (round == 0) {
+            first = ptrs[0];
+        }
+        ASSERT(ptrs[0] == first, "Reset did not rewind to the start");
+        ASSERT(allocator_reset(alloc), "Reset failed");
+    }
+    
+    /* свежий объект на вершине освобождается сразу */
+    void* a = allocator_alloc(alloc, 100);
+    allocator_free(alloc, a);
+    ASSERT(allocator_alloc(alloc, 100) == a, "Top object was not reclaimed");
+    
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.total_allocations == 5 * ARENA_OBJECTS + 2, "Wrong allocation count");
+    ASSERT(stats.total_frees == 1, "Wrong free count");
+    ASSERT(stats.current_allocated == 112, "Reset did not drop occupied bytes");
+    ASSERT(stats.peak_allocated >= ARENA_OBJECTS * 450, "Peak lost after reset");
+    ASSERT(stats.heap_size > 0 && stats.free_bytes > 0 && stats.num_classes == 0, "Heap state missing");
+    
+    /* чанки остаются за ареной до trim; у других аллокаторов сброса нет */
+    ASSERT(allocator_trim(alloc) > 0, "Spare chunks were not released");
+    allocator_t* other = allocator_create(ALLOCATOR_SEGREGATED_FREELIST, TEST_HEAP_SIZE);
+    ASSERT(other != NULL && !allocator_reset(other), "Reset accepted by a non-arena allocator");
+    allocator_destroy(other);
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test nested marks, oversized objects and alignment across rewinds */
+void test_arena_marks(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    void* keep = allocator_alloc(alloc, 64);
+    memset(keep, 0x42, 64);
+    allocator_mark_t outer = allocator_mark(alloc);
+    
+    for (int round = 0; round < 3; round++) {
+        void* a = allocator_alloc(alloc, 1000);
+        allocator_mark_t inner = allocator_mark(alloc);
+        void* b = allocator_aligned_alloc(alloc, 256, 300);
+        ASSERT(b != NULL && (uintptr_t)b % 256 == 0, "Aligned block is misaligned");
+        /* крупнее порога - отдельный чанк, снимается откатом */
+        void* big = allocator_alloc(alloc, 200000);
+        ASSERT(big != NULL, "Failed to allocate oversized object");
+        memset(big, 0x5A, 200000);
+        allocator_stats_t stats;
+        allocator_get_stats(alloc, &stats);
+        ASSERT(stats.large_mapped >= 200000 && stats.large_allocations == (size_t)round + 1,
+               "Oversized object not in its own chunk");
+        
+        /* откат к внутренней метке оставляет a, следующий блок - на месте b */
+        ASSERT(allocator_rewind(alloc, inner), "Rewind failed");
+        allocator_get_stats(alloc, &stats);
+        ASSERT(stats.large_mapped == 0, "Oversized object survived rewind");
+        void* c = allocator_aligned_alloc(alloc, 256, 300);
+        ASSERT(c == b, "Rewind did not reuse the memory");
+        
+        /* откат к внешней - и a тоже */
+        ASSERT(allocator_rewind(alloc, outer), "Rewind failed");
+        ASSERT(allocator_alloc(alloc, 1000) == a, "Outer rewind did not reach the mark");
+        ASSERT(allocator_rewind(alloc, outer), "Rewind failed");
+    }
+    
+    /* откат через границу чанков */
+    for (int i = 0; i < 1500; i++) {
+        ASSERT(allocator_alloc(alloc, 500) != NULL, "Failed to allocate memory");
+    }
+    ASSERT(allocator_rewind(alloc, outer), "Rewind failed");
+    void* after = allocator_alloc(alloc, 16);
+    ASSERT((char*)after > (char*)keep && (char*)after < (char*)keep + 1024,
+           "Rewind across chunks lost the position");
+    unsigned char* k = keep;
+    ASSERT(k[0] == 0x42 && k[63] == 0x42, "Object before the mark overwritten");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+#define OBJCACHE_TEST_MAGIC 0x0B7EC7ED
+#define OBJCACHE_TEST_OBJECTS 200
+
+typedef struct {
+    uint32_t magic;
+    uint32_t uses;
+    char payload[492];
+} cached_object_t;
+
+static int objcache_ctor_calls = 0;
+static int objcache_dtor_calls = 0;
+
+static void cached_object_ctor(void* obj) {
+    cached_object_t* o = obj;
+    o->magic = OBJCACHE_TEST_MAGIC;
+    o->uses = 0;
+    objcache_ctor_calls++;
+}
+
+static void cached_object_dtor(void* obj) {
+    cached_object_t* o = obj;
+    if (o->magic == OBJCACHE_TEST_MAGIC) {
+        objcache_dtor_calls++;
+    }
+    o->magic = 0;
+}
+
+/* Test that cached objects keep their constructed state and slabs are colored */
+void test_objcache(const char* name) {
+    TEST(name);
+    
+    objcache_ctor_calls = 0;
+    objcache_dtor_calls = 0;
+    objcache_t* cache = objcache_create(sizeof(cached_object_t), 64,
+                                        cached_object_ctor, cached_object_dtor);
+    ASSERT(cache != NULL, "Failed to create object cache");
+    ASSERT(objcache_create(0, 0, NULL, NULL) == NULL, "Zero-sized cache accepted");
+    ASSERT(objcache_create(64, 24, NULL, NULL) == NULL, "Non power of two alignment accepted");
+    
+    static cached_object_t* objs[OBJCACHE_TEST_OBJECTS];
+    for (int i = 0; i < OBJCACHE_TEST_OBJECTS; i++) {
+        objs[i] = objcache_alloc(cache);
+        ASSERT(objs[i] != NULL, "Failed to allocate object");
+        ASSERT((uintptr_t)objs[i] % 64 == 0, "Object is misaligned");
+        ASSERT(objs[i]->magic == OBJCACHE_TEST_MAGIC && objs[i]->uses == 0, "Object not constructed");
+        objs[i]->uses++;
+        memset(objs[i]->payload, i & 0xFF, sizeof(objs[i]->payload));
+    }
+    for (int i = 0; i < OBJCACHE_TEST_OBJECTS; i++) {
+        ASSERT(objs[i]->payload[0] == (char)(i & 0xFF), "Objects overlap");
+    }
+    
+    /* первые объекты соседних slab'ов начинаются с разных смещений */
+    objcache_stats_t stats;
+    objcache_get_stats(cache, &stats);
+    ASSERT(stats.objects_per_slab >= OBJCACHE_MIN_OBJECTS, "Slab too small");
+    ASSERT(stats.colors > 1, "Slab has no room for coloring");
+    size_t per_slab = stats.objects_per_slab;
+    uintptr_t first = (uintptr_t)objs[0] % stats.slab_size;
+    uintptr_t second = (uintptr_t)objs[per_slab] % stats.slab_size;
+    ASSERT(first != second, "Slabs are not colored");
+    int constructed = objcache_ctor_calls;
+    ASSERT(constructed == (int)(stats.slabs * per_slab), "Constructor not called per slab object");
+    
+    /* возвращённые объекты выдаются повторно без конструктора, с сохранённым состоянием */
+    for (int i = 0; i < OBJCACHE_TEST_OBJECTS; i++) {
+        objcache_free(cache, objs[i]);
+    }
+    for (int i = 0; i < OBJCACHE_TEST_OBJECTS / 2; i++) {
+        cached_object_t* o = objcache_alloc(cache);
+        ASSERT(o != NULL && o->magic == OBJCACHE_TEST_MAGIC, "Cached object lost its state");
+        objcache_free(cache, o);
+    }
+    ASSERT(objcache_ctor_calls == constructed, "Cached object was constructed again");
+    
+    /* пустые slab'ы остаются сконструированными до reap */
+    objcache_get_stats(cache, &stats);
+    ASSERT(stats.in_use == 0 && stats.allocations == stats.frees, "Wrong object counters");
+    ASSERT(objcache_dtor_calls == 0, "Empty slab destroyed before reap");
+    ASSERT(objcache_reap(cache) == stats.slab_bytes && stats.slab_bytes > 0, "Reap released wrong size");
+    ASSERT(objcache_dtor_calls == objcache_ctor_calls, "Destructor not called for every object");
+    
+    cached_object_t* live = objcache_alloc(cache);
+    ASSERT(live != NULL, "Failed to allocate after reap");
+    objcache_destroy(cache);
+    ASSERT(objcache_dtor_calls == objcache_ctor_calls, "Destroy skipped destructors");
+    
+    TEST_PASS();
+}
+
+/* Test buddy splitting, merging, natural alignment and in-place resize */
+void test_buddy(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    /* блоки - степени двойки, выровненные по своему размеру */
+    for (size_t size = 4096; size <= 128 * 1024; size = size * 2 + 1000) {
+        void* ptr = allocator_alloc(alloc, size);
+        ASSERT(ptr != NULL, "Failed to allocate block");
+        size_t usable = allocator_usable_size(alloc, ptr);
+        ASSERT(usable >= size && usable < 2 * size && (usable & (usable - 1)) == 0,
+               "Block is not the smallest power of two");
+        ASSERT((uintptr_t)ptr % usable == 0, "Block is not naturally aligned");
+        memset(ptr, 0x6B, size);
+        allocator_free(alloc, ptr);
+    }
+    
+    /* вся куча - 16 блоков по 64 КБ; освобождённые в разброс, они сливаются обратно */
+    void* blocks[16];
+    for (int i = 0; i < 16; i++) {
+        blocks[i] = allocator_alloc(alloc, 64 * 1024);
+        ASSERT(blocks[i] != NULL, "Failed to fill the heap");
+    }
+    ASSERT(allocator_alloc(alloc, 64) == NULL, "Heap should be full");
+    allocator_stats_t stats;
+    for (int i = 0; i < 16; i++) {
+        allocator_free(alloc, blocks[(i * 7) % 16]);
+    }
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.free_blocks == 1 && stats.largest_free_block == TEST_HEAP_SIZE, "Buddies not merged");
+    ASSERT(stats.num_classes == 0 && stats.current_allocated == 0, "Wrong buddy stats");
+    
+    /* рост на месте забирает свободного близнеца, сжатие отдаёт верхние половины */
+    void* a = allocator_alloc(alloc, 16 * 1024);
+    ASSERT(allocator_realloc(alloc, a, 64 * 1024) == a, "Growth into free buddies moved the block");
+    ASSERT(allocator_usable_size(alloc, a) == 64 * 1024, "Grown block has wrong size");
+    void* b = allocator_alloc(alloc, 16 * 1024);
+    void* moved = allocator_realloc(alloc, a, 100 * 1024);
+    ASSERT(moved != NULL && moved != a, "Growth over a used buddy stayed in place");
+    ASSERT(allocator_realloc(alloc, moved, 20 * 1024) == moved, "Shrink moved the block");
+    allocator_free(alloc, moved);
+    allocator_free(alloc, b);
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.free_blocks == 1, "Shrunk halves not merged back");
+    
+    /* запросы больше кучи уходят в отображения */
+    void* big = allocator_alloc(alloc, 2 * TEST_HEAP_SIZE);
+    ASSERT(big != NULL, "Failed to allocate block larger than the heap");
+    allocator_free(alloc, big);
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
+/* Test TLSF immediate coalescing, good fit and in-place resize */
+void test_tlsf(allocator_type_t type, const char* name) {
+    TEST(name);
+    
+    allocator_t* alloc = allocator_create(type, TEST_HEAP_SIZE);
+    ASSERT(alloc != NULL, "Failed to create allocator");
+    
+    /* куча раздроблена: занят каждый второй блок разных размеров */
+    void* ptrs[256];
+    for (int i = 0; i < 256; i++) {
+        ptrs[i] = allocator_alloc(alloc, 16 + (size_t)(i * 37) % 3000);
+        ASSERT(ptrs[i] != NULL, "Failed to allocate block");
+    }
+    for (int i = 0; i < 256; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    allocator_stats_t stats;
+    allocator_get_stats(alloc, &stats);
+#ifndef ALLOCATOR_CACHE_ALIGNED
+    /* с выравниванием по линии кэша между блоками остаются свободные обрезки */
+    ASSERT(stats.free_blocks == 129, "Free blocks were merged with used neighbours");
+#endif
+    
+    /* good fit: блок из подходящего списка обрезается, лишнего не больше заголовка и шага */
+#ifdef ALLOCATOR_CACHE_ALIGNED
+    size_t slack = 48 + CACHE_LINE_SIZE; /* и округления до линии кэша */
+#else
+    size_t slack = 48;
+#endif
+    for (size_t size = 1; size <= 6000; size = size * 3 + 5) {
+        void* ptr = allocator_alloc(alloc, size);
+        ASSERT(ptr != NULL && ((uintptr_t)ptr & 15) == 0, "Bad block");
+        size_t usable = allocator_usable_size(alloc, ptr);
+        ASSERT(usable >= size && usable < size + slack, "Block is not trimmed to the request");
+        allocator_free(alloc, ptr);
+    }
+    
+    /* освобождённый блок сразу сливается с обоими свободными соседями */
+    for (int i = 1; i < 256; i += 2) {
+        allocator_free(alloc, ptrs[i]);
+    }
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.free_blocks == 1 && stats.largest_free_block == stats.free_bytes,
+           "Neighbours not coalesced");
+    ASSERT(stats.num_classes == 0 && stats.current_allocated == 0, "Wrong TLSF stats");
+    
+    /* рост на месте забирает свободного соседа справа, сжатие отдаёт хвост */
+    void* a = allocator_alloc(alloc, 1000);
+    void* b = allocator_alloc(alloc, 1000);
+    void* c = allocator_alloc(alloc, 1000);
+    allocator_free(alloc, b);
+    ASSERT(allocator_realloc(alloc, a, 2000) == a, "Growth into a free neighbour moved the block");
+    void* moved = allocator_realloc(alloc, a, 8000);
+    ASSERT(moved != NULL && moved != a, "Growth over a used neighbour stayed in place");
+    ASSERT(allocator_realloc(alloc, moved, 100) == moved, "Shrink moved the block");
+    ASSERT(allocator_usable_size(alloc, moved) < 148, "Shrunk tail was not released");
+    
+    /* выровненный блок: отрезанное спереди возвращается в списки */
+    void* aligned = allocator_aligned_alloc(alloc, 4096, 3000);
+    ASSERT(aligned != NULL && ((uintptr_t)aligned & 4095) == 0, "Block is misaligned");
+    allocator_free(alloc, aligned);
+    allocator_free(alloc, moved);
+    allocator_free(alloc, c);
+    allocator_get_stats(alloc, &stats);
+    ASSERT(stats.free_blocks == 1, "Blocks not merged back");
+    
+    allocator_destroy(alloc);
+    TEST_PASS();
+}
+
 int main(void) {
     printf("=== Memory Allocator Unit Tests ===\n\n");
     
-    printf("--- Segregated Free-List Allocator Tests ---\n");
+    test_size_classes("Size classes: O(1) lookup");
+    
+    printf("\n--- Segregated Free-List Allocator Tests ---\n");
     test_basic_alloc_free(ALLOCATOR_SEGREGATED_FREELIST, 
                           "Segregated: Basic alloc/free");
     test_multiple_allocs(ALLOCATOR_SEGREGATED_FREELIST, 
@@ -171,6 +1230,32 @@ int main(void) {
                       "Segregated: Allocation patterns");
     test_edge_cases(ALLOCATOR_SEGREGATED_FREELIST, 
                    "Segregated: Edge cases");
+    test_usable_size(ALLOCATOR_SEGREGATED_FREELIST, 
+                    "Segregated: Usable size");
+    test_threaded_alloc_free(ALLOCATOR_SEGREGATED_FREELIST, 
+                            "Segregated: Threaded alloc/free");
+    test_cross_thread_free(ALLOCATOR_SEGREGATED_FREELIST, 
+                          "Segregated: Cross-thread free");
+    test_coalescing(ALLOCATOR_SEGREGATED_FREELIST, 
+                   "Segregated: Coalescing");
+    test_bin_search(ALLOCATOR_SEGREGATED_FREELIST, 
+                   "Segregated: Bin search");
+    test_large_objects(ALLOCATOR_SEGREGATED_FREELIST, 
+                      "Segregated: Large objects");
+    test_realloc(ALLOCATOR_SEGREGATED_FREELIST, 
+                "Segregated: Realloc");
+    test_stats(ALLOCATOR_SEGREGATED_FREELIST, 
+              "Segregated: Stats");
+    test_stats_balance(ALLOCATOR_SEGREGATED_FREELIST, 
+                       "Segregated: Stats balance");
+    test_batch(ALLOCATOR_SEGREGATED_FREELIST, 
+              "Segregated: Batch alloc/free");
+    test_free_sized(ALLOCATOR_SEGREGATED_FREELIST, 
+                    "Segregated: Sized free");
+    test_aligned_alloc(ALLOCATOR_SEGREGATED_FREELIST, 
+                       "Segregated: Aligned alloc");
+    test_trace(ALLOCATOR_SEGREGATED_FREELIST, 
+               "Segregated: Trace recording");
     
     printf("\n--- McKusick-Karels Allocator Tests ---\n");
     test_basic_alloc_free(ALLOCATOR_MCKUSICK_KARELS, 
@@ -185,6 +1270,137 @@ int main(void) {
                       "McKusick-Karels: Allocation patterns");
     test_edge_cases(ALLOCATOR_MCKUSICK_KARELS, 
                    "McKusick-Karels: Edge cases");
+    test_usable_size(ALLOCATOR_MCKUSICK_KARELS, 
+                    "McKusick-Karels: Usable size");
+    test_threaded_alloc_free(ALLOCATOR_MCKUSICK_KARELS, 
+                            "McKusick-Karels: Threaded alloc/free");
+    test_cross_thread_free(ALLOCATOR_MCKUSICK_KARELS, 
+                          "McKusick-Karels: Cross-thread free");
+    test_page_release(ALLOCATOR_MCKUSICK_KARELS, 
+                     "McKusick-Karels: Page release");
+    test_large_objects(ALLOCATOR_MCKUSICK_KARELS, 
+                      "McKusick-Karels: Large objects");
+    test_realloc(ALLOCATOR_MCKUSICK_KARELS, 
+                "McKusick-Karels: Realloc");
+    test_stats(ALLOCATOR_MCKUSICK_KARELS, 
+              "McKusick-Karels: Stats");
+    test_stats_balance(ALLOCATOR_MCKUSICK_KARELS, 
+                       "McKusick-Karels: Stats balance");
+    test_batch(ALLOCATOR_MCKUSICK_KARELS, 
+              "McKusick-Karels: Batch alloc/free");
+    test_free_sized(ALLOCATOR_MCKUSICK_KARELS, 
+                    "McKusick-Karels: Sized free");
+    test_aligned_alloc(ALLOCATOR_MCKUSICK_KARELS, 
+                       "McKusick-Karels: Aligned alloc");
+    test_trace(ALLOCATOR_MCKUSICK_KARELS, 
+               "McKusick-Karels: Trace recording");
+    
+    printf("\n--- Arena Allocator Tests ---\n");
+    test_basic_alloc_free(ALLOCATOR_ARENA, 
+                          "Arena: Basic alloc/free");
+    test_multiple_allocs(ALLOCATOR_ARENA, 
+                        "Arena: Multiple allocations");
+    test_varied_sizes(ALLOCATOR_ARENA, 
+                     "Arena: Varied sizes");
+    test_memory_reuse(ALLOCATOR_ARENA, 
+                     "Arena: Memory reuse");
+    test_alloc_pattern(ALLOCATOR_ARENA, 
+                      "Arena: Allocation patterns");
+    test_edge_cases(ALLOCATOR_ARENA, 
+                   "Arena: Edge cases");
+    test_usable_size(ALLOCATOR_ARENA, 
+                    "Arena: Usable size");
+    test_cross_thread_free(ALLOCATOR_ARENA, 
+                          "Arena: Cross-thread free");
+    test_realloc(ALLOCATOR_ARENA, 
+                "Arena: Realloc");
+    test_trace(ALLOCATOR_ARENA, 
+               "Arena: Trace recording");
+    test_arena_reset(ALLOCATOR_ARENA, 
+                     "Arena: Reset");
+    test_arena_marks(ALLOCATOR_ARENA, 
+                     "Arena: Marks");
+    
+    printf("\n--- Buddy Allocator Tests ---\n");
+    test_basic_alloc_free(ALLOCATOR_BUDDY, 
+                          "Buddy: Basic alloc/free");
+    test_multiple_allocs(ALLOCATOR_BUDDY, 
+                        "Buddy: Multiple allocations");
+    test_varied_sizes(ALLOCATOR_BUDDY, 
+                     "Buddy: Varied sizes");
+    test_memory_reuse(ALLOCATOR_BUDDY, 
+                     "Buddy: Memory reuse");
+    test_alloc_pattern(ALLOCATOR_BUDDY, 
+                      "Buddy: Allocation patterns");
+    test_edge_cases(ALLOCATOR_BUDDY, 
+                   "Buddy: Edge cases");
+    test_threaded_alloc_free(ALLOCATOR_BUDDY, 
+                            "Buddy: Threaded alloc/free");
+    test_cross_thread_free(ALLOCATOR_BUDDY, 
+                          "Buddy: Cross-thread free");
+    test_coalescing(ALLOCATOR_BUDDY, 
+                   "Buddy: Coalescing");
+    test_page_release(ALLOCATOR_BUDDY, 
+                     "Buddy: Page release");
+    test_large_objects(ALLOCATOR_BUDDY, 
+                      "Buddy: Large objects");
+    test_realloc(ALLOCATOR_BUDDY, 
+                "Buddy: Realloc");
+    test_batch(ALLOCATOR_BUDDY, 
+              "Buddy: Batch alloc/free");
+    test_free_sized(ALLOCATOR_BUDDY, 
+                    "Buddy: Sized free");
+    test_aligned_alloc(ALLOCATOR_BUDDY, 
+                       "Buddy: Aligned alloc");
+    test_trace(ALLOCATOR_BUDDY, 
+               "Buddy: Trace recording");
+    test_stats_balance(ALLOCATOR_BUDDY, 
+                       "Buddy: Stats balance");
+    test_buddy(ALLOCATOR_BUDDY, 
+               "Buddy: Split, merge and resize");
+    
+    printf("\n--- TLSF Allocator Tests ---\n");
+    test_basic_alloc_free(ALLOCATOR_TLSF, 
+                          "TLSF: Basic alloc/free");
+    test_multiple_allocs(ALLOCATOR_TLSF, 
+                         "TLSF: Multiple allocations");
+    test_varied_sizes(ALLOCATOR_TLSF, 
+                      "TLSF: Varied sizes");
+    test_memory_reuse(ALLOCATOR_TLSF, 
+                      "TLSF: Memory reuse");
+    test_alloc_pattern(ALLOCATOR_TLSF, 
+                       "TLSF: Allocation patterns");
+    test_edge_cases(ALLOCATOR_TLSF, 
+                    "TLSF: Edge cases");
+    test_threaded_alloc_free(ALLOCATOR_TLSF, 
+                             "TLSF: Threaded alloc/free");
+    test_cross_thread_free(ALLOCATOR_TLSF, 
+                           "TLSF: Cross-thread free");
+    test_coalescing(ALLOCATOR_TLSF, 
+                    "TLSF: Coalescing");
+    test_page_release(ALLOCATOR_TLSF, 
+                      "TLSF: Page release");
+    test_large_objects(ALLOCATOR_TLSF, 
+                       "TLSF: Large objects");
+    test_realloc(ALLOCATOR_TLSF, 
+                 "TLSF: Realloc");
+    test_batch(ALLOCATOR_TLSF, 
+               "TLSF: Batch alloc/free");
+    test_free_sized(ALLOCATOR_TLSF, 
+                    "TLSF: Sized free");
+    test_aligned_alloc(ALLOCATOR_TLSF, 
+                       "TLSF: Aligned alloc");
+    test_trace(ALLOCATOR_TLSF, 
+               "TLSF: Trace recording");
+    test_stats_balance(ALLOCATOR_TLSF, 
+                       "TLSF: Stats balance");
+    test_usable_size(ALLOCATOR_TLSF, 
+                     "TLSF: Usable size");
+    test_tlsf(ALLOCATOR_TLSF, 
+              "TLSF: Coalescing, good fit and resize");
+    
+    printf("\n--- Object Cache Tests ---\n");
+    test_objcache("Object cache: ctor caching and coloring");
     
     printf("\n=== Test Results ===\n");
     printf("Passed: %d\n", tests_passed);